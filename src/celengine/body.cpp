@@ -198,6 +198,8 @@ void Body::setTimeline(Timeline* newTimeline)
     {
         delete timeline;
         timeline = newTimeline;
+        ephemerisVersion++;
+        FrameTree::markEdited();
         markChanged();
     }
 }
@@ -542,9 +544,13 @@ void Body::setAtmosphere(const Atmosphere& _atmosphere)
  */
 UniversalCoord Body::getPosition(double tdb) const
 {
-    Vector3d position = Vector3d::Zero();
-
     const TimelinePhase* phase = timeline->findPhase(tdb);
+
+    UniversalCoord snapshotPosition;
+    if (phase->getSnapshot(tdb, &PhaseSnapshot::position, snapshotPosition))
+        return snapshotPosition;
+
+    Vector3d position = Vector3d::Zero();
     Vector3d p = phase->orbit()->positionAtTime(tdb);
     ReferenceFrame* frame = phase->orbitFrame();
 
@@ -570,6 +576,11 @@ UniversalCoord Body::getPosition(double tdb) const
 Quaterniond Body::getOrientation(double tdb) const
 {
     const TimelinePhase* phase = timeline->findPhase(tdb);
+
+    Quaterniond q;
+    if (phase->getSnapshot(tdb, &PhaseSnapshot::eclipticToBodyFixed, q))
+        return q;
+
     return phase->rotationModel()->orientationAtTime(tdb) * phase->bodyFrame()->getOrientation(tdb);
 }
 
@@ -634,6 +645,11 @@ Vector3d Body::getAstrocentricPosition(double tdb) const
 {
     // TODO: Switch the iterative method used in getPosition
     const TimelinePhase* phase = timeline->findPhase(tdb);
+
+    Vector3d position;
+    if (phase->getSnapshot(tdb, &PhaseSnapshot::astrocentricPosition, position))
+        return position;
+
     return phase->orbitFrame()->convertToAstrocentric(phase->orbit()->positionAtTime(tdb), tdb);
 }
 
@@ -643,6 +659,11 @@ Vector3d Body::getAstrocentricPosition(double tdb) const
 Quaterniond Body::getEclipticToFrame(double tdb) const
 {
     const TimelinePhase* phase = timeline->findPhase(tdb);
+
+    Quaterniond q;
+    if (phase->getSnapshot(tdb, &PhaseSnapshot::eclipticToFrame, q))
+        return q;
+
     return phase->bodyFrame()->getOrientation(tdb);
 }
 
@@ -653,6 +674,11 @@ Quaterniond Body::getEclipticToFrame(double tdb) const
 Quaterniond Body::getEclipticToEquatorial(double tdb) const
 {
     const TimelinePhase* phase = timeline->findPhase(tdb);
+
+    Quaterniond q;
+    if (phase->getSnapshot(tdb, &PhaseSnapshot::eclipticToEquatorial, q))
+        return q;
+
     return phase->rotationModel()->equatorOrientationAtTime(tdb) * phase->bodyFrame()->getOrientation(tdb);
 }
 
@@ -663,6 +689,11 @@ Quaterniond Body::getEclipticToEquatorial(double tdb) const
 Quaterniond Body::getEclipticToBodyFixed(double tdb) const
 {
     const TimelinePhase* phase = timeline->findPhase(tdb);
+
+    Quaterniond q;
+    if (phase->getSnapshot(tdb, &PhaseSnapshot::eclipticToBodyFixed, q))
+        return q;
+
     return phase->rotationModel()->orientationAtTime(tdb) * phase->bodyFrame()->getOrientation(tdb);
 }
 
@@ -673,6 +704,11 @@ Quaterniond Body::getEclipticToBodyFixed(double tdb) const
 Quaterniond Body::getEquatorialToBodyFixed(double tdb) const
 {
     const TimelinePhase* phase = timeline->findPhase(tdb);
+
+    Quaterniond q;
+    if (phase->getSnapshot(tdb, &PhaseSnapshot::equatorialToBodyFixed, q))
+        return q;
+
     return phase->rotationModel()->spin(tdb);
 }
 
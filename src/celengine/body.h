@@ -21,6 +21,7 @@
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <GL/glew.h>
+#include <atomic>
 #include <string>
 #include <vector>
 #include <map>
@@ -199,6 +200,12 @@ class Body : public CatEntry
     void setTimeline(Timeline* timeline);
     const Timeline* getTimeline() const;
 
+    /*! Counter incremented whenever the trajectory or rotation of the
+     *  body is replaced. Reference frames that depend on the body compare
+     *  it against the value seen when their caches were filled.
+     */
+    unsigned int getEphemerisVersion() const { return ephemerisVersion; }
+
     FrameTree* getFrameTree() const;
     FrameTree* getOrCreateFrameTree();
 
@@ -371,6 +378,7 @@ class Body : public CatEntry
     PlanetarySystem* satellites{ nullptr };
 
     Timeline* timeline{ nullptr };
+    std::atomic<unsigned int> ephemerisVersion{ 0 };
     // Children in the frame hierarchy
     FrameTree* frameTree{ nullptr };
 
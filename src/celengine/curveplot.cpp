@@ -36,6 +36,7 @@
 
 #include "curveplot.h"
 #include "GL/glew.h"
+#include <celephem/orbit.h>
 #include <vector>
 #include <iostream>
 
@@ -657,6 +658,110 @@ CurvePlot::removeSamplesAfter(double t)
 }
 
 
+// Collects the samples of a span next to the ends of a plot. Adaptive
+// sampling starts from the spacing of the samples at the end of the plot
+// that is extended, instead of the orbit's default start step.
+class CurvePlotSampler : public OrbitSampleProc
+{
+public:
+    explicit CurvePlotSampler(double startStep) :
+        m_startStep(startStep)
+    {
+    }
+
+    void sample(double t, const Vector3d& position, const Vector3d& velocity) override
+    {
+        CurvePlotSample samp;
+        samp.t = t;
+        samp.position = position;
+        samp.velocity = velocity;
+        samples.push_back(samp);
+    }
+
+    double startStep() const override
+    {
+        return m_startStep;
+    }
+
+    vector<CurvePlotSample> samples;
+
+private:
+    double m_startStep;
+};
+
+
+double
+CurvePlot::frontStep() const
+{
+    return m_samples.size() < 2 ? 0.0 : m_samples[1].t - m_samples[0].t;
+}
+
+
+double
+CurvePlot::backStep() const
+{
+    size_t n = m_samples.size();
+    return n < 2 ? 0.0 : m_samples[n - 1].t - m_samples[n - 2].t;
+}
+
+
+/** Make the plot cover the time range [ startTime, endTime ] as the range
+  * slides, sampling the orbit only over the newly exposed span. The plot is
+  * extended past the range by slack, so that it doesn't need extending
+  * again in the next frame, and samples further than slack beyond the other
+  * end of the range are dropped; one sample is kept past each end so that
+  * the curve still reaches it. If the range doesn't overlap the current
+  * samples, the orbit is sampled again from scratch.
+  *
+  * Returns true if the samples changed.
+  */
+bool
+CurvePlot::updateWindow(const Orbit& orbit, double startTime, double endTime, double slack)
+{
+    if (!m_samples.empty() && startTime >= this->startTime() && endTime <= this->endTime())
+        return false;
+
+    double newStartTime = startTime - slack;
+    double newEndTime = endTime + slack;
+
+    if (m_samples.empty() || newEndTime <= this->startTime() || newStartTime >= this->endTime())
+    {
+        m_samples.clear();
+        CurvePlotSampler sampler(0.0);
+        orbit.sample(newStartTime, newEndTime, sampler);
+        for (const auto& sample : sampler.samples)
+            addSample(sample);
+        return true;
+    }
+
+    if (startTime < this->startTime())
+    {
+        while (m_samples.size() > 1 && m_samples[m_samples.size() - 2].t > newEndTime)
+            m_samples.pop_back();
+
+        // The sample at the current start time is sampled again and
+        // discarded by addSample().
+        CurvePlotSampler sampler(frontStep());
+        orbit.sample(newStartTime, this->startTime(), sampler);
+        for (auto iter = sampler.samples.rbegin(); iter != sampler.samples.rend(); ++iter)
+            addSample(*iter);
+    }
+
+    if (endTime > this->endTime())
+    {
+        while (m_samples.size() > 1 && m_samples[1].t < newStartTime)
+            m_samples.pop_front();
+
+        CurvePlotSampler sampler(backStep());
+        orbit.sample(this->endTime(), newEndTime, sampler);
+        for (const auto& sample : sampler.samples)
+            addSample(sample);
+    }
+
+    return true;
+}
+
+
 void
 CurvePlot::setDuration(double duration)
 {
@@ -27,11 +27,14 @@
 // License and a copy of the GNU General Public License along with
 // orbitpath. If not, see <http://www.gnu.org/licenses/>.
 
+#pragma once
+
 #include <deque>
 #include <Eigen/Geometry>
 
 
 class HighPrec_Frustum;
+class Orbit;
 
 class CurvePlotSample
 {
@@ -99,11 +102,16 @@ class CurvePlot
     void removeSamplesBefore(double t);
     void removeSamplesAfter(double t);
 
+    bool updateWindow(const Orbit& orbit, double startTime, double endTime, double slack);
+
     bool empty() const { return m_samples.empty(); }
 
     unsigned int sampleCount() const { return m_samples.size(); }
 
  private:
+    double frontStep() const;
+    double backStep() const;
+
     std::deque<CurvePlotSample> m_samples;
  
     double m_duration{ 0.0 };
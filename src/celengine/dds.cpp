@@ -83,15 +83,8 @@ static uint32_t FourCC(const char* s)
 #define DDPF_FOURCC 0x04
 
 
-Image* LoadDDSImage(const string& filename)
+Image* LoadDDSImage(istream& in, const string& filename)
 {
-    ifstream in(filename, ios::in | ios::binary);
-    if (!in.good())
-    {
-        DPRINTF(0, "Error opening DDS texture file %s.\n", filename.c_str());
-        return nullptr;
-    }
-
     char header[4];
     in.read(header, sizeof header);
     if (header[0] != 'D' || header[1] != 'D' ||
@@ -134,7 +127,7 @@ Image* LoadDDSImage(const string& filename)
         }
         else
         {
-            cerr << "Unknown FourCC in DDS file: " << ddsd.format.fourCC;
+            cerr << "Unknown FourCC in DDS file " << filename << ": " << ddsd.format.fourCC << '\n';
         }
     }
     else
@@ -188,7 +181,10 @@ Image* LoadDDSImage(const string& filename)
         format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
     {
         if (!GLEW_EXT_texture_compression_s3tc)
+        {
+            cerr << "S3 texture compression is unsupported, cannot load DDS file " << filename << '\n';
             return nullptr;
+        }
     }
 
     // TODO: Verify that the reported texture size matches the amount of
@@ -217,3 +213,16 @@ Image* LoadDDSImage(const string& filename)
 
     return img;
 }
+
+
+Image* LoadDDSImage(const string& filename)
+{
+    ifstream in(filename, ios::in | ios::binary);
+    if (!in.good())
+    {
+        DPRINTF(0, "Error opening DDS texture file %s.\n", filename.c_str());
+        return nullptr;
+    }
+
+    return LoadDDSImage(in, filename);
+}
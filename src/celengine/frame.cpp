@@ -10,12 +10,15 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cassert>
 #include <celengine/star.h>
 #include <celengine/body.h>
 #include <celengine/deepskyobj.h>
 #include <celengine/location.h>
 #include <celengine/frame.h>
+#include <celengine/frametree.h>
+#include <celengine/timelinephase.h>
 
 using namespace Eigen;
 using namespace std;
@@ -45,10 +48,9 @@ ReferenceFrame::addRef() const
 int
 ReferenceFrame::release() const
 {
-    --refCount;
-    assert(refCount >= 0);
-    int refCountCopy = refCount;
-    if (refCount <= 0)
+    int refCountCopy = --refCount;
+    assert(refCountCopy >= 0);
+    if (refCountCopy <= 0)
         delete this;
 
     return refCountCopy;
@@ -189,6 +191,48 @@ ReferenceFrame::nestingDepth(unsigned int maxDepth, FrameType frameType) const
 }
 
 
+static const Body*
+getDependencyBody(const Selection& sel)
+{
+    if (sel.location() != nullptr)
+        return sel.location()->getParentBody();
+    return sel.body();
+}
+
+
+// Add a body along with everything its orbit and body frames depend on,
+// for every phase of its timeline. Bodies already present are skipped,
+// which also stops the recursion for mutually dependent frames.
+static void
+addBodyDependencies(const Body* body, vector<const Body*>& bodies)
+{
+    if (body == nullptr || find(bodies.begin(), bodies.end(), body) != bodies.end())
+        return;
+
+    bodies.push_back(body);
+
+    const Timeline* timeline = body->getTimeline();
+    if (timeline == nullptr)
+        return;
+
+    for (unsigned int i = 0; i < timeline->phaseCount(); i++)
+    {
+        const TimelinePhase* phase = timeline->getPhase(i);
+        if (phase->orbitFrame() != nullptr)
+            phase->orbitFrame()->getDependencies(bodies);
+        if (phase->bodyFrame() != nullptr)
+            phase->bodyFrame()->getDependencies(bodies);
+    }
+}
+
+
+void
+ReferenceFrame::getDependencies(vector<const Body*>& bodies) const
+{
+    addBodyDependencies(getDependencyBody(centerObject), bodies);
+}
+
+
 static unsigned int
 getFrameDepth(const Selection& sel, unsigned int depth, unsigned int maxDepth,
               ReferenceFrame::FrameType frameType)
@@ -283,14 +327,14 @@ J2000EquatorFrame::nestingDepth(unsigned int depth,
 /*** BodyFixedFrame ***/
 
 BodyFixedFrame::BodyFixedFrame(Selection center, Selection obj) :
-    ReferenceFrame(center),
+    CachingFrame(center),
     fixObject(obj)
 {
 }
 
 
 Quaterniond
-BodyFixedFrame::getOrientation(double tjd) const
+BodyFixedFrame::computeOrientation(double tjd) const
 {
     // Rotation of 180 degrees about the y axis is required
     // TODO: this rotation could go in getEclipticalToBodyFixed()
@@ -314,7 +358,7 @@ BodyFixedFrame::getOrientation(double tjd) const
 
 
 Vector3d
-BodyFixedFrame::getAngularVelocity(double tjd) const
+BodyFixedFrame::computeAngularVelocity(double tjd) const
 {
     switch (fixObject.getType())
     {
@@ -340,6 +384,14 @@ BodyFixedFrame::isInertial() const
 }
 
 
+void
+BodyFixedFrame::getDependencies(vector<const Body*>& bodies) const
+{
+    ReferenceFrame::getDependencies(bodies);
+    addBodyDependencies(getDependencyBody(fixObject), bodies);
+}
+
+
 unsigned int
 BodyFixedFrame::nestingDepth(unsigned int depth,
                              unsigned int maxDepth,
@@ -362,7 +414,7 @@ BodyFixedFrame::nestingDepth(unsigned int depth,
 
 BodyMeanEquatorFrame::BodyMeanEquatorFrame(Selection center,
                                            Selection obj) :
-    ReferenceFrame(center),
+    CachingFrame(center),
     equatorObject(obj),
     freezeEpoch(astro::J2000),
     isFrozen(false)
@@ -373,7 +425,7 @@ BodyMeanEquatorFrame::BodyMeanEquatorFrame(Selection center,
 BodyMeanEquatorFrame::BodyMeanEquatorFrame(Selection center,
                                            Selection obj,
                                            double freeze) :
-    ReferenceFrame(center),
+    CachingFrame(center),
     equatorObject(obj),
     freezeEpoch(freeze),
     isFrozen(true)
@@ -382,7 +434,7 @@ BodyMeanEquatorFrame::BodyMeanEquatorFrame(Selection center,
 
 
 Quaterniond
-BodyMeanEquatorFrame::getOrientation(double tjd) const
+BodyMeanEquatorFrame::computeOrientation(double tjd) const
 {
     double t = isFrozen ? freezeEpoch : tjd;
 
@@ -399,7 +451,7 @@ BodyMeanEquatorFrame::getOrientation(double tjd) const
 
 
 Vector3d
-BodyMeanEquatorFrame::getAngularVelocity(double tjd) const
+BodyMeanEquatorFrame::computeAngularVelocity(double tjd) const
 {
     if (isFrozen)
     {
@@ -444,6 +496,14 @@ BodyMeanEquatorFrame::isInertial() const
 }
 
 
+void
+BodyMeanEquatorFrame::getDependencies(vector<const Body*>& bodies) const
+{
+    ReferenceFrame::getDependencies(bodies);
+    addBodyDependencies(getDependencyBody(equatorObject), bodies);
+}
+
+
 unsigned int
 BodyMeanEquatorFrame::nestingDepth(unsigned int depth,
                                    unsigned int maxDepth,
@@ -466,12 +526,7 @@ BodyMeanEquatorFrame::nestingDepth(unsigned int depth,
 /*** CachingFrame ***/
 
 CachingFrame::CachingFrame(Selection _center) :
-    ReferenceFrame(_center),
-    lastTime(-1.0e50),
-    lastOrientation(Quaterniond::Identity()),
-    lastAngularVelocity(0.0, 0.0, 0.0),
-    orientationCacheValid(false),
-    angularVelocityCacheValid(false)
+    ReferenceFrame(_center)
 {
 }
 
@@ -479,39 +534,60 @@ CachingFrame::CachingFrame(Selection _center) :
 Quaterniond
 CachingFrame::getOrientation(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastOrientation = computeOrientation(tjd);
-        orientationCacheValid = true;
-        angularVelocityCacheValid = false;
-    }
-    else if (!orientationCacheValid)
-    {
-        lastOrientation = computeOrientation(tjd);
-        orientationCacheValid = true;
-    }
-
-    return lastOrientation;
+    validateCache();
+    return orientationCache.get(tjd, [this](double t) { return computeOrientation(t); });
 }
 
 
 Vector3d CachingFrame::getAngularVelocity(double tjd) const
 {
-    if (tjd != lastTime)
+    validateCache();
+    return angularVelocityCache.get(tjd, [this](double t) { return computeAngularVelocity(t); });
+}
+
+
+// Versions only ever increase, so the sum changes whenever any one of the
+// dependencies is edited.
+unsigned int CachingFrame::dependencyVersion() const
+{
+    unsigned int version = 0;
+    for (const auto body : dependencies)
+        version += body->getEphemerisVersion();
+    return version;
+}
+
+
+/*! Discard the cached values if any body the frame depends on has been
+ *  given a new trajectory or rotation since they were computed. The
+ *  dependency list is collected on first use and again after every edit,
+ *  since the edit may have changed the frames the body is defined in.
+ *  The versions of the dependencies are only compared after some body
+ *  anywhere has been edited, so the common case is a single atomic load.
+ */
+void CachingFrame::validateCache() const
+{
+    unsigned int epoch = FrameTree::editEpoch();
+    if (checkedEpoch.load(std::memory_order_acquire) == epoch)
+        return;
+
+    std::lock_guard<std::mutex> lock(dependencyMutex);
+    if (dependenciesValid && dependencyVersion() == dependencyStamp)
     {
-        lastTime = tjd;
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        orientationCacheValid = false;
-        angularVelocityCacheValid = true;
+        checkedEpoch.store(epoch, std::memory_order_release);
+        return;
     }
-    else if (!angularVelocityCacheValid)
+
+    dependencies.clear();
+    getDependencies(dependencies);
+    dependencyStamp = dependencyVersion();
+
+    if (dependenciesValid)
     {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        angularVelocityCacheValid = true;
+        orientationCache.clear();
+        angularVelocityCache.clear();
     }
-
-    return lastAngularVelocity;
+    dependenciesValid = true;
+    checkedEpoch.store(epoch, std::memory_order_release);
 }
 
 
@@ -651,6 +727,15 @@ TwoVectorFrame::computeOrientation(double tjd) const
 }
 
 
+void
+TwoVectorFrame::getDependencies(vector<const Body*>& bodies) const
+{
+    ReferenceFrame::getDependencies(bodies);
+    primaryVector.getDependencies(bodies);
+    secondaryVector.getDependencies(bodies);
+}
+
+
 bool
 TwoVectorFrame::isInertial() const
 {
@@ -806,6 +891,28 @@ FrameVector::direction(double tjd) const
 }
 
 
+void
+FrameVector::getDependencies(vector<const Body*>& bodies) const
+{
+    switch (vecType)
+    {
+    case RelativePosition:
+    case RelativeVelocity:
+        addBodyDependencies(getDependencyBody(observer), bodies);
+        addBodyDependencies(getDependencyBody(target), bodies);
+        break;
+
+    case ConstantVector:
+        if (frame != nullptr)
+            frame->getDependencies(bodies);
+        break;
+
+    default:
+        break;
+    }
+}
+
+
 unsigned int
 FrameVector::nestingDepth(unsigned int depth,
                           unsigned int maxDepth) const
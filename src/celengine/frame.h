@@ -13,8 +13,12 @@
 
 #include <celengine/astro.h>
 #include <celengine/selection.h>
+#include <celutil/timecache.h>
 #include <Eigen/Core>
 #include <Eigen/Geometry>
+#include <atomic>
+#include <mutex>
+#include <vector>
 
 
 /*! A ReferenceFrame object has a center and set of orthogonal axes.
@@ -22,6 +26,10 @@
  * Subclasses of ReferenceFrame must override the getOrientation method
  * (which specifies the coordinate axes at a given time) and the
  * nestingDepth() method (which is used to check for recursive frames.)
+ *
+ * Like orbits and rotation models, frames may be evaluated from several
+ * threads at once. The reference count is atomic, but frames should only
+ * be created and shared while catalogs are loaded or from the main thread.
  */
 class ReferenceFrame
 {
@@ -47,6 +55,14 @@ class ReferenceFrame
 
     virtual bool isInertial() const = 0;
 
+    /*! Append the bodies that determine the origin and axes of this frame:
+     *  the center, any bodies named in the frame definition, and the bodies
+     *  their trajectories and rotations are defined relative to. The list
+     *  may contain more bodies than strictly necessary, but never fewer.
+     *  Bodies already in the list are not added again.
+     */
+    virtual void getDependencies(std::vector<const Body*>& bodies) const;
+
     enum FrameType
     {
         PositionFrame = 1,
@@ -61,12 +77,18 @@ class ReferenceFrame
 
  private:
     Selection centerObject;
-    mutable int refCount;
+    mutable std::atomic<int> refCount;
 };
 
 
 /*! Base class for complex frames where there may be some benefit
- *  to caching the last calculated orientation.
+ *  to caching the last calculated orientations. The cache may be used
+ *  from several threads at once.
+ *
+ *  Cached values are keyed by time, so a new time never returns a stale
+ *  result. The frame also remembers the ephemeris versions of the bodies
+ *  it depends on (see getDependencies()); the cache is discarded only
+ *  when one of those bodies is given a new trajectory or rotation.
  */
 class CachingFrame : public ReferenceFrame
 {
@@ -82,11 +104,19 @@ class CachingFrame : public ReferenceFrame
     virtual Eigen::Vector3d computeAngularVelocity(double tjd) const;
 
  private:
-    mutable double lastTime;
-    mutable Eigen::Quaterniond lastOrientation;
-    mutable Eigen::Vector3d lastAngularVelocity;
-    mutable bool orientationCacheValid;
-    mutable bool angularVelocityCacheValid;
+    void validateCache() const;
+    unsigned int dependencyVersion() const;
+
+    mutable TimeCache<Eigen::Quaterniond> orientationCache;
+    mutable TimeCache<Eigen::Vector3d> angularVelocityCache;
+
+    // FrameTree::editEpoch() when the dependencies were last checked
+    mutable std::atomic<unsigned int> checkedEpoch{ ~0u };
+
+    mutable std::mutex dependencyMutex;
+    mutable std::vector<const Body*> dependencies;
+    mutable unsigned int dependencyStamp{ 0 };
+    mutable bool dependenciesValid{ false };
 };
 
 
@@ -130,14 +160,15 @@ class J2000EquatorFrame : public ReferenceFrame
  *  y-axis is the cross product of x and z, and points toward the 90
  *  meridian.
  */
-class BodyFixedFrame : public ReferenceFrame
+class BodyFixedFrame : public CachingFrame
 {
  public:
     BodyFixedFrame(Selection center, Selection obj);
     virtual ~BodyFixedFrame() {};
-    Eigen::Quaterniond getOrientation(double tjd) const;
-    virtual Eigen::Vector3d getAngularVelocity(double tjd) const;
+    Eigen::Quaterniond computeOrientation(double tjd) const;
+    virtual Eigen::Vector3d computeAngularVelocity(double tjd) const;
     virtual bool isInertial() const;
+    virtual void getDependencies(std::vector<const Body*>& bodies) const;
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
                                       FrameType frameType) const;
@@ -147,15 +178,16 @@ class BodyFixedFrame : public ReferenceFrame
 };
 
 
-class BodyMeanEquatorFrame : public ReferenceFrame
+class BodyMeanEquatorFrame : public CachingFrame
 {
  public:
     BodyMeanEquatorFrame(Selection center, Selection obj, double freeze);
     BodyMeanEquatorFrame(Selection center, Selection obj);
     virtual ~BodyMeanEquatorFrame() {};
-    Eigen::Quaterniond getOrientation(double tjd) const;
-    virtual Eigen::Vector3d getAngularVelocity(double tjd) const;
+    Eigen::Quaterniond computeOrientation(double tjd) const;
+    virtual Eigen::Vector3d computeAngularVelocity(double tjd) const;
     virtual bool isInertial() const;
+    virtual void getDependencies(std::vector<const Body*>& bodies) const;
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
                                       FrameType frameType) const;
@@ -187,6 +219,9 @@ class FrameVector
      */
     unsigned int nestingDepth(unsigned int depth, unsigned int maxDepth) const;
 
+    //! Append the bodies that determine the direction of the vector.
+    void getDependencies(std::vector<const Body*>& bodies) const;
+
     enum FrameVectorType
     {
         RelativePosition,
@@ -238,6 +273,7 @@ class TwoVectorFrame : public CachingFrame
 
     Eigen::Quaterniond computeOrientation(double tjd) const;
     virtual bool isInertial() const;
+    virtual void getDependencies(std::vector<const Body*>& bodies) const;
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
                                       FrameType frameType) const;
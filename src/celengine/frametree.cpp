@@ -12,6 +12,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <limits>
 #include "celengine/frametree.h"
 #include "celengine/timeline.h"
 #include "celengine/timelinephase.h"
@@ -20,6 +21,16 @@
 #include <celengine/star.h>
 #include <celengine/location.h>
 #include <celengine/deepskyobj.h>
+#include <celutil/threadpool.h>
+
+using namespace Eigen;
+
+
+// Trees with fewer children are evaluated on the calling thread; the
+// overhead of dispatching work to the thread pool isn't worth it for them.
+static const unsigned int ParallelSnapshotThreshold = 8;
+
+std::atomic<unsigned int> FrameTree::s_editEpoch{ 0 };
 
 /* A FrameTree is hierarchy of solar system bodies organized according to
  * the relationship of their reference frames. An object will appear in as
@@ -157,6 +168,51 @@ FrameTree::recomputeBoundingSphere()
 }
 
 
+/*! Compute the snapshots at time tdb of all phases in this tree and its
+ *  subtrees that are active at that time. Subtrees are independent of
+ *  their siblings, so the children of large trees are evaluated in
+ *  parallel. This method must be called on the tree of a star.
+ */
+void
+FrameTree::updateSnapshot(double tdb)
+{
+    assert(starParent != nullptr);
+    updateSnapshot(tdb, Vector3d::Zero(), starParent->getPosition(tdb));
+}
+
+
+void
+FrameTree::updateSnapshot(double tdb,
+                          const Vector3d& center,
+                          const UniversalCoord& origin) const
+{
+    if (children.empty())
+        return;
+
+    vector<TimelinePhase*> active;
+    getActiveChildren(tdb, active);
+
+    auto update = [tdb, &active, &center, &origin](size_t i)
+    {
+        const TimelinePhase* phase = active[i];
+        Vector3d p = phase->updateSnapshot(tdb, center, origin);
+        const FrameTree* tree = phase->body()->getFrameTree();
+        if (tree != nullptr)
+            tree->updateSnapshot(tdb, p, origin);
+    };
+
+    if (active.size() >= ParallelSnapshotThreshold)
+    {
+        GetThreadPool()->parallelFor(0, active.size(), update);
+    }
+    else
+    {
+        for (size_t i = 0; i < active.size(); i++)
+            update(i);
+    }
+}
+
+
 /*! Add a new phase to this tree.
  */
 void
@@ -165,6 +221,10 @@ FrameTree::addChild(TimelinePhase* phase)
     phase->addRef();
     children.push_back(phase);
     markChanged();
+    markEdited();
+
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    m_indexValid = false;
 }
 
 
@@ -180,6 +240,10 @@ FrameTree::removeChild(TimelinePhase* phase)
         (*iter)->release();
         children.erase(iter);
         markChanged();
+        markEdited();
+
+        std::lock_guard<std::mutex> lock(m_indexMutex);
+        m_indexValid = false;
     }
 }
 
@@ -198,3 +262,85 @@ FrameTree::childCount() const
 {
     return children.size();
 }
+
+
+void
+FrameTree::buildPhaseIndex() const
+{
+    const double inf = numeric_limits<double>::infinity();
+
+    m_unboundedChildren.clear();
+    m_segmentBoundaries.clear();
+    m_segmentChildren.clear();
+
+    vector<unsigned int> bounded;
+    for (unsigned int i = 0; i < children.size(); i++)
+    {
+        const TimelinePhase* phase = children[i];
+        if (phase->startTime() == -inf && phase->endTime() == inf)
+        {
+            m_unboundedChildren.push_back(i);
+        }
+        else
+        {
+            bounded.push_back(i);
+            m_segmentBoundaries.push_back(phase->startTime());
+            m_segmentBoundaries.push_back(phase->endTime());
+        }
+    }
+
+    sort(m_segmentBoundaries.begin(), m_segmentBoundaries.end());
+    m_segmentBoundaries.erase(unique(m_segmentBoundaries.begin(), m_segmentBoundaries.end()),
+                              m_segmentBoundaries.end());
+
+    // Segment k covers [boundary[k - 1], boundary[k]); the first and last
+    // segments are open ended. A phase active over [start, end) is active
+    // throughout the segments that follow its start boundary up to and
+    // including the one that ends at its end boundary.
+    m_segmentChildren.resize(m_segmentBoundaries.size() + 1);
+    for (auto i : bounded)
+    {
+        const TimelinePhase* phase = children[i];
+        auto first = lower_bound(m_segmentBoundaries.begin(), m_segmentBoundaries.end(),
+                                 phase->startTime()) - m_segmentBoundaries.begin() + 1;
+        auto last = lower_bound(m_segmentBoundaries.begin(), m_segmentBoundaries.end(),
+                                phase->endTime()) - m_segmentBoundaries.begin();
+        for (auto k = first; k <= last; k++)
+            m_segmentChildren[k].push_back(i);
+    }
+
+    m_indexValid = true;
+}
+
+
+/*! Get the children of this tree whose phases are active at time tdb, in
+ *  the same order as getChild(). This is equivalent to testing includes()
+ *  on every child, but the cost depends only on the number of active
+ *  children, so bodies with long timelines made up of many phases don't
+ *  slow down the traversal.
+ */
+void
+FrameTree::getActiveChildren(double tdb, vector<TimelinePhase*>& active) const
+{
+    active.clear();
+
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    if (!m_indexValid)
+        buildPhaseIndex();
+
+    auto segment = upper_bound(m_segmentBoundaries.begin(), m_segmentBoundaries.end(), tdb)
+                   - m_segmentBoundaries.begin();
+    const vector<unsigned int>& bounded = m_segmentChildren[segment];
+
+    // Merge the two lists to preserve the child order
+    active.reserve(m_unboundedChildren.size() + bounded.size());
+    auto u = m_unboundedChildren.begin();
+    auto b = bounded.begin();
+    while (u != m_unboundedChildren.end() || b != bounded.end())
+    {
+        if (b == bounded.end() || (u != m_unboundedChildren.end() && *u < *b))
+            active.push_back(children[*u++]);
+        else
+            active.push_back(children[*b++]);
+    }
+}
@@ -13,13 +13,17 @@
 #ifndef _CELENGINE_FRAMETREE_H_
 #define _CELENGINE_FRAMETREE_H_
 
+#include <atomic>
 #include <vector>
 #include <cstddef>
+#include <mutex>
+#include <Eigen/Core>
 
 class Star;
 class Body;
 class ReferenceFrame;
 class TimelinePhase;
+class UniversalCoord;
 
 
 class FrameTree
@@ -43,10 +47,27 @@ public:
     void removeChild(TimelinePhase* phase);
     TimelinePhase* getChild(unsigned int n) const;
     unsigned int childCount() const;
+    void getActiveChildren(double tdb, std::vector<TimelinePhase*>& active) const;
 
     void markChanged();
     void markUpdated();
     void recomputeBoundingSphere();
+    void updateSnapshot(double tdb);
+
+    /*! Counter incremented whenever a phase is added to or removed from
+     *  any frame tree, or a body is given a new timeline, which is how the
+     *  trajectories and rotations of bodies are edited. Positions and
+     *  orientations cached under an older epoch may be stale.
+     */
+    static unsigned int editEpoch()
+    {
+        return s_editEpoch.load(std::memory_order_acquire);
+    }
+
+    static void markEdited()
+    {
+        s_editEpoch.fetch_add(1, std::memory_order_acq_rel);
+    }
 
     bool isRoot() const
     {
@@ -89,6 +110,12 @@ public:
         return m_childClassMask;
     }
 
+private:
+    void updateSnapshot(double tdb,
+                        const Eigen::Vector3d& center,
+                        const UniversalCoord& origin) const;
+    void buildPhaseIndex() const;
+
 private:
     Star* starParent;
     Body* bodyParent;
@@ -101,6 +128,19 @@ private:
     int m_childClassMask{ 0 };
 
     ReferenceFrame* defaultFrame;
+
+    // Index of the children that are active at a given time, built on
+    // demand after the children change. Children active at all times are
+    // kept apart; the start and end times of the others split the time
+    // line into segments, each listing the bounded children active
+    // throughout it. Indices are in child order.
+    mutable std::mutex m_indexMutex;
+    mutable bool m_indexValid{ false };
+    mutable std::vector<unsigned int> m_unboundedChildren;
+    mutable std::vector<double> m_segmentBoundaries;
+    mutable std::vector<std::vector<unsigned int>> m_segmentChildren;
+
+    static std::atomic<unsigned int> s_editEpoch;
 };
 
 #endif // _CELENGINE_FRAMETREE_H_
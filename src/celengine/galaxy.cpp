@@ -299,7 +299,9 @@ void Galaxy::renderGalaxyPointSprites(const Vector3f& offset,
     if (galaxyTex == nullptr)
     {
         galaxyTex = CreateProceduralTexture(width, height, GL_RGBA,
-                                            GalaxyTextureEval);
+                                            GalaxyTextureEval,
+                                            Texture::EdgeClamp, Texture::DefaultMipMaps,
+                                            "galaxy");
     }
     assert(galaxyTex != nullptr);
 
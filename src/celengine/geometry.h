@@ -11,6 +11,7 @@
 #ifndef _CELENGINE_GEOMETRY_H_
 #define _CELENGINE_GEOMETRY_H_
 
+#include <cstddef>
 #include <celmodel/material.h>
 #include <celmath/ray.h>
 
@@ -53,6 +54,14 @@ public:
     virtual void loadTextures()
     {
     }
+
+    /*! Return an estimate of the memory used by the geometry in bytes,
+     *  or zero if it isn't known.
+     */
+    virtual std::size_t getMemoryUsage() const
+    {
+        return 0;
+    }
 };
 
 #endif // _CELENGINE_GEOMETRY_H_
@@ -372,14 +372,19 @@ void Globular::renderGlobularPointSprites(
 
     if(centerTex[ic] == nullptr)
     {
-        centerTex[ic] = CreateProceduralTexture( cntrTexWidth, cntrTexHeight, GL_RGBA, CenterCloudTexEval);
+        string cacheName = fmt::sprintf("globular center %u", ic);
+        centerTex[ic] = CreateProceduralTexture( cntrTexWidth, cntrTexHeight, GL_RGBA, CenterCloudTexEval,
+                                                 Texture::EdgeClamp, Texture::DefaultMipMaps,
+                                                 cacheName.c_str());
     }
     assert(centerTex[ic] != nullptr);
 
     if (globularTex == nullptr)
     {
         globularTex = CreateProceduralTexture( starTexWidth, starTexHeight, GL_RGBA,
-                                               GlobularTextureEval);
+                                               GlobularTextureEval,
+                                               Texture::EdgeClamp, Texture::DefaultMipMaps,
+                                               "globular stars");
     }
     assert(globularTex != nullptr);
 
@@ -19,8 +19,13 @@ extern "C" {
 #include <jpeglib.h>
 }
 #include <png.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
 
 #include <celutil/debug.h>
+#include <celutil/threadpool.h>
 #include <celutil/util.h>
 #include <celutil/filetype.h>
 #include <GL/glew.h>
@@ -237,10 +242,61 @@ bool Image::hasAlpha() const
 }
 
 
+// Compute the normal of a texel from its height and the heights of its
+// neighbors in the previous column and row.
+static inline void computeNormal(int h00, int h10, int h01, float scale, unsigned char* n)
+{
+    float dx = (float) (h10 - h00) * (1.0f / 255.0f) * scale;
+    float dy = (float) (h01 - h00) * (1.0f / 255.0f) * scale;
+
+    auto mag = (float) sqrt(dx * dx + dy * dy + 1.0f);
+    float rmag = 1.0f / mag;
+
+    n[0] = (unsigned char) (128 + 127 * dx * rmag);
+    n[1] = (unsigned char) (128 + 127 * dy * rmag);
+    n[2] = (unsigned char) (128 + 127 * rmag);
+    n[3] = 255;
+}
+
+
+#ifdef USE_SSE2
+// Compute the normals of four texels at once. The operations are the same,
+// in the same order, as those of computeNormal(); SSE arithmetic, square
+// root and division are IEEE single precision, so the results are
+// identical.
+static inline void computeNormals4(__m128i h00, __m128i h10, __m128i h01, float scale, unsigned char* n)
+{
+    const __m128 k = _mm_set1_ps(1.0f / 255.0f);
+    const __m128 s = _mm_set1_ps(scale);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 c127 = _mm_set1_ps(127.0f);
+    const __m128 c128 = _mm_set1_ps(128.0f);
+
+    __m128 dx = _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(h10, h00)), k), s);
+    __m128 dy = _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(h01, h00)), k), s);
+
+    __m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), one));
+    __m128 rmag = _mm_div_ps(one, mag);
+
+    __m128i nx = _mm_cvttps_epi32(_mm_add_ps(c128, _mm_mul_ps(_mm_mul_ps(c127, dx), rmag)));
+    __m128i ny = _mm_cvttps_epi32(_mm_add_ps(c128, _mm_mul_ps(_mm_mul_ps(c127, dy), rmag)));
+    __m128i nz = _mm_cvttps_epi32(_mm_add_ps(c128, _mm_mul_ps(c127, rmag)));
+
+    // Pack the components of each texel into one little endian RGBA word
+    __m128i texels = _mm_or_si128(_mm_or_si128(nx, _mm_slli_epi32(ny, 8)),
+                                  _mm_or_si128(_mm_slli_epi32(nz, 16), _mm_set1_epi32((int) 0xff000000)));
+    _mm_storeu_si128((__m128i*) n, texels);
+}
+#endif
+
+
 // Convert an input height map to a normal map.  Ideally, a single channel
 // input should be used.  If not, the first color channel of the input image
 // is the one only one used when generating normals.  This produces the
 // expected results for grayscale values in RGB images.
+//
+// Normals are computed from differences between adjacent texels; rows are
+// converted in parallel, and four texels at a time where SSE2 is available.
 Image* Image::computeNormalMap(float scale, bool wrap) const
 {
     // Can't do anything with compressed input; there are probably some other
@@ -253,59 +309,107 @@ Image* Image::computeNormalMap(float scale, bool wrap) const
     unsigned char* nmPixels = normalMap->getPixels();
     int nmPitch = normalMap->getPitch();
 
-    // Compute normals using differences between adjacent texels.
-    for (int i = 0; i < height; i++)
+    GetThreadPool()->parallelFor(0, height, [&](size_t row)
     {
-        for (int j = 0; j < width; j++)
+        auto i = (int) row;
+        int i0 = i;
+        int i1 = i - 1;
+        if (i1 < 0)
         {
-            int i0 = i;
-            int j0 = j;
-            int i1 = i - 1;
-            int j1 = j - 1;
-            if (i1 < 0)
+            if (wrap)
             {
-                if (wrap)
-                {
-                    i1 = height - 1;
-                }
-                else
-                {
-                    i0++;
-                    i1++;
-                }
+                i1 = height - 1;
             }
-            if (j1 < 0)
+            else
             {
-                if (wrap)
-                {
-                    j1 = width - 1;
-                }
-                else
-                {
-                    j0++;
-                    j1++;
-                }
+                i0++;
+                i1++;
             }
+        }
+
+        const unsigned char* row0 = pixels + i0 * pitch;
+        const unsigned char* row1 = pixels + i1 * pitch;
+        unsigned char* nmRow = nmPixels + i * nmPitch;
+
+        // The first column uses the last one, or the second one, as its
+        // neighbor.
+        if (width > 0)
+        {
+            int j0 = wrap ? 0 : 1;
+            int j1 = wrap ? width - 1 : 0;
+            computeNormal(row0[j0 * components], row0[j1 * components], row1[j0 * components],
+                          scale, nmRow);
+        }
+
+        int j = 1;
+#ifdef USE_SSE2
+        for (; j + 4 <= width; j += 4)
+        {
+            const unsigned char* p0 = row0 + j * components;
+            const unsigned char* p1 = row1 + j * components;
+            int c = components;
+            __m128i h00 = _mm_setr_epi32(p0[0], p0[c], p0[2 * c], p0[3 * c]);
+            __m128i h10 = _mm_setr_epi32(p0[-c], p0[0], p0[c], p0[2 * c]);
+            __m128i h01 = _mm_setr_epi32(p1[0], p1[c], p1[2 * c], p1[3 * c]);
+            computeNormals4(h00, h10, h01, scale, nmRow + j * 4);
+        }
+#endif
+        for (; j < width; j++)
+        {
+            computeNormal(row0[j * components], row0[(j - 1) * components], row1[j * components],
+                          scale, nmRow + j * 4);
+        }
+    });
+
+    return normalMap;
+}
 
-            auto h00 = (int) pixels[i0 * pitch + j0 * components];
-            auto h10 = (int) pixels[i0 * pitch + j1 * components];
-            auto h01 = (int) pixels[i1 * pitch + j0 * components];
 
-            float dx = (float) (h10 - h00) * (1.0f / 255.0f) * scale;
-            float dy = (float) (h01 - h00) * (1.0f / 255.0f) * scale;
+// Return a copy of the image with a complete set of mipmaps; each texel of
+// a mip level is the average of four texels of the level above. Only the
+// base level of the image is used.
+Image* Image::computeMipMaps() const
+{
+    if (isCompressed())
+        return nullptr;
 
-            auto mag = (float) sqrt(dx * dx + dy * dy + 1.0f);
-            float rmag = 1.0f / mag;
+    int levels = 1;
+    while ((width >> levels) > 0 || (height >> levels) > 0)
+        levels++;
 
-            int n = i * nmPitch + j * 4;
-            nmPixels[n]     = (unsigned char) (128 + 127 * dx * rmag);
-            nmPixels[n + 1] = (unsigned char) (128 + 127 * dy * rmag);
-            nmPixels[n + 2] = (unsigned char) (128 + 127 * rmag);
-            nmPixels[n + 3] = 255;
+    auto* mipmapped = new Image(format, width, height, levels);
+    memcpy(mipmapped->getPixels(), pixels, calcMipLevelSize(format, width, height, 0));
+
+    for (int mip = 1; mip < levels; mip++)
+    {
+        const unsigned char* src = mipmapped->getMipLevel(mip - 1);
+        unsigned char* dst = mipmapped->getMipLevel(mip);
+        int srcWidth = max(width >> (mip - 1), 1);
+        int srcHeight = max(height >> (mip - 1), 1);
+        int srcPitch = pad(srcWidth * components);
+        int w = max(width >> mip, 1);
+        int h = max(height >> mip, 1);
+        int dstPitch = pad(w * components);
+
+        for (int i = 0; i < h; i++)
+        {
+            const unsigned char* row0 = src + min(2 * i, srcHeight - 1) * srcPitch;
+            const unsigned char* row1 = src + min(2 * i + 1, srcHeight - 1) * srcPitch;
+            unsigned char* out = dst + i * dstPitch;
+            for (int j = 0; j < w; j++)
+            {
+                int j0 = min(2 * j, srcWidth - 1) * components;
+                int j1 = min(2 * j + 1, srcWidth - 1) * components;
+                for (int c = 0; c < components; c++)
+                {
+                    int sum = row0[j0 + c] + row0[j1 + c] + row1[j0 + c] + row1[j1 + c];
+                    out[j * components + c] = (unsigned char) ((sum + 2) / 4);
+                }
+            }
         }
     }
 
-    return normalMap;
+    return mipmapped;
 }
 
 
@@ -340,9 +444,6 @@ Image* LoadImageFromFile(const string& filename)
 }
 
 
-
-
-
 struct my_error_mgr
 {
     struct jpeg_error_mgr pub;  // "public" fields
@@ -365,7 +466,9 @@ METHODDEF(void) my_error_exit(j_common_ptr cinfo)
 }
 
 
-Image* LoadJPEGImage(const string& filename, int /*unused*/)
+// Decode a JPEG image read either from a file or from memory, when in is
+// nullptr.
+static Image* DecodeJPEGImage(FILE* in, const unsigned char* data, size_t size)
 {
     Image* img = nullptr;
 
@@ -382,16 +485,6 @@ Image* LoadJPEGImage(const string& filename, int /*unused*/)
     int row_stride;        // physical row width in output buffer
     long cont;
 
-    // In this example we want to open the input file before doing anything else,
-    // so that the setjmp() error recovery below can assume the file is open.
-    // VERY IMPORTANT: use "b" option to fopen() if you are on a machine that
-    // requires it in order to read binary files.
-
-    FILE *in;
-    in = fopen(filename.c_str(), "rb");
-    if (!in)
-        return nullptr;
-
     // Step 1: allocate and initialize JPEG decompression object
     // We set up the normal JPEG error routines, then override error_exit.
     cinfo.err = jpeg_std_error(&jerr.pub);
@@ -400,9 +493,8 @@ Image* LoadJPEGImage(const string& filename, int /*unused*/)
     if (setjmp(jerr.setjmp_buffer))
     {
         // If we get here, the JPEG code has signaled an error.
-        // We need to clean up the JPEG object, close the input file, and return.
+        // We need to clean up the JPEG object and return.
         jpeg_destroy_decompress(&cinfo);
-        fclose(in);
         delete img;
 
         return nullptr;
@@ -412,7 +504,20 @@ Image* LoadJPEGImage(const string& filename, int /*unused*/)
     jpeg_create_decompress(&cinfo);
 
     // Step 2: specify data source (eg, a file)
-    jpeg_stdio_src(&cinfo, in);
+    if (in != nullptr)
+    {
+        jpeg_stdio_src(&cinfo, in);
+    }
+    else
+    {
+#if JPEG_LIB_VERSION >= 80 || defined(MEM_SRCDST_SUPPORTED)
+        jpeg_mem_src(&cinfo, const_cast<unsigned char*>(data), (unsigned long) size);
+#else
+        // No memory source in this version of the library
+        jpeg_destroy_decompress(&cinfo);
+        return nullptr;
+#endif
+    }
 
     // Step 3: read file parameters with jpeg_read_header()
     (void) jpeg_read_header(&cinfo, TRUE);
@@ -481,13 +586,6 @@ Image* LoadJPEGImage(const string& filename, int /*unused*/)
     // This is an important step since it will release a good deal of memory.
     jpeg_destroy_decompress(&cinfo);
 
-    // After finish_decompress, we can close the input file.
-    // Here we postpone it until after no more JPEG errors are possible,
-    // so as to simplify the setjmp error logic above.  (Actually, I don't
-    // think that jpeg_destroy can do an error exit, but why assume anything...
-
-    fclose(in);
-
     // At this point you may want to check to see whether any corrupt-data
     // warnings occurred (test whether jerr.pub.num_warnings is nonzero).
 
@@ -495,6 +593,21 @@ Image* LoadJPEGImage(const string& filename, int /*unused*/)
 }
 
 
+Image* LoadJPEGImage(const string& filename, int /*unused*/)
+{
+    // VERY IMPORTANT: use "b" option to fopen() if you are on a machine that
+    // requires it in order to read binary files.
+    FILE* in = fopen(filename.c_str(), "rb");
+    if (!in)
+        return nullptr;
+
+    Image* img = DecodeJPEGImage(in, nullptr, 0);
+    fclose(in);
+
+    return img;
+}
+
+
 void PNGReadData(png_structp png_ptr, png_bytep data, png_size_t length)
 {
     auto* fp = (FILE*) png_get_io_ptr(png_ptr);
@@ -503,52 +616,50 @@ void PNGReadData(png_structp png_ptr, png_bytep data, png_size_t length)
 }
 
 
-Image* LoadPNGImage(const string& filename)
+struct PNGMemoryReader
+{
+    const unsigned char* data;
+    size_t size;
+    size_t position;
+};
+
+
+static void PNGReadMemory(png_structp png_ptr, png_bytep data, png_size_t length)
+{
+    auto* reader = (PNGMemoryReader*) png_get_io_ptr(png_ptr);
+    if (length > reader->size - reader->position)
+        png_error(png_ptr, "Read past the end of PNG data");
+
+    memcpy(data, reader->data + reader->position, length);
+    reader->position += length;
+}
+
+
+// Decode a PNG image whose signature has already been read and checked;
+// the rest of the image is read with readData.
+static Image* DecodePNGImage(png_rw_ptr readData, void* io, const string& filename)
 {
-    char header[8];
     png_structp png_ptr;
     png_infop info_ptr;
     png_uint_32 width, height;
     int bit_depth, color_type, interlace_type;
-    FILE* fp = nullptr;
     Image* img = nullptr;
     png_bytep* row_pointers = nullptr;
 
-    fp = fopen(filename.c_str(), "rb");
-    if (fp == nullptr)
-    {
-        fmt::fprintf(clog, _("Error opening image file %s\n"), filename);
-        return nullptr;
-    }
-
-    size_t elements_read;
-    elements_read = fread(header, 1, sizeof(header), fp);
-    if (elements_read == 0 || png_sig_cmp((unsigned char*) header, 0, sizeof(header)))
-    {
-        fmt::fprintf(clog, _("Error: %s is not a PNG file.\n"), filename);
-        fclose(fp);
-        return nullptr;
-    }
-
     png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,
                                      nullptr, nullptr, nullptr);
     if (png_ptr == nullptr)
-    {
-        fclose(fp);
         return nullptr;
-    }
 
     info_ptr = png_create_info_struct(png_ptr);
     if (info_ptr == nullptr)
     {
-        fclose(fp);
         png_destroy_read_struct(&png_ptr, (png_infopp) nullptr, (png_infopp) nullptr);
         return nullptr;
     }
 
     if (setjmp(png_jmpbuf(png_ptr)))
     {
-        fclose(fp);
         delete img;
         png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) nullptr);
         fmt::fprintf(clog, _("Error reading PNG image file %s\n"), filename);
@@ -556,8 +667,8 @@ Image* LoadPNGImage(const string& filename)
     }
 
     // png_init_io(png_ptr, fp);
-    png_set_read_fn(png_ptr, (void*) fp, PNGReadData);
-    png_set_sig_bytes(png_ptr, sizeof(header));
+    png_set_read_fn(png_ptr, io, readData);
+    png_set_sig_bytes(png_ptr, 8);
 
     png_read_info(png_ptr, info_ptr);
 
@@ -623,12 +734,89 @@ Image* LoadPNGImage(const string& filename)
     png_read_end(png_ptr, nullptr);
     png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
 
+    return img;
+}
+
+
+Image* LoadPNGImage(const string& filename)
+{
+    unsigned char header[8];
+
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (fp == nullptr)
+    {
+        fmt::fprintf(clog, _("Error opening image file %s\n"), filename);
+        return nullptr;
+    }
+
+    size_t elements_read;
+    elements_read = fread(header, 1, sizeof(header), fp);
+    if (elements_read != sizeof(header) || png_sig_cmp(header, 0, sizeof(header)))
+    {
+        fmt::fprintf(clog, _("Error: %s is not a PNG file.\n"), filename);
+        fclose(fp);
+        return nullptr;
+    }
+
+    Image* img = DecodePNGImage(PNGReadData, fp, filename);
     fclose(fp);
 
     return img;
 }
 
 
+// Stream buffer reading from a block of memory without copying it
+class MemoryBuffer : public streambuf
+{
+ public:
+    MemoryBuffer(const unsigned char* data, size_t size)
+    {
+        char* p = reinterpret_cast<char*>(const_cast<unsigned char*>(data));
+        setg(p, p, p + size);
+    }
+};
+
+
+Image* LoadImageFromMemory(const unsigned char* data,
+                           size_t size,
+                           ContentType type,
+                           const string& name)
+{
+    Image* img = nullptr;
+
+    switch (type)
+    {
+    case Content_JPEG:
+        img = DecodeJPEGImage(nullptr, data, size);
+        break;
+    case Content_PNG:
+        if (size < 8 || png_sig_cmp(const_cast<unsigned char*>(data), 0, 8))
+        {
+            fmt::fprintf(clog, _("Error: %s is not a PNG file.\n"), name);
+        }
+        else
+        {
+            PNGMemoryReader reader = { data, size, 8 };
+            img = DecodePNGImage(PNGReadMemory, &reader, name);
+        }
+        break;
+    case Content_DDS:
+    case Content_DXT5NormalMap:
+        {
+            MemoryBuffer buffer(data, size);
+            istream in(&buffer);
+            img = LoadDDSImage(in, name);
+        }
+        break;
+    default:
+        fmt::fprintf(clog, _("%s: unsupported image type.\n"), name);
+        break;
+    }
+
+    return img;
+}
+
+
 // BMP file definitions--can't use windows.h because we might not be
 // built on Windows!
 typedef struct
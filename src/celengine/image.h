@@ -10,7 +10,10 @@
 #ifndef _CELENGINE_IMAGE_H_
 #define _CELENGINE_IMAGE_H_
 
+#include <cstddef>
+#include <iosfwd>
 #include <string>
+#include <celutil/filetype.h>
 
 // The image class supports multiple GL formats, including compressed ones.
 // Mipmaps may be stored within an image as well.  The mipmaps are stored in
@@ -41,6 +44,7 @@ class Image
     bool hasAlpha() const;
 
     Image* computeNormalMap(float scale, bool wrap) const;
+    Image* computeMipMaps() const;
 
     enum {
         ColorChannel = 1,
@@ -63,7 +67,17 @@ extern Image* LoadJPEGImage(const std::string& filename,
 extern Image* LoadBMPImage(const std::string& filename);
 extern Image* LoadPNGImage(const std::string& filename);
 extern Image* LoadDDSImage(const std::string& filename);
+extern Image* LoadDDSImage(std::istream& in, const std::string& filename);
 
 extern Image* LoadImageFromFile(const std::string& filename);
 
+/*! Decode an image of the given type from a block of memory, such as a
+ *  tile read from an archive. Only DDS, JPEG and PNG images are supported;
+ *  the name is used in error messages.
+ */
+extern Image* LoadImageFromMemory(const unsigned char* data,
+                                  std::size_t size,
+                                  ContentType type,
+                                  const std::string& name);
+
 #endif // _CELENGINE_IMAGE_H_
@@ -0,0 +1,275 @@
+// imagedecoder.cpp
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Read and decode images on a pool of worker threads.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <celutil/threadpool.h>
+#include "image.h"
+#include "imagedecoder.h"
+
+using namespace std;
+
+
+static ImageDecoder* CreateImageDecoder()
+{
+    // Decoding is mostly limited by reading the files, so a few
+    // workers are enough.
+    unsigned int n = thread::hardware_concurrency() / 2;
+    return new ImageDecoder(max(1u, min(n, 4u)));
+}
+
+
+ImageDecoder* GetImageDecoder()
+{
+    // Initialization of a local static is thread safe
+    static ImageDecoder* imageDecoder = CreateImageDecoder();
+    return imageDecoder;
+}
+
+
+ImageDecoder::ImageDecoder(unsigned int nThreads) :
+    workers(new ThreadPool(nThreads))
+{
+}
+
+
+ImageDecoder::~ImageDecoder()
+{
+    // Queued requests are cancelled rather than decoded
+    {
+        lock_guard<std::mutex> lock(mutex);
+        for (auto& queue : queues)
+        {
+            for (auto& request : queue)
+            {
+                request->state = Request::Finished;
+                request->cancelled = true;
+                request->decode = nullptr;
+            }
+            queue.clear();
+        }
+    }
+    finished.notify_all();
+
+    workers.reset();
+}
+
+
+ImageDecoder::RequestPtr ImageDecoder::submit(const string& filename, Priority priority)
+{
+    return submit(DetermineFileType(filename),
+                  [filename]() { return LoadImageFromFile(filename); },
+                  priority);
+}
+
+
+ImageDecoder::RequestPtr ImageDecoder::submit(ContentType type,
+                                              const DecodeFunction& decode,
+                                              Priority priority)
+{
+    RequestPtr request(new Request(this, type, decode));
+    {
+        lock_guard<std::mutex> lock(mutex);
+        queues[priority].push_back(request);
+    }
+
+    // Every worker task starts the most urgent request queued at the
+    // time; there is one task for every request.
+    workers->submit([this]() { runNext(); });
+
+    return request;
+}
+
+
+Image* ImageDecoder::load(const string& filename)
+{
+    Request request(this, DetermineFileType(filename),
+                    [&filename]() { return LoadImageFromFile(filename); });
+    request.state = Request::Running;
+    execute(request);
+
+    Image* img = request.image;
+    request.image = nullptr;
+    return img;
+}
+
+
+void ImageDecoder::runNext()
+{
+    RequestPtr request;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        for (auto& queue : queues)
+        {
+            if (!queue.empty())
+            {
+                request = queue.front();
+                queue.pop_front();
+                break;
+            }
+        }
+
+        // Cancelled requests and those taken over by a waiting thread
+        // leave tasks without a request.
+        if (request == nullptr)
+            return;
+
+        request->state = Request::Running;
+    }
+
+    execute(*request);
+}
+
+
+// Decode the image of a request that has been removed from the queue, and
+// account for it.
+void ImageDecoder::execute(Request& request)
+{
+    auto startTime = chrono::steady_clock::now();
+    Image* img = request.decode();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - startTime;
+
+    {
+        lock_guard<std::mutex> lock(mutex);
+
+        FormatStats& stats = formatStats[request.type];
+        if (img != nullptr)
+        {
+            stats.images++;
+            stats.decodedBytes += (uint64_t) img->getSize();
+            stats.decodeTime += elapsed.count();
+            decodedBytes += (uint64_t) img->getSize();
+        }
+        else
+        {
+            stats.failures++;
+        }
+
+        if (request.cancelled)
+        {
+            delete img;
+            img = nullptr;
+        }
+
+        request.image = img;
+        request.state = Request::Finished;
+        request.decode = nullptr;
+    }
+    finished.notify_all();
+}
+
+
+// Remove a request from its queue; the mutex must be held.
+bool ImageDecoder::dequeue(const Request* request)
+{
+    for (auto& queue : queues)
+    {
+        auto iter = find_if(queue.begin(), queue.end(),
+                            [request](const RequestPtr& r) { return r.get() == request; });
+        if (iter != queue.end())
+        {
+            queue.erase(iter);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+map<ContentType, ImageDecoder::FormatStats> ImageDecoder::getFormatStats() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    return formatStats;
+}
+
+
+uint64_t ImageDecoder::getDecodedBytes() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    return decodedBytes;
+}
+
+
+uint64_t ImageDecoder::getCancelledCount() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    return cancelledCount;
+}
+
+
+size_t ImageDecoder::getQueuedCount() const
+{
+    lock_guard<std::mutex> lock(mutex);
+    size_t n = 0;
+    for (const auto& queue : queues)
+        n += queue.size();
+    return n;
+}
+
+
+ImageDecoder::Request::~Request()
+{
+    delete image;
+}
+
+
+bool ImageDecoder::Request::isReady() const
+{
+    lock_guard<std::mutex> lock(decoder->mutex);
+    return state == Finished;
+}
+
+
+Image* ImageDecoder::Request::wait()
+{
+    unique_lock<std::mutex> lock(decoder->mutex);
+
+    // Rather than wait for a worker to get to it, decode the image here.
+    if (state == Queued && decoder->dequeue(this))
+    {
+        state = Running;
+        lock.unlock();
+        decoder->execute(*this);
+        lock.lock();
+    }
+
+    decoder->finished.wait(lock, [this]() { return state == Finished; });
+
+    Image* img = image;
+    image = nullptr;
+    return img;
+}
+
+
+void ImageDecoder::Request::cancel()
+{
+    lock_guard<std::mutex> lock(decoder->mutex);
+    if (cancelled)
+        return;
+
+    cancelled = true;
+    decoder->cancelledCount++;
+
+    if (state == Queued)
+    {
+        decoder->dequeue(this);
+        state = Finished;
+        decode = nullptr;
+        decoder->finished.notify_all();
+    }
+    else if (state == Finished)
+    {
+        delete image;
+        image = nullptr;
+    }
+}
@@ -0,0 +1,158 @@
+// imagedecoder.h
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Read and decode images on a pool of worker threads.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <celutil/filetype.h>
+
+class Image;
+class ThreadPool;
+
+
+/*! ImageDecoder runs image decoding requests on worker threads of its
+ *  own, so that loading textures doesn't hold up the per-frame work on the
+ *  shared thread pool. Requests are started in order of priority, and
+ *  those of the same priority in the order they were submitted.
+ *
+ *  Waiting for a request that hasn't been started yet decodes the image
+ *  on the waiting thread instead, so images needed right away are
+ *  submitted like any other. A cancelled request that is still queued
+ *  is never decoded; one that is being decoded finishes, but its image is
+ *  discarded.
+ *
+ *  The decoder keeps count of the bytes of decoded images and of the time
+ *  spent decoding each image format.
+ */
+class ImageDecoder
+{
+ public:
+    enum Priority
+    {
+        Normal        = 0,
+        Prefetch      = 1,  // may be needed soon
+        PriorityCount = 2,
+    };
+
+    class Request;
+    using RequestPtr = std::shared_ptr<Request>;
+    using DecodeFunction = std::function<Image*()>;
+
+    struct FormatStats
+    {
+        uint64_t images{ 0 };
+        uint64_t failures{ 0 };
+        uint64_t decodedBytes{ 0 };
+        double decodeTime{ 0.0 };   // seconds, summed over all workers
+
+        //! Decoded bytes per second of decoding time
+        double throughput() const
+        {
+            return decodeTime > 0.0 ? (double) decodedBytes / decodeTime : 0.0;
+        }
+    };
+
+    explicit ImageDecoder(unsigned int nThreads);
+    ~ImageDecoder();
+
+    ImageDecoder(const ImageDecoder&) = delete;
+    ImageDecoder& operator=(const ImageDecoder&) = delete;
+
+    //! Queue the decoding of an image file.
+    RequestPtr submit(const std::string& filename, Priority priority);
+
+    /*! Queue a function that decodes an image of the given type, for
+     *  images that aren't read from a file of their own.
+     */
+    RequestPtr submit(ContentType type, const DecodeFunction& decode, Priority priority);
+
+    //! Decode an image file on the calling thread, keeping count of it.
+    Image* load(const std::string& filename);
+
+    std::map<ContentType, FormatStats> getFormatStats() const;
+    uint64_t getDecodedBytes() const;
+    uint64_t getCancelledCount() const;
+    std::size_t getQueuedCount() const;
+
+ private:
+    void runNext();
+    void execute(Request& request);
+    bool dequeue(const Request* request);
+
+    std::deque<RequestPtr> queues[PriorityCount];
+    std::map<ContentType, FormatStats> formatStats;
+    uint64_t decodedBytes{ 0 };
+    uint64_t cancelledCount{ 0 };
+
+    mutable std::mutex mutex;
+    std::condition_variable finished;
+
+    // Last, so that the workers are stopped before anything else is
+    // destroyed.
+    std::unique_ptr<ThreadPool> workers;
+};
+
+
+class ImageDecoder::Request
+{
+ public:
+    ~Request();
+
+    //! True once the request has finished or was cancelled.
+    bool isReady() const;
+
+    /*! Wait for the request to finish and take ownership of the decoded
+     *  image. Returns nullptr if decoding failed or the request was
+     *  cancelled.
+     */
+    Image* wait();
+
+    void cancel();
+
+ private:
+    friend class ImageDecoder;
+
+    enum State
+    {
+        Queued,
+        Running,
+        Finished,
+    };
+
+    Request(ImageDecoder* _decoder, ContentType _type, DecodeFunction _decode) :
+        decoder(_decoder),
+        type(_type),
+        decode(std::move(_decode))
+    {
+    }
+
+    ImageDecoder* decoder;
+    ContentType type;
+    DecodeFunction decode;
+    State state{ Queued };
+    bool cancelled{ false };
+    Image* image{ nullptr };
+};
+
+
+/*! Return the decoder shared by texture, virtual texture and overlay
+ *  image loading.
+ */
+extern ImageDecoder* GetImageDecoder();
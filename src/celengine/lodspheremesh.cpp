@@ -142,6 +142,18 @@ static Vector3f spherePoint(int theta, int phi)
 }
 
 
+// Level of detail of a texture on a sphere whose disc is pixWidth pixels
+// across.
+static int textureLOD(Texture* tex, float pixWidth)
+{
+    float pixelsPerTexel = pixWidth * 2.0f /
+        ((float) tex->getWidth() / 2.0f);
+    double l = log(pixelsPerTexel) / log(2.0);
+
+    return max(min(tex->getLODCount() - 1, (int) l), 0);
+}
+
+
 void LODSphereMesh::render(const Frustum& frustum,
                            float pixWidth,
                            Texture** tex,
@@ -224,11 +236,7 @@ void LODSphereMesh::render(unsigned int attributes,
     int minSplit = 1;
     for (i = 0; i < nTextures; i++)
     {
-        float pixelsPerTexel = pixWidth * 2.0f /
-            ((float) tex[i]->getWidth() / 2.0f);
-        double l = log(pixelsPerTexel) / log(2.0);
-
-        ri.texLOD[i] = max(min(tex[i]->getLODCount() - 1, (int) l), 0);
+        ri.texLOD[i] = textureLOD(tex[i], pixWidth);
         if (tex[i]->getUTileCount(ri.texLOD[i]) > minSplit)
             minSplit = tex[i]->getUTileCount(ri.texLOD[i]);
         if (tex[i]->getVTileCount(ri.texLOD[i]) > minSplit)
@@ -528,6 +536,60 @@ void LODSphereMesh::render(unsigned int attributes,
 }
 
 
+/*! Hint to the textures which tiles will be drawn for an observer at eyePos
+ *  looking in the direction viewDir, both in the sphere's coordinates: the
+ *  tiles around the point looked at, at the level of detail that render()
+ *  would choose for a disc pixWidth pixels across, raised by lodBias. If
+ *  the view direction misses the sphere, the tiles below the observer are
+ *  used.
+ */
+void LODSphereMesh::prefetch(const Vector3f& eyePos,
+                             const Vector3f& viewDir,
+                             float pixWidth,
+                             int lodBias,
+                             Texture** tex,
+                             int nTextures)
+{
+    // Intersect the view ray with the unit sphere
+    Vector3f p = eyePos.normalized();
+    float b = eyePos.dot(viewDir);
+    float c = eyePos.squaredNorm() - 1.0f;
+    float discriminant = b * b - c;
+    if (c > 0.0f && b < 0.0f && discriminant >= 0.0f)
+        p = (eyePos + viewDir * (-b - sqrt(discriminant))).normalized();
+
+    // The inverse of spherePoint(); theta is in [0, 1) and phi in [0, 1]
+    auto theta = (float) (atan2(p.z(), p.x()) / (2.0 * PI));
+    if (theta < 0.0f)
+        theta += 1.0f;
+    auto phi = (float) (asin(max(-1.0f, min(p.y(), 1.0f))) / PI + 0.5);
+
+    for (int i = 0; i < nTextures; i++)
+    {
+        int lod = textureLOD(tex[i], pixWidth) + lodBias;
+        if (lod < 0 || lod >= tex[i]->getLODCount())
+            continue;
+
+        // Tiles are numbered from the end, as in renderSection()
+        int uTiles = tex[i]->getUTileCount(lod);
+        int vTiles = tex[i]->getVTileCount(lod);
+        int u = min((int) (theta * uTiles), uTiles - 1);
+        int v = min((int) (phi * vTiles), vTiles - 1);
+
+        for (int dv = -1; dv <= 1; dv++)
+        {
+            if (v + dv < 0 || v + dv >= vTiles)
+                continue;
+            for (int du = -1; du <= 1; du++)
+            {
+                int tu = (u + du + uTiles) % uTiles;
+                tex[i]->prefetchTile(lod, uTiles - tu - 1, vTiles - (v + dv) - 1);
+            }
+        }
+    }
+}
+
+
 int LODSphereMesh::renderPatches(int phi0, int theta0,
                                  int extent,
                                  int level,
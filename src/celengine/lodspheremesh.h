@@ -36,6 +36,12 @@ public:
     void render(const celmath::Frustum&, float pixWidth,
                 Texture** tex, int nTextures);
 
+    void prefetch(const Eigen::Vector3f& eyePos,
+                  const Eigen::Vector3f& viewDir,
+                  float pixWidth,
+                  int lodBias,
+                  Texture** tex, int nTextures);
+
     enum {
         Normals    = 0x01,
         Tangents   = 0x02,
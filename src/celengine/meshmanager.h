@@ -51,6 +51,10 @@ class GeometryInfo : public ResourceInfo<Geometry>
 
     virtual std::string resolve(const std::string&);
     virtual Geometry* load(const std::string&);
+    virtual std::size_t getMemoryUsage() const
+    {
+        return resource != nullptr ? resource->getMemoryUsage() : 0;
+    }
 };
 
 inline bool operator<(const GeometryInfo& g0, const GeometryInfo& g1)
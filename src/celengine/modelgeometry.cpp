@@ -179,6 +179,29 @@ ModelGeometry::isNormalized() const
 }
 
 
+/*! Return the size of the vertex and index data of the model, counting
+ *  the vertex lists copied into vertex buffer objects twice.
+ */
+size_t
+ModelGeometry::getMemoryUsage() const
+{
+    size_t size = 0;
+    for (unsigned int i = 0; i < m_model->getMeshCount(); ++i)
+    {
+        const Mesh* mesh = m_model->getMesh(i);
+        size_t vertexSize = (size_t) mesh->getVertexCount() * mesh->getVertexStride();
+        size += vertexSize;
+        if (vertexSize > MinVBOSize)
+            size += vertexSize;
+
+        for (unsigned int j = 0; j < mesh->getGroupCount(); ++j)
+            size += mesh->getGroup(j)->nIndices * sizeof(Mesh::index32);
+    }
+
+    return size;
+}
+
+
 bool
 ModelGeometry::usesTextureType(Material::TextureSemantic t) const
 {
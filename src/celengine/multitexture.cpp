@@ -60,12 +60,34 @@ void MultiResTexture::setTexture(const string& source, const string& path,
 
 
 Texture* MultiResTexture::find(unsigned int resolution)
+{
+    return find(resolution, false);
+}
+
+
+/*! Find the texture without waiting for it to be loaded. While the
+ *  preferred resolution is loading, any other resolution that has been
+ *  loaded already is returned instead, or nullptr if there is none.
+ */
+Texture* MultiResTexture::findAsync(unsigned int resolution)
+{
+    return find(resolution, true);
+}
+
+
+Texture* MultiResTexture::find(unsigned int resolution, bool async)
 {
     TextureManager* texMan = GetTextureManager();
+    auto findTexture = [texMan, async](ResourceHandle h)
+    {
+        return async ? texMan->findAsync(h) : texMan->find(h);
+    };
 
-    Texture* res = texMan->find(tex[resolution]);
+    Texture* res = findTexture(tex[resolution]);
     if (res != nullptr)
         return res;
+    if (texMan->getState(tex[resolution]) == ResourceLoading)
+        return findLoaded();
 
     // Preferred resolution isn't available; try the second choice
     // Set these to some defaults to avoid GCC complaints
@@ -89,13 +111,33 @@ Texture* MultiResTexture::find(unsigned int resolution)
     }
 
     tex[resolution] = tex[secondChoice];
-    res = texMan->find(tex[resolution]);
+    res = findTexture(tex[resolution]);
     if (res != nullptr)
         return res;
+    if (texMan->getState(tex[resolution]) == ResourceLoading)
+        return findLoaded();
 
     tex[resolution] = tex[lastResort];
 
-    return texMan->find(tex[resolution]);
+    res = findTexture(tex[resolution]);
+    if (res == nullptr && texMan->getState(tex[resolution]) == ResourceLoading)
+        return findLoaded();
+
+    return res;
+}
+
+
+// Return any resolution that has already been loaded
+Texture* MultiResTexture::findLoaded()
+{
+    TextureManager* texMan = GetTextureManager();
+    for (ResourceHandle h : tex)
+    {
+        if (texMan->getState(h) == ResourceLoaded)
+            return texMan->find(h);
+    }
+
+    return nullptr;
 }
 
 
@@ -40,9 +40,14 @@ class MultiResTexture
                     float bumpHeight,
                     unsigned int flags);
     Texture* find(unsigned int resolution);
+    Texture* findAsync(unsigned int resolution);
 
     bool isValid() const;
 
+ private:
+    Texture* find(unsigned int resolution, bool async);
+    Texture* findLoaded();
+
  public:
     ResourceHandle tex[3];
 };
@@ -0,0 +1,157 @@
+// orbitpathcache.cpp
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Cache of sampled orbit paths, generated in the background.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+#include <celutil/threadpool.h>
+#include "orbitpathcache.h"
+
+using namespace std;
+
+
+OrbitPathCache::OrbitPathCache(size_t memoryBudget) :
+    m_memoryBudget(memoryBudget)
+{
+}
+
+
+OrbitPathCache::~OrbitPathCache()
+{
+    clear();
+}
+
+
+/*! Return the path of orbit, or nullptr if the path hasn't been requested
+ *  or its samples aren't ready yet. The first call in a new frame discards
+ *  old paths if the cache is over budget.
+ */
+CurvePlot* OrbitPathCache::find(const Orbit* orbit, uint32_t frame)
+{
+    if (frame != lastEviction)
+    {
+        evict(frame);
+        lastEviction = frame;
+    }
+
+    auto iter = entries.find(orbit);
+    if (iter == entries.end())
+        return nullptr;
+
+    Entry& entry = iter->second;
+    entry.lastUsed = frame;
+    if (entry.plot == nullptr &&
+        entry.pending.wait_for(chrono::seconds(0)) == future_status::ready)
+    {
+        entry.plot = entry.pending.get();
+    }
+
+    return entry.plot;
+}
+
+
+/*! Start sampling the path of orbit between startTime and endTime in the
+ *  background. Nothing is done if the path is already in the cache or
+ *  being sampled.
+ */
+void OrbitPathCache::request(const Orbit* orbit, double startTime, double endTime, uint32_t frame)
+{
+    if (entries.find(orbit) != entries.end())
+        return;
+
+    Entry& entry = entries[orbit];
+    entry.lastUsed = frame;
+    entry.cancelled = make_shared<atomic<bool>>(false);
+    shared_ptr<atomic<bool>> cancelled = entry.cancelled;
+    entry.pending = GetThreadPool()->submit([orbit, startTime, endTime, cancelled]()
+    {
+        // The orbit may be about to be deleted if the request was cancelled
+        // before the task started.
+        if (*cancelled)
+            return (CurvePlot*) nullptr;
+
+        auto plot = new CurvePlot();
+        OrbitSampler sampler;
+        orbit->sample(startTime, endTime, sampler);
+        sampler.insertForward(plot);
+        return plot;
+    });
+}
+
+
+/*! Remove all paths. Paths that haven't started being sampled are
+ *  cancelled, and the ones being sampled are waited for.
+ */
+void OrbitPathCache::clear()
+{
+    for (auto& e : entries)
+    {
+        if (e.second.pending.valid())
+            *e.second.cancelled = true;
+    }
+
+    for (auto& e : entries)
+    {
+        if (e.second.pending.valid())
+            delete e.second.pending.get();
+        delete e.second.plot;
+    }
+    entries.clear();
+}
+
+
+void OrbitPathCache::setMemoryBudget(size_t memoryBudget)
+{
+    m_memoryBudget = memoryBudget;
+}
+
+
+/*! Return the approximate number of bytes used by the sampled paths. */
+size_t OrbitPathCache::memoryUsage() const
+{
+    size_t usage = 0;
+    for (const auto& e : entries)
+    {
+        if (e.second.plot != nullptr)
+            usage += sizeof(CurvePlot) + e.second.plot->sampleCount() * sizeof(CurvePlotSample);
+    }
+    return usage;
+}
+
+
+void OrbitPathCache::evict(uint32_t frame)
+{
+    size_t usage = memoryUsage();
+    if (usage <= m_memoryBudget)
+        return;
+
+    // Paths drawn in the previous frame are kept even if they don't fit in
+    // the budget; discarding them would only resample them right away.
+    vector<pair<uint32_t, const Orbit*>> candidates;
+    for (const auto& e : entries)
+    {
+        if (e.second.plot != nullptr && frame - e.second.lastUsed > 1)
+            candidates.emplace_back(e.second.lastUsed, e.first);
+    }
+    sort(candidates.begin(), candidates.end());
+
+    for (const auto& c : candidates)
+    {
+        if (usage <= m_memoryBudget)
+            break;
+
+        auto iter = entries.find(c.second);
+        CurvePlot* plot = iter->second.plot;
+        usage -= sizeof(CurvePlot) + plot->sampleCount() * sizeof(CurvePlotSample);
+        delete plot;
+        entries.erase(iter);
+    }
+}
@@ -0,0 +1,101 @@
+// orbitpathcache.h
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Cache of sampled orbit paths, generated in the background.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <vector>
+#include <celephem/orbit.h>
+#include "curveplot.h"
+
+
+class OrbitSampler : public OrbitSampleProc
+{
+public:
+    std::vector<CurvePlotSample> samples;
+
+    OrbitSampler() = default;
+
+    void sample(double t, const Eigen::Vector3d& position, const Eigen::Vector3d& velocity)
+    {
+        CurvePlotSample samp;
+        samp.t = t;
+        samp.position = position;
+        samp.velocity = velocity;
+        samples.push_back(samp);
+    }
+
+    void insertForward(CurvePlot* plot)
+    {
+        for (const auto& sample : samples)
+        {
+            plot->addSample(sample);
+        }
+    }
+
+    void insertBackward(CurvePlot* plot)
+    {
+        for (auto iter = samples.rbegin(); iter != samples.rend(); ++iter)
+        {
+            plot->addSample(*iter);
+        }
+    }
+};
+
+
+/*! OrbitPathCache holds the sampled paths of orbits. Missing paths are
+ *  sampled on the thread pool, so requesting a path never stalls the render
+ *  thread; the path simply becomes available in a later frame. When the
+ *  memory used by the paths exceeds the budget, the least recently used
+ *  paths are discarded.
+ *
+ *  The background tasks use the orbits directly. Orbits are never deleted
+ *  while they may be rendered, since timeline phases don't own them, but
+ *  they may depend on state that is: call clear() before deleting anything
+ *  an orbit depends on, such as the Lua state of a scripted orbit.
+ */
+class OrbitPathCache
+{
+ public:
+    explicit OrbitPathCache(std::size_t memoryBudget);
+    ~OrbitPathCache();
+
+    OrbitPathCache(const OrbitPathCache&) = delete;
+    OrbitPathCache& operator=(const OrbitPathCache&) = delete;
+
+    CurvePlot* find(const Orbit* orbit, uint32_t frame);
+    void request(const Orbit* orbit, double startTime, double endTime, uint32_t frame);
+    void clear();
+
+    std::size_t memoryBudget() const { return m_memoryBudget; }
+    void setMemoryBudget(std::size_t memoryBudget);
+    std::size_t memoryUsage() const;
+
+ private:
+    struct Entry
+    {
+        CurvePlot* plot{ nullptr };
+        std::future<CurvePlot*> pending;
+        std::shared_ptr<std::atomic<bool>> cancelled;
+        uint32_t lastUsed{ 0 };
+    };
+
+    void evict(uint32_t frame);
+
+    std::map<const Orbit*, Entry> entries;
+    std::size_t m_memoryBudget;
+    uint32_t lastEviction{ 0 };
+};
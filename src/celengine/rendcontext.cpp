@@ -450,7 +450,7 @@ GLSL_RenderContext::makeCurrent(const Material& m)
 
     if (lightingState.shadowingRingSystem)
     {
-        Texture* ringsTex = lightingState.shadowingRingSystem->texture.find(medres);
+        Texture* ringsTex = lightingState.shadowingRingSystem->texture.findAsync(medres);
         if (ringsTex != nullptr)
         {
             glActiveTexture(GL_TEXTURE0 + nTextures);
@@ -48,6 +48,7 @@ std::ofstream hdrlog;
 #include "lodspheremesh.h"
 #include "geometry.h"
 #include "texmanager.h"
+#include "virtualtex.h"
 #include "meshmanager.h"
 #include "renderinfo.h"
 #include "renderglsl.h"
@@ -67,6 +68,7 @@ std::ofstream hdrlog;
 #include <celutil/util.h>
 #include <celutil/timer.h>
 #include <GL/glew.h>
+#include <fmt/printf.h>
 #ifdef VIDEO_SYNC
 #ifdef _WIN32
 #include <GL/wglew.h>
@@ -176,10 +178,9 @@ static const int MaxSkyRings = 32;
 static const int MaxSkySlices = 180;
 static const int MinSkySlices = 30;
 
-// Size at which the orbit cache will be flushed of old orbit paths
-static const unsigned int OrbitCacheCullThreshold = 200;
-// Age in frames at which unused orbit paths may be eliminated from the cache
-static const uint32_t OrbitCacheRetireAge = 16;
+// Virtual texture tiles are prefetched for where the camera will be after
+// this many seconds of real time.
+static const double TilePrefetchInterval = 1.0;
 
 Color Renderer::StarLabelColor          (0.471f, 0.356f, 0.682f);
 Color Renderer::PlanetLabelColor        (0.407f, 0.333f, 0.964f);
@@ -467,7 +468,7 @@ Renderer::Renderer() :
     glareVertexBuffer(nullptr),
     textureResolution(medres),
     frameCount(0),
-    lastOrbitCacheFlush(0),
+    orbitCache(DetailOptions().orbitCacheMemory),
     minOrbitSize(MinOrbitSizeForLabel),
     distanceLimit(1.0e6f),
     minFeatureSize(MinFeatureSizeForLabel),
@@ -566,7 +567,8 @@ Renderer::DetailOptions::DetailOptions() :
     eclipseTextureSize(128),
     orbitWindowEnd(0.5),
     orbitPeriodsShown(1.0),
-    linearFadeFraction(0.0)
+    linearFadeFraction(0.0),
+    orbitCacheMemory(16 * 1024 * 1024)
 {
 }
 
@@ -932,6 +934,7 @@ bool Renderer::init(
     context = _context;
 #endif
     detailOptions = _detailOptions;
+    orbitCache.setMemoryBudget(detailOptions.orbitCacheMemory);
 
     // Initialize static meshes and textures common to all instances of Renderer
     if (!commonDataInitialized)
@@ -958,7 +961,8 @@ bool Renderer::init(
                                             detailOptions.shadowTextureSize,
                                             GL_RGB,
                                             ShadowTextureEval,
-                                            shadowTexAddress, shadowTexMip);
+                                            shadowTexAddress, shadowTexMip,
+                                            "shadow");
         shadowTex->setBorderColor(Color::White);
 
         if (gaussianDiscTex == nullptr)
@@ -971,11 +975,13 @@ bool Renderer::init(
             for (int i = 0; i < 4; i++)
             {
                 ShadowTextureFunction func(i * 0.25f);
+                string cacheName = fmt::sprintf("eclipse shadow %d", i);
                 eclipseShadowTextures[i] =
                     CreateProceduralTexture(detailOptions.eclipseTextureSize,
                                             detailOptions.eclipseTextureSize,
                                             GL_RGB, func,
-                                            shadowTexAddress, shadowTexMip);
+                                            shadowTexAddress, shadowTexMip,
+                                            cacheName.c_str());
                 if (eclipseShadowTextures[i] != nullptr)
                 {
                     // eclipseShadowTextures[i]->setMaxMipMapLevel(2);
@@ -997,9 +1003,11 @@ bool Renderer::init(
                                                           PenumbraFunctionEval,
                                                           Texture::EdgeClamp);
 
-         normalizationTex = CreateProceduralCubeMap(64, GL_RGB, IllumMapEval);
+         normalizationTex = CreateProceduralCubeMap(64, GL_RGB, IllumMapEval,
+                                                    "normalization cube map");
 #if ADVANCED_CLOUD_SHADOWS
-         rectToSphericalTexture = CreateProceduralCubeMap(128, GL_RGBA, RectToSphericalMapEval);
+         rectToSphericalTexture = CreateProceduralCubeMap(128, GL_RGBA, RectToSphericalMapEval,
+                                                          "rect to spherical cube map");
 #endif
 
 #ifdef USE_HDR
@@ -1468,40 +1476,6 @@ inline void disableSmoothLines(uint64_t renderFlags)
         disableSmoothLines();
 }
 
-class OrbitSampler : public OrbitSampleProc
-{
-public:
-    vector<CurvePlotSample> samples;
-
-    OrbitSampler() = default;
-
-    void sample(double t, const Vector3d& position, const Vector3d& velocity)
-    {
-        CurvePlotSample samp;
-        samp.t = t;
-        samp.position = position;
-        samp.velocity = velocity;
-        samples.push_back(samp);
-    }
-
-    void insertForward(CurvePlot* plot)
-    {
-        for (const auto& sample : samples)
-        {
-            plot->addSample(sample);
-        }
-    }
-
-    void insertBackward(CurvePlot* plot)
-    {
-        for (auto iter = samples.rbegin(); iter != samples.rend(); ++iter)
-        {
-            plot->addSample(*iter);
-        }
-    }
-};
-
-
 Vector4f renderOrbitColor(const Body *body, bool selected, float opacity)
 {
     Color orbitColor;
@@ -1582,79 +1556,35 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
     else
         orbit = orbitPath.star->getOrbit();
 
-    CurvePlot* cachedOrbit = nullptr;
-    OrbitCache::iterator cached = orbitCache.find(orbit);
-    if (cached != orbitCache.end())
+    // Periodic orbits, and trajectories with no end, are drawn over a window
+    // of one period that slides with the current time; trajectories valid
+    // over a finite range are drawn entirely.
+    bool windowed = orbit->isPeriodic();
+    if (!windowed)
     {
-        cachedOrbit = cached->second;
-        cachedOrbit->setLastUsed(frameCount);
+        double begin = 0.0, end = 0.0;
+        orbit->getValidRange(begin, end);
+        windowed = begin == end;
     }
 
-    // If it's not in the cache already
-    if (cachedOrbit == nullptr)
-    {
-        double startTime = t;
-        int nSamples = detailOptions.orbitPathSamplePoints;
+    if (windowed && orbit->getPeriod() <= 0.0)
+        return;
 
-        // Adjust the number of samples used for aperiodic orbits--these aren't
-        // true orbits, but are sampled trajectories, generally of spacecraft.
-        // Better control is really needed--some sort of adaptive sampling would
-        // be ideal.
-        if (!orbit->isPeriodic())
-        {
-            double begin = 0.0, end = 0.0;
-            orbit->getValidRange(begin, end);
+    CurvePlot* cachedOrbit = orbitCache.find(orbit, frameCount);
 
-            if (begin != end)
-            {
-                startTime = begin;
-                nSamples = (int) (orbit->getPeriod() * 100.0);
-                nSamples = max(min(nSamples, 1000), 100);
-            }
-            else
-            {
-                // If the orbit is aperiodic and doesn't have a
-                // finite duration, we don't render it. A compromise
-                // would be to pick some time window centered at the
-                // current time, but we'd have to pick some arbitrary
-                // duration.
-                nSamples = 0;
-            }
-        }
-        else
+    // If it's not in the cache already, have it sampled in the background.
+    // Nothing is drawn until the samples are available.
+    if (cachedOrbit == nullptr)
+    {
+        double startTime = t - orbit->getPeriod();
+        if (!windowed)
         {
-            startTime = t - orbit->getPeriod();
+            double end = 0.0;
+            orbit->getValidRange(startTime, end);
         }
 
-        cachedOrbit = new CurvePlot();
-        cachedOrbit->setLastUsed(frameCount);
-
-        OrbitSampler sampler;
-        orbit->sample(startTime,
-                      startTime + orbit->getPeriod(),
-                      sampler);
-        sampler.insertForward(cachedOrbit);
-
-        // If the orbit cache is full, first try and eliminate some old orbits
-        if (orbitCache.size() > OrbitCacheCullThreshold)
-        {
-            // Check for old orbits at most once per frame
-            if (lastOrbitCacheFlush != frameCount)
-            {
-                for (auto iter = orbitCache.begin(); iter != orbitCache.end();)
-                {
-                    // Tricky code to eliminate a node in the orbit cache without screwing
-                    // up the iterator. Should work in all STL implementations.
-                    if (frameCount - iter->second->lastUsed() > OrbitCacheRetireAge)
-                        orbitCache.erase(iter++);
-                    else
-                        ++iter;
-                }
-                lastOrbitCacheFlush = frameCount;
-            }
-        }
-
-        orbitCache[orbit] = cachedOrbit;
+        orbitCache.request(orbit, startTime, startTime + orbit->getPeriod(), frameCount);
+        return;
     }
 
     if (cachedOrbit->empty())
@@ -1687,45 +1617,15 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
     // 'Periodic' orbits are generally not strictly periodic because of perturbations
     // from other bodies. Here we update the trajectory samples to make sure that the
     // orbit covers a time range centered at the current time and covering a full revolution.
-    if (orbit->isPeriodic())
+    // Only the span newly exposed as the window slides is sampled.
+    if (windowed)
     {
         double period = orbit->getPeriod();
         double endTime = t + period * OrbitWindowEnd;
         double startTime = endTime - period * OrbitPeriodsShown;
 
-        double currentWindowStart = cachedOrbit->startTime();
-        double currentWindowEnd = cachedOrbit->endTime();
-        double newWindowStart = startTime - period * WindowSlack;
-        double newWindowEnd = endTime + period * WindowSlack;
-
-        if (startTime < currentWindowStart)
+        if (cachedOrbit->updateWindow(*orbit, startTime, endTime, period * WindowSlack))
         {
-            // Remove samples at the end of the time window
-            cachedOrbit->removeSamplesAfter(newWindowEnd);
-
-            // Trim the first sample (because it will be duplicated when we sample the orbit.)
-            cachedOrbit->removeSamplesBefore(cachedOrbit->startTime() * (1.0 + 1.0e-15));
-
-            // Add the new samples
-            OrbitSampler sampler;
-            orbit->sample(newWindowStart, min(currentWindowStart, newWindowEnd), sampler);
-            sampler.insertBackward(cachedOrbit);
-#if DEBUG_ORBIT_CACHE
-            clog << "new sample count: " << cachedOrbit->sampleCount() << endl;
-#endif
-        }
-        else if (endTime > currentWindowEnd)
-        {
-            // Remove samples at the beginning of the time window
-            cachedOrbit->removeSamplesBefore(newWindowStart);
-
-            // Trim the last sample (because it will be duplicated when we sample the orbit.)
-            cachedOrbit->removeSamplesAfter(cachedOrbit->endTime() * (1.0 - 1.0e-15));
-
-            // Add the new samples
-            OrbitSampler sampler;
-            orbit->sample(max(currentWindowEnd, newWindowStart), newWindowEnd, sampler);
-            sampler.insertForward(cachedOrbit);
 #if DEBUG_ORBIT_CACHE
             clog << "new sample count: " << cachedOrbit->sampleCount() << endl;
 #endif
@@ -1770,7 +1670,7 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
         viewFrustumPlaneNormals[i] = frustum.plane(i).normal().cast<double>();
     }
 
-    if (orbit->isPeriodic())
+    if (windowed)
     {
         double period = orbit->getPeriod();
         double windowEnd = t + period * OrbitWindowEnd;
@@ -2463,6 +2363,11 @@ void Renderer::render(const Observer& observer,
 #else
     draw(observer, universe, faintestMagNight, sel);
 #endif
+
+    // Textures and models not used recently may be released now that the
+    // frame has been drawn.
+    GetTextureManager()->endFrame();
+    GetGeometryManager()->endFrame();
 }
 
 void Renderer::draw(const Observer& observer,
@@ -2476,6 +2381,7 @@ void Renderer::draw(const Observer& observer,
 
     frameCount++;
     settingsChanged = false;
+    VirtualTexture::beginFrame();
 
     // Compute the size of a pixel
     setFieldOfView(radToDeg(observer.getFOV()));
@@ -2499,6 +2405,16 @@ void Renderer::draw(const Observer& observer,
 
     m_cameraOrientation = observer.getOrientationf();
 
+    // Predict the camera motion, following its velocity or the trajectory of
+    // a goto in progress. The simulation time is held still, so the motion
+    // of the bodies themselves is ignored.
+    {
+        Observer predicted(observer);
+        predicted.update(TilePrefetchInterval, 0.0);
+        m_prefetchOffset = predicted.getPosition().offsetFromKm(observer.getPosition()).cast<float>();
+        m_prefetchOrientation = predicted.getOrientationf();
+    }
+
     // Get the view frustum used for culling in camera space.
     float viewAspectRatio = (float) windowWidth / (float) windowHeight;
     Frustum frustum(degToRad(fov),
@@ -2581,6 +2497,11 @@ void Renderer::draw(const Observer& observer,
                 solarSysTree->markUpdated();
             }
 
+            // Evaluate the positions and orientations of all bodies in the
+            // system once, in parallel. Everything below reads them from the
+            // phase snapshots instead of evaluating the ephemerides again.
+            solarSysTree->updateSnapshot(now);
+
             // Compute the position of the observer in astrocentric coordinates
             Vector3d astrocentricObserverPos = astrocentricPosition(observer.getPosition(), *sun, now);
 
@@ -4554,17 +4475,17 @@ void Renderer::renderObject(const Vector3f& pos,
 
     // Get the textures . . .
     if (obj.surface->baseTexture.tex[textureResolution] != InvalidResource)
-        ri.baseTex = obj.surface->baseTexture.find(textureResolution);
+        ri.baseTex = obj.surface->baseTexture.findAsync(textureResolution);
     if ((obj.surface->appearanceFlags & Surface::ApplyBumpMap) != 0 &&
         obj.surface->bumpTexture.tex[textureResolution] != InvalidResource)
-        ri.bumpTex = obj.surface->bumpTexture.find(textureResolution);
+        ri.bumpTex = obj.surface->bumpTexture.findAsync(textureResolution);
     if ((obj.surface->appearanceFlags & Surface::ApplyNightMap) != 0 &&
         (renderFlags & ShowNightMaps) != 0)
-        ri.nightTex = obj.surface->nightTexture.find(textureResolution);
+        ri.nightTex = obj.surface->nightTexture.findAsync(textureResolution);
     if ((obj.surface->appearanceFlags & Surface::SeparateSpecularMap) != 0)
-        ri.glossTex = obj.surface->specularTexture.find(textureResolution);
+        ri.glossTex = obj.surface->specularTexture.findAsync(textureResolution);
     if ((obj.surface->appearanceFlags & Surface::ApplyOverlay) != 0)
-        ri.overlayTex = obj.surface->overlayTexture.find(textureResolution);
+        ri.overlayTex = obj.surface->overlayTexture.findAsync(textureResolution);
 
     // Apply the modelview transform for the object
     glPushMatrix();
@@ -4700,9 +4621,9 @@ void Renderer::renderObject(const Vector3f& pos,
         if ((renderFlags & ShowCloudMaps) != 0)
         {
             if (atmosphere->cloudTexture.tex[textureResolution] != InvalidResource)
-                cloudTex = atmosphere->cloudTexture.find(textureResolution);
+                cloudTex = atmosphere->cloudTexture.findAsync(textureResolution);
             if (atmosphere->cloudNormalMap.tex[textureResolution] != InvalidResource)
-                cloudNormalMap = atmosphere->cloudNormalMap.find(textureResolution);
+                cloudNormalMap = atmosphere->cloudNormalMap.findAsync(textureResolution);
         }
         if (atmosphere->cloudSpeed != 0.0f)
             cloudTexOffset = (float) (-pfmod(now * atmosphere->cloudSpeed / (2 * PI), 1.0));
@@ -4710,6 +4631,30 @@ void Renderer::renderObject(const Vector3f& pos,
 
     if (obj.geometry == InvalidResource)
     {
+        // Start loading the virtual texture tiles likely to be needed soon:
+        // those around the point looked at from the predicted camera
+        // position, and one level finer around the current view center.
+        Texture* textures[] = { ri.baseTex, ri.bumpTex, ri.nightTex, ri.glossTex, ri.overlayTex };
+        int nTextures = 0;
+        for (Texture* tex : textures)
+        {
+            if (tex != nullptr)
+                textures[nTextures++] = tex;
+        }
+
+        if (nTextures > 0)
+        {
+            Vector3f predictedPos = pos - m_prefetchOffset;
+            float predictedAltitude = predictedPos.norm() - obj.radius;
+            float predictedDiscSize = obj.radius / (max(nearPlaneDistance, predictedAltitude) * pixelSize);
+            Vector3f predictedEyePos = -(planetRotation * (predictedPos.cwiseQuotient(scaleFactors)));
+            Vector3f predictedViewDir = planetRotation * (m_prefetchOrientation.conjugate() * -Vector3f::UnitZ());
+            g_lodSphere->prefetch(predictedEyePos, predictedViewDir, predictedDiscSize, 0, textures, nTextures);
+
+            Vector3f viewDir = planetRotation * (cameraOrientation.conjugate() * -Vector3f::UnitZ());
+            g_lodSphere->prefetch(ri.eyePos_obj, viewDir, ri.pixWidth, 1, textures, nTextures);
+        }
+
         // A null model indicates that this body is a sphere
         if (lit)
         {
@@ -4927,7 +4872,7 @@ void Renderer::renderObject(const Vector3f& pos,
         if ((obj.surface->appearanceFlags & Surface::Emissive) == 0 &&
             (renderFlags & ShowRingShadows) != 0)
         {
-            Texture* ringsTex = obj.rings->texture.find(textureResolution);
+            Texture* ringsTex = obj.rings->texture.findAsync(textureResolution);
             if (ringsTex != nullptr)
             {
                 glEnable(GL_TEXTURE_2D);
@@ -5290,7 +5235,7 @@ void Renderer::renderPlanet(Body& body,
                 float ringWidth = rings->outerRadius - rings->innerRadius;
                 float projectedRingSize = std::abs(lights.lights[li].direction_obj.dot(lights.ringPlaneNormal)) * ringWidth;
                 float projectedRingSizeInPixels = projectedRingSize / (max(nearPlaneDistance, altitude) * pixelSize);
-                Texture* ringsTex = rings->texture.find(textureResolution);
+                Texture* ringsTex = rings->texture.findAsync(textureResolution);
                 if (ringsTex)
                 {
                     // Calculate the approximate distance from the shadowed object to the rings
@@ -5900,24 +5845,27 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
     double invCosViewAngle = 1.0 / cosViewConeAngle;
     double sinViewAngle = sqrt(1.0 - square(cosViewConeAngle));
 
-    unsigned int nChildren = tree != nullptr ? tree->childCount() : 0;
-    for (unsigned int i = 0; i < nChildren; i++)
-    {
-        const TimelinePhase* phase = tree->getChild(i);
-
-        // No need to do anything if the phase isn't active now
-        if (!phase->includes(now))
-            continue;
+    // Only the phases active now need to be considered
+    vector<TimelinePhase*> active;
+    if (tree != nullptr)
+        tree->getActiveChildren(now, active);
 
+    for (const TimelinePhase* phase : active)
+    {
         Body* body = phase->body();
 
         // pos_s: sun-relative position of object
         // pos_v: viewer-relative position of object
 
-        // Get the position of the body relative to the sun.
-        Vector3d p = phase->orbit()->positionAtTime(now);
-        ReferenceFrame* frame = phase->orbitFrame();
-        Vector3d pos_s = frameCenter + frame->getOrientation(now).conjugate() * p;
+        // Get the position of the body relative to the sun. It is normally
+        // available from the snapshot computed at the start of the frame.
+        Vector3d pos_s;
+        if (!phase->getSnapshot(now, &PhaseSnapshot::astrocentricPosition, pos_s))
+        {
+            Vector3d p = phase->orbit()->positionAtTime(now);
+            ReferenceFrame* frame = phase->orbitFrame();
+            pos_s = frameCenter + frame->getOrientation(now).conjugate() * p;
+        }
 
         // We now have the positions of the observer and the planet relative
         // to the sun.  From these, compute the position of the body
@@ -6120,15 +6068,13 @@ void Renderer::buildOrbitLists(const Vector3d& astrocentricObserverPos,
     Matrix3d viewMat = observerOrientation.toRotationMatrix();
     Vector3d viewMatZ = viewMat.row(2);
 
-    unsigned int nChildren = tree != nullptr ? tree->childCount() : 0;
-    for (unsigned int i = 0; i < nChildren; i++)
-    {
-        const TimelinePhase* phase = tree->getChild(i);
-
-        // No need to do anything if the phase isn't active now
-        if (!phase->includes(now))
-            continue;
+    // Only the phases active now need to be considered
+    vector<TimelinePhase*> active;
+    if (tree != nullptr)
+        tree->getActiveChildren(now, active);
 
+    for (const TimelinePhase* phase : active)
+    {
         Body* body = phase->body();
 
         // pos_s: sun-relative position of object
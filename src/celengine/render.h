@@ -21,6 +21,7 @@
 #endif
 #include <celengine/starcolors.h>
 #include <celengine/rendcontext.h>
+#include <celengine/orbitpathcache.h>
 #include <celtxf/texturefont.h>
 #include <vector>
 #include <list>
@@ -104,6 +105,7 @@ class Renderer
         double orbitWindowEnd;
         double orbitPeriodsShown;
         double linearFadeFraction;
+        std::size_t orbitCacheMemory; // bytes
     };
 
 #ifdef USE_GLCONTEXT
@@ -683,6 +685,10 @@ class Renderer
     std::string displayedSurface;
 
     Eigen::Quaternionf m_cameraOrientation;
+
+    // Predicted camera motion over the next second, for prefetching tiles
+    Eigen::Vector3f m_prefetchOffset{ Eigen::Vector3f::Zero() };
+    Eigen::Quaternionf m_prefetchOrientation{ Eigen::Quaternionf::Identity() };
     PointStarVertexBuffer* pointStarVertexBuffer;
     PointStarVertexBuffer* glareVertexBuffer;
     std::vector<RenderListEntry> renderList;
@@ -738,9 +744,7 @@ class Renderer
 #endif
 
  private:
-    typedef std::map<const Orbit*, CurvePlot*> OrbitCache;
-    OrbitCache orbitCache;
-    uint32_t lastOrbitCacheFlush;
+    OrbitPathCache orbitCache;
 
     float minOrbitSize;
     float distanceLimit;
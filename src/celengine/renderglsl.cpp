@@ -126,7 +126,7 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
         {
             Texture* cloudTex = nullptr;
             if (atmosphere->cloudTexture.tex[textureRes] != InvalidResource)
-                cloudTex = atmosphere->cloudTexture.find(textureRes);
+                cloudTex = atmosphere->cloudTexture.findAsync(textureRes);
 
             // The current implementation of cloud shadows is not compatible
             // with virtual or split textures.
@@ -190,7 +190,7 @@ void renderEllipsoid_GLSL(const RenderInfo& ri,
 
     if (ls.shadowingRingSystem)
     {
-        Texture* ringsTex = ls.shadowingRingSystem->texture.find(textureRes);
+        Texture* ringsTex = ls.shadowingRingSystem->texture.findAsync(textureRes);
         if (ringsTex != nullptr)
         {
             glActiveTexture(GL_TEXTURE0 + nTextures);
@@ -424,7 +424,7 @@ void renderClouds_GLSL(const RenderInfo& ri,
 #if 0
     if (rings != nullptr && (renderFlags & Renderer::ShowRingShadows) != 0)
     {
-        Texture* ringsTex = rings->texture.find(textureRes);
+        Texture* ringsTex = rings->texture.findAsync(textureRes);
         if (ringsTex != nullptr)
         {
             glActiveTexture(GL_TEXTURE0 + nTextures);
@@ -674,7 +674,7 @@ void renderRings_GLSL(RingSystem& rings,
 {
     float inner = rings.innerRadius / planetRadius;
     float outer = rings.outerRadius / planetRadius;
-    Texture* ringsTex = rings.texture.find(textureResolution);
+    Texture* ringsTex = rings.texture.findAsync(textureResolution);
 
     ShaderProperties shadprop;
     // Set up the shader properties for ring rendering
@@ -9,10 +9,14 @@
 
 #include "celestia.h"
 #include <celutil/debug.h>
+#include <fmt/printf.h>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include "imagedecoder.h"
 #include "multitexture.h"
 #include "texmanager.h"
+#include "texturecache.h"
 
 using namespace std;
 
@@ -112,31 +116,128 @@ string TextureInfo::resolve(const string& baseDir)
 }
 
 
-Texture* TextureInfo::load(const string& name)
+Texture::AddressMode TextureInfo::addressMode() const
 {
-    Texture::AddressMode addressMode = Texture::EdgeClamp;
-    Texture::MipMapMode mipMode = Texture::DefaultMipMaps;
-
     if (flags & WrapTexture)
-        addressMode = Texture::Wrap;
+        return Texture::Wrap;
     else if (flags & BorderClamp)
-        addressMode = Texture::BorderClamp;
+        return Texture::BorderClamp;
+    else
+        return Texture::EdgeClamp;
+}
 
+
+Texture::MipMapMode TextureInfo::mipMapMode() const
+{
     if (flags & NoMipMaps)
-        mipMode = Texture::NoMipMaps;
+        return Texture::NoMipMaps;
     else if (flags & AutoMipMaps)
-        mipMode = Texture::AutoMipMaps;
+        return Texture::AutoMipMaps;
+    else
+        return Texture::DefaultMipMaps;
+}
+
+
+// Decode the image of the texture, and compute the normal map of a bump
+// map. With the texture cache enabled, the image is read from the cache
+// when it holds a copy made since the file was last modified; otherwise
+// the mipmaps of the image are built and it is stored in the cache.
+Image* TextureInfo::loadImage(const string& name, ContentType contentType) const
+{
+    // DDS files are already stored the way they are uploaded
+    TextureCache* cache = GetTextureCache();
+    if (contentType == Content_DDS || contentType == Content_DXT5NormalMap)
+        cache = nullptr;
+
+    string options = fmt::sprintf("%u %.9g", flags, bumpHeight);
+    if (cache != nullptr)
+    {
+        Image* img = cache->load(name, options);
+        if (img != nullptr)
+            return img;
+    }
+
+    unique_ptr<Image> img(GetImageDecoder()->load(name));
+    if (img == nullptr)
+        return nullptr;
+
+    if (bumpHeight != 0.0f)
+    {
+        img.reset(img->computeNormalMap(bumpHeight, addressMode() == Texture::Wrap));
+        if (img == nullptr)
+            return nullptr;
+    }
 
-    if (bumpHeight == 0.0f)
+    if (cache != nullptr && !img->isCompressed())
     {
-        DPRINTF(0, "Loading texture: %s\n", name.c_str());
-        // cout << "Loading texture: " << name << '\n';
+        // Bump maps are always mipmapped
+        bool mipmap = bumpHeight != 0.0f || mipMapMode() != Texture::NoMipMaps;
+        if (mipmap && img->getMipLevelCount() == 1)
+            img.reset(img->computeMipMaps());
+        cache->store(name, options, *img);
+    }
+
+    return img.release();
+}
+
 
+Texture* TextureInfo::load(const string& name)
+{
+    Texture::AddressMode addressMode = this->addressMode();
+    Texture::MipMapMode mipMode = mipMapMode();
+    ContentType contentType = DetermineFileType(name);
+
+    // Virtual textures load their tiles as they're drawn
+    if (contentType == Content_CelestiaTexture)
         return LoadTextureFromFile(name, addressMode, mipMode);
+
+    DPRINTF(0, "Loading %s: %s\n", bumpHeight == 0.0f ? "texture" : "bump map", name.c_str());
+
+    unique_ptr<Image> img(loadImage(name, contentType));
+    if (img == nullptr)
+        return nullptr;
+
+    if (bumpHeight != 0.0f)
+    {
+        contentType = Content_Unknown;
+        mipMode = Texture::DefaultMipMaps;
+    }
+
+    return CreateTextureFromImage(*img, addressMode, mipMode, contentType);
+}
+
+
+// Decode the image, and compute the normal map of a bump map, on a loader
+// thread; only the texture is created on the thread using the texture
+// manager.
+function<Texture*()> TextureInfo::loadAsync(const string& name)
+{
+    Texture::AddressMode addressMode = this->addressMode();
+    Texture::MipMapMode mipMode = mipMapMode();
+    ContentType contentType = DetermineFileType(name);
+
+    // Virtual textures load their tiles as they're drawn
+    if (contentType == Content_CelestiaTexture)
+    {
+        return [name, addressMode, mipMode]()
+        {
+            return LoadTextureFromFile(name, addressMode, mipMode);
+        };
     }
 
-    DPRINTF(0, "Loading bump map: %s\n", name.c_str());
-    // cout << "Loading texture: " << name << '\n';
+    DPRINTF(1, "Loading texture in the background: %s\n", name.c_str());
+    shared_ptr<Image> img(loadImage(name, contentType));
+    if (img == nullptr)
+        return nullptr;
 
-    return LoadHeightMapFromFile(name, bumpHeight, addressMode);
+    if (bumpHeight != 0.0f)
+    {
+        contentType = Content_Unknown;
+        mipMode = Texture::DefaultMipMaps;
+    }
+
+    return [img, addressMode, mipMode, contentType]()
+    {
+        return CreateTextureFromImage(*img, addressMode, mipMode, contentType);
+    };
 }
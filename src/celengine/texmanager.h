@@ -10,6 +10,7 @@
 #ifndef _TEXMANAGER_H_
 #define _TEXMANAGER_H_
 
+#include <functional>
 #include <string>
 #include <map>
 #include <celutil/resmanager.h>
@@ -67,6 +68,17 @@ class TextureInfo : public ResourceInfo<Texture>
 
     virtual std::string resolve(const std::string&);
     virtual Texture* load(const std::string&);
+    virtual bool hasAsyncLoad() const { return true; }
+    virtual std::function<Texture*()> loadAsync(const std::string&);
+    virtual std::size_t getMemoryUsage() const
+    {
+        return resource != nullptr ? resource->getMemoryUsage() : 0;
+    }
+
+ private:
+    Texture::AddressMode addressMode() const;
+    Texture::MipMapMode mipMapMode() const;
+    Image* loadImage(const std::string&, ContentType) const;
 };
 
 inline bool operator<(const TextureInfo& ti0, const TextureInfo& ti1)
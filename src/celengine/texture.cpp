@@ -12,6 +12,7 @@
 #include <cstdlib>
 #include <cmath>
 #include <fstream>
+#include <functional>
 #include <iostream>
 
 extern "C" {
@@ -21,13 +22,16 @@ extern "C" {
 
 #include <celutil/filetype.h>
 #include <celutil/debug.h>
+#include <celutil/threadpool.h>
 #include <celutil/util.h>
 #include <Eigen/Core>
 #include <GL/glew.h>
 #include <fmt/printf.h>
 #include <config.h>
 #include "celestia.h"
+#include "imagedecoder.h"
 #include "texture.h"
+#include "texturecache.h"
 #include "virtualtex.h"
 
 
@@ -266,6 +270,17 @@ static int ilog2(unsigned int x)
 }
 
 
+// Texture memory used by an image; mipmaps built by the driver add a
+// third to the size of the base level.
+static std::size_t CalcTextureMemory(const Image& img, bool mipmap, bool precomputedMipMaps)
+{
+    std::size_t size = img.getSize();
+    if (mipmap && !precomputedMipMaps)
+        size += size / 3;
+    return size;
+}
+
+
 static int CalcMipLevelCount(int w, int h)
 {
     return max(ilog2(w), ilog2(h)) + 1;
@@ -378,7 +393,7 @@ ImageTexture::ImageTexture(Image& img,
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, texCaps.preferredAnisotropy);
     }
 
-    if (mipMapMode == AutoMipMaps)
+    if (mipMapMode == AutoMipMaps && !precomputedMipMaps)
         glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP_SGIS, GL_TRUE);
 
     int internalFormat = getInternalFormat(img.getFormat());
@@ -411,6 +426,7 @@ ImageTexture::ImageTexture(Image& img,
 
     alpha = img.hasAlpha();
     compressed = img.isCompressed();
+    memoryUsage = CalcTextureMemory(img, mipmap, precomputedMipMaps);
 }
 
 
@@ -548,7 +564,32 @@ TiledTexture::TiledTexture(Image& img,
                 }
                 else
                 {
-                    // TODO: Handle uncompressed textures with prebuilt mipmaps
+                    for (int mip = 0; mip < tileMipLevelCount; mip++)
+                    {
+                        // A missing 1x1 level is taken from the last one
+                        int srcMip = min(mip, mipLevelCount - 1);
+                        unsigned char* imgMip = img.getMipLevel(srcMip);
+                        int mipWidth  = max(img.getWidth() >> srcMip, 1);
+                        int mipHeight = max(img.getHeight() >> srcMip, 1);
+                        unsigned char* tileMip = tile->getMipLevel(mip);
+                        int tileMipWidth  = max(tileWidth >> mip, 1);
+                        int tileMipHeight = max(tileHeight >> mip, 1);
+                        // Levels smaller than the number of tiles are shared
+                        int srcU = min(u * tileMipWidth, max(mipWidth - tileMipWidth, 0));
+                        int srcV = min(v * tileMipHeight, max(mipHeight - tileMipHeight, 0));
+                        int copyWidth = min(tileMipWidth, mipWidth);
+                        int copyHeight = min(tileMipHeight, mipHeight);
+                        // Rows of image levels are padded to four bytes
+                        int srcPitch = (mipWidth * components + 3) & ~0x3;
+                        int destPitch = (tileMipWidth * components + 3) & ~0x3;
+
+                        for (int y = 0; y < copyHeight; y++)
+                        {
+                            memcpy(tileMip + y * destPitch,
+                                   imgMip + (srcV + y) * srcPitch + srcU * components,
+                                   copyWidth * components);
+                        }
+                    }
                 }
 
                 LoadMipmapSet(*tile, GL_TEXTURE_2D);
@@ -604,6 +645,8 @@ TiledTexture::TiledTexture(Image& img,
     }
 
     delete tile;
+
+    memoryUsage = CalcTextureMemory(img, mipmap, precomputedMipMaps);
 }
 
 
@@ -729,6 +772,8 @@ CubeMap::CubeMap(Image* faces[]) :
             LoadMiplessTexture(*face, targetFace);
         }
     }
+
+    memoryUsage = 6 * CalcTextureMemory(*faces[0], mipmap, precomputedMipMaps);
 }
 
 
@@ -762,23 +807,90 @@ void CubeMap::setBorderColor(Color borderColor)
 
 
 
-Texture* CreateProceduralTexture(int width, int height,
-                                 int format,
-                                 ProceduralTexEval func,
-                                 Texture::AddressMode addressMode,
-                                 Texture::MipMapMode mipMode)
+// Version of the procedural texture generators, part of the names of the
+// cached images. Increase it whenever a generator is changed, so that images
+// cached by the previous generators aren't used.
+static const int ProceduralTextureVersion = 1;
+
+// Procedural textures are generated with different pixel values when
+// rendering with compressed dynamic range.
+#ifdef HDR_COMPRESS
+static const char* ProceduralPixelEncoding = "hdr";
+#else
+static const char* ProceduralPixelEncoding = "ldr";
+#endif
+
+
+// Return the image of a procedural texture, generated by calling generate
+// on a new image. With a cache name, the image is read from the texture
+// cache if it was generated before; a newly generated image is given its
+// mipmaps and stored there.
+static Image* CreateProceduralImage(int width, int height, int format, bool mipmap,
+                                    const char* cacheName,
+                                    const function<void(Image&)>& generate)
 {
-    Image* img = new Image(format, width, height);
+    TextureCache* cache = cacheName != nullptr ? GetTextureCache() : nullptr;
+    string name;
+    if (cache != nullptr)
+    {
+        name = fmt::sprintf("%s v%d %s %dx%d %#x%s",
+                            cacheName, ProceduralTextureVersion, ProceduralPixelEncoding,
+                            width, height, format, mipmap ? " mipmap" : "");
+        Image* img = cache->loadGenerated(name);
+        if (img != nullptr)
+            return img;
+    }
+
+    auto* img = new Image(format, width, height);
+    generate(*img);
+
+    if (cache != nullptr)
+    {
+        if (mipmap)
+        {
+            Image* mipmapped = img->computeMipMaps();
+            delete img;
+            img = mipmapped;
+        }
+        cache->storeGenerated(name, *img);
+    }
+
+    return img;
+}
+
+
+// Evaluate a procedural texture at the center of every texel of an image.
+// Rows are evaluated in parallel, so func must be safe to call from several
+// threads at once.
+template<class TexEval> static void EvaluateTexels(Image& img, TexEval& func)
+{
+    int width = img.getWidth();
+    int height = img.getHeight();
+    int components = img.getComponents();
 
-    for (int y = 0; y < height; y++)
+    GetThreadPool()->parallelFor(0, height, [&img, &func, width, height, components](size_t y)
     {
+        unsigned char* row = img.getPixelRow((int) y);
+        float v = ((float) y + 0.5f) / (float) height * 2 - 1;
         for (int x = 0; x < width; x++)
         {
             float u = ((float) x + 0.5f) / (float) width * 2 - 1;
-            float v = ((float) y + 0.5f) / (float) height * 2 - 1;
-            func(u, v, 0, img->getPixelRow(y) + x * img->getComponents());
+            func(u, v, 0, row + x * components);
         }
-    }
+    });
+}
+
+
+Texture* CreateProceduralTexture(int width, int height,
+                                 int format,
+                                 ProceduralTexEval func,
+                                 Texture::AddressMode addressMode,
+                                 Texture::MipMapMode mipMode,
+                                 const char* cacheName)
+{
+    Image* img = CreateProceduralImage(width, height, format,
+                                       mipMode != Texture::NoMipMaps, cacheName,
+                                       [func](Image& image) { EvaluateTexels(image, func); });
 
     Texture* tex = new ImageTexture(*img, addressMode, mipMode);
     delete img;
@@ -791,19 +903,12 @@ Texture* CreateProceduralTexture(int width, int height,
                                  int format,
                                  TexelFunctionObject& func,
                                  Texture::AddressMode addressMode,
-                                 Texture::MipMapMode mipMode)
+                                 Texture::MipMapMode mipMode,
+                                 const char* cacheName)
 {
-    Image* img = new Image(format, width, height);
-
-    for (int y = 0; y < height; y++)
-    {
-        for (int x = 0; x < width; x++)
-        {
-            float u = ((float) x + 0.5f) / (float) width * 2 - 1;
-            float v = ((float) y + 0.5f) / (float) height * 2 - 1;
-            func(u, v, 0, img->getPixelRow(y) + x * img->getComponents());
-        }
-    }
+    Image* img = CreateProceduralImage(width, height, format,
+                                       mipMode != Texture::NoMipMaps, cacheName,
+                                       [&func](Image& image) { EvaluateTexels(image, func); });
 
     Texture* tex = new ImageTexture(*img, addressMode, mipMode);
     delete img;
@@ -849,26 +954,35 @@ static Vector3f cubeVector(int face, float s, float t)
 
 
 extern Texture* CreateProceduralCubeMap(int size, int format,
-                                        ProceduralTexEval func)
+                                        ProceduralTexEval func,
+                                        const char* cacheName)
 {
     Image* faces[6];
 
     for (int i = 0; i < 6; i++)
     {
-        faces[i] = new Image(format, size, size);
+        string faceName;
+        if (cacheName != nullptr)
+            faceName = fmt::sprintf("%s face %d", cacheName, i);
 
-        Image* face = faces[i];
-        for (int y = 0; y < size; y++)
+        auto generate = [i, size, func](Image& face)
         {
-            for (int x = 0; x < size; x++)
+            GetThreadPool()->parallelFor(0, size, [&face, i, size, func](size_t y)
             {
-                float s = ((float) x + 0.5f) / (float) size * 2 - 1;
+                unsigned char* row = face.getPixelRow((int) y);
                 float t = ((float) y + 0.5f) / (float) size * 2 - 1;
-                Vector3f v = cubeVector(i, s, t);
-                func(v.x(), v.y(), v.z(),
-                     face->getPixelRow(y) + x * face->getComponents());
-            }
-        }
+                for (int x = 0; x < size; x++)
+                {
+                    float s = ((float) x + 0.5f) / (float) size * 2 - 1;
+                    Vector3f v = cubeVector(i, s, t);
+                    func(v.x(), v.y(), v.z(), row + x * face.getComponents());
+                }
+            });
+        };
+
+        faces[i] = CreateProceduralImage(size, size, format, true,
+                                         cacheName != nullptr ? faceName.c_str() : nullptr,
+                                         generate);
     }
 
     Texture* tex = new CubeMap(faces);
@@ -889,9 +1003,10 @@ static bool isPow2(int x)
 }
 #endif
 
-static Texture* CreateTextureFromImage(Image& img,
-                                       Texture::AddressMode addressMode,
-                                       Texture::MipMapMode mipMode)
+Texture* CreateTextureFromImage(Image& img,
+                                Texture::AddressMode addressMode,
+                                Texture::MipMapMode mipMode,
+                                ContentType contentType)
 {
 #if 0
     // Require texture dimensions to be powers of two.  Even though the
@@ -936,6 +1051,18 @@ static Texture* CreateTextureFromImage(Image& img,
         tex = new ImageTexture(img, addressMode, mipMode);
     }
 
+    if (contentType == Content_DXT5NormalMap)
+    {
+        // If the texture came from a .dxt5nm file then mark it as a dxt5
+        // compressed normal map. There's no separate OpenGL format for dxt5
+        // normal maps, so the file extension is the only thing that
+        // distinguishes it from a plain old dxt5 texture.
+        if (img.getFormat() == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+        {
+            tex->setFormatOptions(Texture::DXT5NormalMap);
+        }
+    }
+
     return tex;
 }
 
@@ -952,24 +1079,11 @@ Texture* LoadTextureFromFile(const string& filename,
 
     // All other texture types are handled by first loading an image, then
     // creating a texture from that image.
-    Image* img = LoadImageFromFile(filename);
+    Image* img = GetImageDecoder()->load(filename);
     if (img == nullptr)
         return nullptr;
 
-    Texture* tex = CreateTextureFromImage(*img, addressMode, mipMode);
-
-    if (contentType == Content_DXT5NormalMap)
-    {
-        // If the texture came from a .dxt5nm file then mark it as a dxt5
-        // compressed normal map. There's no separate OpenGL format for dxt5
-        // normal maps, so the file extension is the only thing that
-        // distinguishes it from a plain old dxt5 texture.
-        if (img->getFormat() == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
-        {
-            tex->setFormatOptions(Texture::DXT5NormalMap);
-        }
-    }
-
+    Texture* tex = CreateTextureFromImage(*img, addressMode, mipMode, contentType);
     delete img;
 
     return tex;
@@ -981,7 +1095,7 @@ Texture* LoadHeightMapFromFile(const string& filename,
                                float height,
                                Texture::AddressMode addressMode)
 {
-    Image* img = LoadImageFromFile(filename);
+    Image* img = GetImageDecoder()->load(filename);
     if (img == nullptr)
         return nullptr;
     Image* normalMap = img->computeNormalMap(height,
@@ -10,6 +10,7 @@
 #ifndef _CELENGINE_TEXTURE_H_
 #define _CELENGINE_TEXTURE_H_
 
+#include <cstddef>
 #include <string>
 #include <celutil/color.h>
 #include <celengine/image.h>
@@ -63,6 +64,11 @@ class Texture
     virtual void beginUsage() {};
     virtual void endUsage() {};
 
+    /*! Hint that a tile is likely to be needed soon; textures that load
+     *  tiles on demand may start loading it in the background.
+     */
+    virtual void prefetchTile(int /* lod */, int /* u */, int /* v */) {};
+
     virtual void setBorderColor(Color);
 
     int getWidth() const;
@@ -72,6 +78,9 @@ class Texture
     bool hasAlpha() const { return alpha; }
     bool isCompressed() const { return compressed; }
 
+    //! Estimate of the texture memory used, in bytes
+    std::size_t getMemoryUsage() const { return memoryUsage; }
+
     /*! Identical formats may need to be treated in slightly different
      *  fashions. One (and currently the only) example is the DXT5 compressed
      *  normal map format, which is an ordinary DXT5 texture but requires some
@@ -104,6 +113,7 @@ class Texture
  protected:
     bool alpha{ false };
     bool compressed{ false };
+    std::size_t memoryUsage{ 0 };
 
  private:
     int width;
@@ -166,18 +176,36 @@ class CubeMap : public Texture
 };
 
 
+/*! Create a texture by evaluating a function at every texel. Rows are
+ *  evaluated in parallel, so the function must be safe to call from several
+ *  threads at once. With a cache name, the generated image is kept in the
+ *  texture cache and read from there the next time; the name must change
+ *  whenever the function or its parameters do. Width, height and format
+ *  are part of the cache key.
+ */
 extern Texture* CreateProceduralTexture(int width, int height,
                                         int format,
                                         ProceduralTexEval func,
                                         Texture::AddressMode addressMode = Texture::EdgeClamp,
-                                        Texture::MipMapMode mipMode = Texture::DefaultMipMaps);
+                                        Texture::MipMapMode mipMode = Texture::DefaultMipMaps,
+                                        const char* cacheName = nullptr);
 extern Texture* CreateProceduralTexture(int width, int height,
                                         int format,
                                         TexelFunctionObject& func,
                                         Texture::AddressMode addressMode = Texture::EdgeClamp,
-                                        Texture::MipMapMode mipMode = Texture::DefaultMipMaps);
+                                        Texture::MipMapMode mipMode = Texture::DefaultMipMaps,
+                                        const char* cacheName = nullptr);
 extern Texture* CreateProceduralCubeMap(int size, int format,
-                                        ProceduralTexEval func);
+                                        ProceduralTexEval func,
+                                        const char* cacheName = nullptr);
+
+/*! Create a texture from an image; images loaded from .dxt5nm files
+ *  are marked as DXT5 compressed normal maps.
+ */
+extern Texture* CreateTextureFromImage(Image& img,
+                                       Texture::AddressMode addressMode,
+                                       Texture::MipMapMode mipMode,
+                                       ContentType contentType = Content_Unknown);
 
 extern Texture* LoadTextureFromFile(const std::string& filename,
                                     Texture::AddressMode addressMode = Texture::EdgeClamp,
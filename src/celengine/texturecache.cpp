@@ -0,0 +1,243 @@
+// texturecache.cpp
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Disk cache of decoded texture images, ready to be uploaded.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <GL/glew.h>
+#include <fmt/printf.h>
+#include <celutil/bytes.h>
+#include <celutil/debug.h>
+#include <celutil/directory.h>
+#include "image.h"
+#include "texturecache.h"
+
+using namespace std;
+
+
+const char TextureCache::Magic[8] = { 'C', 'E', 'L', 'T', 'E', 'X', 'C', 'H' };
+
+// Larger images are taken to be a corrupt cache file
+constexpr const uint32_t MaxImageSize = 65536;
+
+static TextureCache* textureCache = nullptr;
+
+
+static uint32_t readUint32(const char* p)
+{
+    uint32_t n;
+    memcpy(&n, p, sizeof n);
+    LE_TO_CPU_INT32(n, n);
+    return n;
+}
+
+
+static void writeUint32(char* p, uint32_t n)
+{
+    LE_TO_CPU_INT32(n, n);
+    memcpy(p, &n, sizeof n);
+}
+
+
+static bool isUncompressedFormat(uint32_t format)
+{
+    switch (format)
+    {
+    case GL_RGBA:
+    case GL_BGRA_EXT:
+    case GL_RGB:
+    case GL_BGR_EXT:
+    case GL_LUMINANCE_ALPHA:
+    case GL_ALPHA:
+    case GL_LUMINANCE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+// Size of the pixels of all the mip levels, without the padding byte that
+// Image allocates.
+static size_t pixelDataSize(const Image& img)
+{
+    size_t size = 0;
+    for (int i = 0; i < img.getMipLevelCount(); i++)
+        size += img.getMipLevelSize(i);
+    return size;
+}
+
+
+static bool cacheKey(const string& filename, const string& options, string& key)
+{
+    int64_t mtime;
+    if (!GetModificationTime(filename, mtime))
+        return false;
+
+    key = fmt::sprintf("%s\n%s\n%d", filename, options, mtime);
+    return true;
+}
+
+
+TextureCache::TextureCache(const string& _dir) :
+    dir(_dir)
+{
+}
+
+
+string TextureCache::cacheFileName(const string& name) const
+{
+    uint64_t h = hash<string>()(name);
+    return fmt::sprintf("%s/%016x.tex", dir, h);
+}
+
+
+Image* TextureCache::readEntry(const string& name, const string& key) const
+{
+    ifstream in(cacheFileName(name), ios::in | ios::binary);
+    if (!in.good())
+        return nullptr;
+
+    char header[HeaderSize];
+    if (!in.read(header, HeaderSize) || memcmp(header, Magic, sizeof Magic) != 0)
+        return nullptr;
+
+    uint32_t version = readUint32(header + 8);
+    uint32_t format = readUint32(header + 12);
+    uint32_t width = readUint32(header + 16);
+    uint32_t height = readUint32(header + 20);
+    uint32_t mipLevels = readUint32(header + 24);
+    uint32_t keyLength = readUint32(header + 28);
+    if (version != Version || keyLength != key.size())
+        return nullptr;
+
+    // An entry for an older version of the file is left to be replaced
+    string storedKey(keyLength, '\0');
+    if (!in.read(&storedKey[0], keyLength) || storedKey != key)
+        return nullptr;
+
+    if (!isUncompressedFormat(format) ||
+        width == 0 || width > MaxImageSize ||
+        height == 0 || height > MaxImageSize ||
+        mipLevels == 0 || mipLevels > 32)
+    {
+        return nullptr;
+    }
+
+    unique_ptr<Image> img(new Image(format, width, height, mipLevels));
+    if (!in.read((char*) img->getPixels(), pixelDataSize(*img)))
+        return nullptr;
+
+    DPRINTF(1, "Loaded %s from the texture cache\n", name.c_str());
+    return img.release();
+}
+
+
+bool TextureCache::writeEntry(const string& name, const string& key, Image& img) const
+{
+    if (!isUncompressedFormat(img.getFormat()))
+        return false;
+
+    char header[HeaderSize];
+    memcpy(header, Magic, sizeof Magic);
+    writeUint32(header + 8, Version);
+    writeUint32(header + 12, img.getFormat());
+    writeUint32(header + 16, img.getWidth());
+    writeUint32(header + 20, img.getHeight());
+    writeUint32(header + 24, img.getMipLevelCount());
+    writeUint32(header + 28, key.size());
+
+    // Write to a temporary file first, so that a texture being loaded by
+    // another thread never sees a partly written entry.
+    string cacheFile = cacheFileName(name);
+    string tempFile = fmt::sprintf("%s.%x", cacheFile, hash<thread::id>()(this_thread::get_id()));
+    {
+        ofstream out(tempFile, ios::out | ios::binary);
+        out.write(header, HeaderSize);
+        out.write(key.data(), key.size());
+        out.write((const char*) img.getPixels(), pixelDataSize(img));
+        if (!out.good())
+        {
+            out.close();
+            remove(tempFile.c_str());
+            fmt::fprintf(cerr, "Error writing texture cache file %s\n", cacheFile);
+            return false;
+        }
+    }
+
+    // rename() doesn't replace existing files everywhere
+    remove(cacheFile.c_str());
+    if (rename(tempFile.c_str(), cacheFile.c_str()) != 0)
+    {
+        remove(tempFile.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+Image* TextureCache::load(const string& filename, const string& options) const
+{
+    string key;
+    if (!cacheKey(filename, options, key))
+        return nullptr;
+
+    return readEntry(filename + '\n' + options, key);
+}
+
+
+bool TextureCache::store(const string& filename, const string& options, Image& img) const
+{
+    string key;
+    if (!cacheKey(filename, options, key))
+        return false;
+
+    return writeEntry(filename + '\n' + options, key, img);
+}
+
+
+// Generated images have no file to check, so their entries are only valid
+// for the version of Celestia that made them.
+Image* TextureCache::loadGenerated(const string& name) const
+{
+    return readEntry(name, fmt::sprintf("%s\n%s", name, VERSION));
+}
+
+
+bool TextureCache::storeGenerated(const string& name, Image& img) const
+{
+    return writeEntry(name, fmt::sprintf("%s\n%s", name, VERSION), img);
+}
+
+
+bool EnableTextureCache(const string& dir)
+{
+    if (!MakeDirectory(dir))
+    {
+        fmt::fprintf(cerr, "Cannot create texture cache directory %s\n", dir);
+        return false;
+    }
+
+    delete textureCache;
+    textureCache = new TextureCache(dir);
+    return true;
+}
+
+
+TextureCache* GetTextureCache()
+{
+    return textureCache;
+}
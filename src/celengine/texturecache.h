@@ -0,0 +1,86 @@
+// texturecache.h
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Disk cache of decoded texture images, ready to be uploaded.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class Image;
+
+
+/*! The texture cache keeps the images of textures as they are uploaded:
+ *  decoded, converted to normal maps in the case of bump maps, and with
+ *  their mipmaps already built. Loading a texture from the cache costs
+ *  little more than reading the file.
+ *
+ *  Entries are identified by the name of the source file and a string
+ *  describing the options the texture was loaded with; an entry is only
+ *  used if the source file hasn't been modified since it was stored.
+ *  Generated images are identified by name, and only used by the version
+ *  of Celestia that stored them.
+ *  The cache may be used from several threads at once.
+ *
+ *  All values are little endian. A cache file starts with a header:
+ *
+ *      char[8]   magic "CELTEXCH"
+ *      uint32    format version (1)
+ *      uint32    OpenGL format of the image
+ *      uint32    width
+ *      uint32    height
+ *      uint32    number of mip levels
+ *      uint32    length of the key
+ *
+ *  followed by the key, made from the source file name, the options and
+ *  the modification time of the file (or the name of a generated image
+ *  and the Celestia version), and then the pixels of every mip
+ *  level with rows padded to four bytes, as in an Image.
+ */
+class TextureCache
+{
+ public:
+    static const char Magic[8];
+    static const uint32_t Version = 1;
+    static const std::size_t HeaderSize = 32;
+
+    TextureCache(const std::string& dir);
+
+    //! Read a cached image; returns nullptr if there's no up to date entry.
+    Image* load(const std::string& filename, const std::string& options) const;
+
+    //! Store an image; compressed images are not supported.
+    bool store(const std::string& filename, const std::string& options, Image& img) const;
+
+    /*! Read or store an image that isn't loaded from a file but generated,
+     *  such as a procedural texture. The name must identify the image and
+     *  all the parameters it was generated with, including the version of
+     *  the generator and the encoding of the pixels.
+     */
+    Image* loadGenerated(const std::string& name) const;
+    bool storeGenerated(const std::string& name, Image& img) const;
+
+ private:
+    std::string cacheFileName(const std::string& name) const;
+    Image* readEntry(const std::string& name, const std::string& key) const;
+    bool writeEntry(const std::string& name, const std::string& key, Image& img) const;
+
+    std::string dir;
+};
+
+
+/*! Enable the texture cache, keeping the cached images in the directory,
+ *  which is created if it doesn't exist.
+ */
+extern bool EnableTextureCache(const std::string& dir);
+
+//! Return the texture cache, or nullptr if it is disabled.
+extern TextureCache* GetTextureCache();
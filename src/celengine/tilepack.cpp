@@ -0,0 +1,97 @@
+// tilepack.cpp
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Single file archive of the tiles of a virtual texture.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <cstring>
+#include <iostream>
+#include <fmt/printf.h>
+#include <celutil/bytes.h>
+#include "tilepack.h"
+
+using namespace std;
+
+
+const char TilePack::Magic[8] = { 'C', 'E', 'L', 'T', 'P', 'A', 'C', 'K' };
+
+
+static uint32_t readUint32(const unsigned char* p)
+{
+    uint32_t n;
+    memcpy(&n, p, sizeof n);
+    LE_TO_CPU_INT32(n, n);
+    return n;
+}
+
+
+static uint64_t readUint64(const unsigned char* p)
+{
+    uint64_t n;
+    memcpy(&n, p, sizeof n);
+    LE_TO_CPU_INT64(n, n);
+    return n;
+}
+
+
+bool TilePack::open(const string& filename)
+{
+    if (!file.open(filename))
+    {
+        fmt::fprintf(cerr, "Error opening tile pack %s\n", filename);
+        return false;
+    }
+
+    const unsigned char* header = file.getData();
+    if (file.getSize() < HeaderSize || memcmp(header, Magic, sizeof Magic) != 0)
+    {
+        fmt::fprintf(cerr, "%s is not a tile pack\n", filename);
+        file.close();
+        return false;
+    }
+
+    uint32_t version = readUint32(header + 8);
+    if (version != Version)
+    {
+        fmt::fprintf(cerr, "Unsupported version %u of tile pack %s\n", version, filename);
+        file.close();
+        return false;
+    }
+
+    nTiles = readUint32(header + 12);
+    if ((file.getSize() - HeaderSize) / EntrySize < nTiles)
+    {
+        fmt::fprintf(cerr, "Tile pack %s is truncated\n", filename);
+        file.close();
+        nTiles = 0;
+        return false;
+    }
+
+    const char* type = reinterpret_cast<const char*>(header + 16);
+    tileType = string(type, strnlen(type, 8));
+
+    return true;
+}
+
+
+bool TilePack::getEntry(uint32_t index, Entry& entry) const
+{
+    if (index >= nTiles)
+        return false;
+
+    const unsigned char* p = file.getData() + HeaderSize + (size_t) index * EntrySize;
+    entry.level = readUint32(p);
+    entry.u = readUint32(p + 4);
+    entry.v = readUint32(p + 8);
+    entry.size = readUint32(p + 12);
+    entry.offset = readUint64(p + 16);
+
+    return entry.size != 0 &&
+           entry.offset <= file.getSize() &&
+           entry.size <= file.getSize() - entry.offset;
+}
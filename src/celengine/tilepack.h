@@ -0,0 +1,80 @@
+// tilepack.h
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Single file archive of the tiles of a virtual texture.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <celutil/mappedfile.h>
+
+
+/*! A tile pack holds all the tiles of a virtual texture in one file, so
+ *  that neither the directories of tiles have to be listed when the
+ *  texture is loaded nor each tile opened when it is drawn. The file is
+ *  memory mapped, and tiles are read from it by offset.
+ *
+ *  All values are little endian. The file starts with a header:
+ *
+ *      char[8]   magic "CELTPACK"
+ *      uint32    format version (1)
+ *      uint32    number of tiles
+ *      char[8]   tile file type, e.g. "dds", "jpg" or "png", NUL padded
+ *      uint32[2] reserved, zero
+ *
+ *  followed by an index entry for every tile:
+ *
+ *      uint32    level, as in the levelN directories of a tile tree
+ *      uint32    u
+ *      uint32    v
+ *      uint32    size of the tile image in bytes
+ *      uint64    offset of the tile image from the start of the file
+ *
+ *  The tile images follow the index; each is the complete contents of the
+ *  file the tile would have in a tile tree.
+ */
+class TilePack
+{
+ public:
+    struct Entry
+    {
+        uint32_t level{ 0 };
+        uint32_t u{ 0 };
+        uint32_t v{ 0 };
+        uint32_t size{ 0 };
+        uint64_t offset{ 0 };
+    };
+
+    static const char Magic[8];
+    static const uint32_t Version = 1;
+    static const std::size_t HeaderSize = 32;
+    static const std::size_t EntrySize = 24;
+
+    TilePack() = default;
+
+    bool open(const std::string& filename);
+
+    const std::string& getTileType() const { return tileType; }
+    uint32_t getTileCount() const { return nTiles; }
+
+    //! Read an index entry; returns false if the tile lies outside the file.
+    bool getEntry(uint32_t index, Entry& entry) const;
+
+    const unsigned char* getTileData(uint64_t offset) const
+    {
+        return file.getData() + offset;
+    }
+
+ private:
+    MappedFile file;
+    std::string tileType;
+    uint32_t nTiles{ 0 };
+};
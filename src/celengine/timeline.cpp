@@ -14,6 +14,7 @@
 #include "celengine/timelinephase.h"
 #include "celengine/frametree.h"
 #include "celengine/frame.h"
+#include <algorithm>
 
 using namespace std;
 
@@ -48,6 +49,7 @@ Timeline::appendPhase(TimelinePhase* phase)
 
     phase->addRef();
     phases.push_back(phase);
+    endTimes.push_back(phase->endTime());
 
     return true;
 }
@@ -57,23 +59,23 @@ const TimelinePhase*
 Timeline::findPhase(double t) const
 {
     // Find the phase containing time t. The overwhelming common case is
-    // nPhases = 1, so we special case that. Otherwise, we do a simple linear search,
-    // as the number of phases in a timeline should always be quite small.
+    // nPhases = 1, so we special case that. Otherwise try the phase found by
+    // the previous call before falling back to a binary search, since mission
+    // timelines may have hundreds of phases.
     if (phases.size() == 1)
-    {
         return phases[0];
-    }
-    else
-    {
-        for (const auto phase : phases)
-        {
-            if (t < phase->endTime())
-                return phase;
-        }
 
-        // Time is greater than the end time of the final phase. Just return the final phase.
-        return phases.back();
-    }
+    unsigned int last = lastPhase.load(memory_order_relaxed);
+    if (t < endTimes[last] && (last == 0 || t >= endTimes[last - 1]))
+        return phases[last];
+
+    auto iter = upper_bound(endTimes.begin(), endTimes.end(), t);
+
+    // Time is greater than the end time of the final phase. Just return the final phase.
+    unsigned int n = iter == endTimes.end() ? endTimes.size() - 1 : iter - endTimes.begin();
+    lastPhase.store(n, memory_order_relaxed);
+
+    return phases[n];
 }
 
 
@@ -13,6 +13,7 @@
 #ifndef _CELENGINE_TIMELINE_H_
 #define _CELENGINE_TIMELINE_H_
 
+#include <atomic>
 #include <vector>
 
 class ReferenceFrame;
@@ -20,6 +21,11 @@ class Orbit;
 class RotationModel;
 class TimelinePhase;
 
+/*! Phases are appended in time order while the timeline is loaded and
+ *  never change afterwards, so findPhase() searches a sorted copy of the
+ *  phase end times. The last phase found is remembered, since successive
+ *  lookups are usually for the same or a nearby time.
+ */
 class Timeline
 {
 public:
@@ -39,6 +45,8 @@ public:
 
 private:
     std::vector<TimelinePhase*> phases;
+    std::vector<double> endTimes;
+    mutable std::atomic<unsigned int> lastPhase{ 0 };
 };
 
 #endif // _CELENGINE_TIMELINE_H_
@@ -18,6 +18,9 @@
 #include "celephem/rotation.h"
 #include <cassert>
 
+using namespace Eigen;
+using namespace std;
+
 
 TimelinePhase::TimelinePhase(Body* _body,
                              double _startTime,
@@ -73,15 +76,63 @@ int TimelinePhase::addRef() const
 
 int TimelinePhase::release() const
 {
-    --refCount;
-    assert(refCount >= 0);
-    if (refCount <= 0)
+    int refCountCopy = --refCount;
+    assert(refCountCopy >= 0);
+    if (refCountCopy <= 0)
     {
         delete this;
         return 0;
     }
 
-    return refCount;
+    return refCountCopy;
+}
+
+
+// Defined here rather than in the header, which can't include frametree.h
+unsigned int TimelinePhase::currentEpoch()
+{
+    return FrameTree::editEpoch();
+}
+
+
+/*! Compute the snapshot of this phase for time tdb unless it already
+ *  exists, and return the astrocentric position of the body. frameCenter
+ *  is the astrocentric position of the orbit frame center, and origin the
+ *  universal position of the star at the root of the frame tree.
+ *
+ *  The snapshot is also recomputed after any trajectory or frame has been
+ *  edited, since the body may be placed relative to the edited one, even
+ *  if the time hasn't changed (for example while time is paused.)
+ */
+Vector3d TimelinePhase::updateSnapshot(double tdb,
+                                       const Vector3d& frameCenter,
+                                       const UniversalCoord& origin) const
+{
+    unsigned int epoch = FrameTree::editEpoch();
+    {
+        lock_guard<mutex> lock(m_snapshotMutex);
+        if (m_snapshot.tdb == tdb && m_snapshot.epoch == epoch)
+            return m_snapshot.astrocentricPosition;
+    }
+
+    // Evaluate without holding the lock: frames and rotation models may
+    // need the snapshots of other phases.
+    PhaseSnapshot s;
+    s.tdb = tdb;
+    s.epoch = epoch;
+    Vector3d p = m_orbit->positionAtTime(tdb);
+    s.astrocentricPosition = frameCenter + m_orbitFrame->getOrientation(tdb).conjugate() * p;
+    s.position = origin.offsetKm(s.astrocentricPosition);
+
+    Quaterniond equator = m_rotationModel->equatorOrientationAtTime(tdb);
+    s.equatorialToBodyFixed = m_rotationModel->spin(tdb);
+    s.eclipticToFrame = m_bodyFrame->getOrientation(tdb);
+    s.eclipticToEquatorial = equator * s.eclipticToFrame;
+    s.eclipticToBodyFixed = s.equatorialToBodyFixed * s.eclipticToEquatorial;
+
+    lock_guard<mutex> lock(m_snapshotMutex);
+    m_snapshot = s;
+    return s.astrocentricPosition;
 }
 
 
@@ -13,6 +13,13 @@
 #ifndef _CELENGINE_TIMELINEPHASE_H_
 #define _CELENGINE_TIMELINEPHASE_H_
 
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <celengine/univcoord.h>
+
 class ReferenceFrame;
 class Orbit;
 class RotationModel;
@@ -21,9 +28,33 @@ class Universe;
 class Body;
 
 
+/*! Position and orientation of the body of a timeline phase at a single
+ *  time. Snapshots are computed once per rendered frame for all bodies in
+ *  the nearby frame trees (see FrameTree::updateSnapshot) so that the
+ *  renderer, the observer and the body accessors don't evaluate the same
+ *  ephemerides repeatedly.
+ */
+struct PhaseSnapshot
+{
+    double tdb{ std::numeric_limits<double>::quiet_NaN() };
+    unsigned int epoch{ 0 };    // FrameTree::editEpoch() when computed
+    UniversalCoord position;
+    Eigen::Vector3d astrocentricPosition;
+    Eigen::Quaterniond eclipticToFrame;
+    Eigen::Quaterniond eclipticToEquatorial;
+    Eigen::Quaterniond eclipticToBodyFixed;
+    Eigen::Quaterniond equatorialToBodyFixed;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+
 class TimelinePhase
 {
 public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+
     int addRef() const;
     int release() const;
 
@@ -78,6 +109,27 @@ public:
         return m_startTime <= t && t < m_endTime;
     }
 
+    /*! Copy one field of the snapshot of this phase into value if the
+     *  snapshot was computed for time tdb since the last edit of any
+     *  trajectory or frame, for example
+     *  getSnapshot(tdb, &PhaseSnapshot::position, position). Returns false
+     *  if there is no such snapshot.
+     */
+    template<class T> bool getSnapshot(double tdb, T PhaseSnapshot::*field, T& value) const
+    {
+        unsigned int epoch = currentEpoch();
+        std::lock_guard<std::mutex> lock(m_snapshotMutex);
+        if (m_snapshot.tdb != tdb || m_snapshot.epoch != epoch)
+            return false;
+
+        value = m_snapshot.*field;
+        return true;
+    }
+
+    Eigen::Vector3d updateSnapshot(double tdb,
+                                   const Eigen::Vector3d& frameCenter,
+                                   const UniversalCoord& origin) const;
+
     static TimelinePhase* CreateTimelinePhase(Universe& universe,
                                               Body* body,
                                               double startTime,
@@ -106,6 +158,8 @@ private:
     // TimelinePhases are refCounted; use release() instead.
     ~TimelinePhase();
 
+    static unsigned int currentEpoch();
+
 private:
     Body* m_body;
 
@@ -119,7 +173,10 @@ private:
 
     FrameTree* m_owner;
 
-    mutable int refCount;
+    mutable std::atomic<int> refCount;
+
+    mutable PhaseSnapshot m_snapshot;
+    mutable std::mutex m_snapshotMutex;
 };
 
 #endif // _CELENGINE_TIMELINEPHASE_H_
@@ -47,7 +47,7 @@ class UniversalCoord
     /** Compute a universal coordinate that is the sum of this coordinate and
       * an offset in kilometers.
       */
-    UniversalCoord offsetKm(const Eigen::Vector3d& v)
+    UniversalCoord offsetKm(const Eigen::Vector3d& v) const
     {
         Eigen::Vector3d vUly = v * astro::kilometersToMicroLightYears(1.0);
         return *this + UniversalCoord(vUly);
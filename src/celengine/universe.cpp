@@ -422,20 +422,19 @@ static bool traverseFrameTree(FrameTree* frameTree,
                               PlanetarySystem::TraversalFunc func,
                               void* info)
 {
-    for (unsigned int i = 0; i < frameTree->childCount(); i++)
+    vector<TimelinePhase*> active;
+    frameTree->getActiveChildren(tdb, active);
+
+    for (const auto phase : active)
     {
-        TimelinePhase* phase = frameTree->getChild(i);
-        if (phase->includes(tdb))
+        Body* body = phase->body();
+        if (!func(body, info))
+            return false;
+
+        if (body->getFrameTree() != nullptr)
         {
-            Body* body = phase->body();
-            if (!func(body, info))
+            if (!traverseFrameTree(body->getFrameTree(), tdb, func, info))
                 return false;
-
-            if (body->getFrameTree() != nullptr)
-            {
-                if (!traverseFrameTree(body->getFrameTree(), tdb, func, info))
-                    return false;
-            }
         }
     }
 
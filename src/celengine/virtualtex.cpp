@@ -10,8 +10,11 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cassert>
+#include <iterator>
 #include <utility>
 #include <fmt/printf.h>
 #include "celutil/debug.h"
@@ -25,6 +28,24 @@ using namespace std;
 
 static const int MaxResolutionLevels = 13;
 
+// Maximum number of tiles of one texture being decoded at once. Tiles that
+// are still needed once the queue has room are requested again by the
+// next getTile() call, so zooming quickly doesn't fill the queue with
+// tiles that are no longer visible.
+static const size_t MaxPendingTiles = 16;
+
+// Prefetched tiles are only queued for decoding while fewer than this many
+// tiles are being decoded, leaving room for the tiles that are needed to
+// draw the current frame.
+static const size_t MaxPendingPrefetches = MaxPendingTiles / 2;
+static const size_t MaxPrefetchRequests = 64;
+
+// Time per frame that may be spent creating textures from decoded tiles,
+// for all virtual textures together
+static const double TileUploadBudget = 0.002; // seconds
+
+static const size_t DefaultTileMemoryBudget = 512 * 1024 * 1024;
+
 
 // Virtual textures are composed of tiles that are loaded from the hard drive
 // as they become visible.  Hidden tiles may be evicted from graphics memory
@@ -43,6 +64,58 @@ static bool isPow2(int x)
 }
 
 
+// Resident tiles of all virtual textures. The clock is advanced by every
+// beginUsage(), and tiles are stamped with it when used, so that comparing
+// stamps orders tiles of different textures by how recently they were used.
+// Tiles are also moved to the end of the LRU list when first used after a
+// beginUsage(), so that eviction doesn't have to sort them.
+class VirtualTexture::TileCache
+{
+ public:
+    TileLruList lru;
+    size_t memoryUsage{ 0 };
+    size_t memoryBudget{ DefaultTileMemoryBudget };
+    unsigned int clock{ 0 };
+    TileCacheStats stats;
+
+    // Tile textures created since the last beginFrame()
+    unsigned int tilesUploaded{ 0 };
+    double uploadTime{ 0.0 };   // seconds
+};
+
+
+VirtualTexture::TileCache& VirtualTexture::tileCache()
+{
+    static TileCache cache;
+    return cache;
+}
+
+
+void VirtualTexture::setTileMemoryBudget(size_t budget)
+{
+    tileCache().memoryBudget = budget;
+}
+
+
+VirtualTexture::TileCacheStats VirtualTexture::getTileCacheStats()
+{
+    const TileCache& cache = tileCache();
+    TileCacheStats stats = cache.stats;
+    stats.residentTiles = cache.lru.size();
+    stats.memoryUsage = cache.memoryUsage;
+    stats.memoryBudget = cache.memoryBudget;
+    return stats;
+}
+
+
+void VirtualTexture::beginFrame()
+{
+    TileCache& cache = tileCache();
+    cache.tilesUploaded = 0;
+    cache.uploadTime = 0.0;
+}
+
+
 #if 0
 // Useful if we want to use a packed quadtree to store tiles instead of
 // the currently implemented tree structure.
@@ -57,10 +130,12 @@ VirtualTexture::VirtualTexture(string  _tilePath,
                                unsigned int _baseSplit,
                                unsigned int _tileSize,
                                string  _tilePrefix,
-                               const string& _tileType) :
+                               const string& _tileType,
+                               TilePack* _tilePack) :
     Texture(_tileSize << (_baseSplit + 1), _tileSize << _baseSplit),
     tilePath(std::move(_tilePath)),
     tilePrefix(std::move(_tilePrefix)),
+    tilePack(_tilePack),
     baseSplit(_baseSplit),
     tileSize(_tileSize),
     ticks(0),
@@ -70,13 +145,43 @@ VirtualTexture::VirtualTexture(string  _tilePath,
     tileTree[0] = new TileQuadtreeNode();
     tileTree[1] = new TileQuadtreeNode();
     tileExt = string(".") + _tileType;
-    populateTileTree();
+    tileType = DetermineFileType(tileExt);
+    if (tilePack != nullptr)
+        populateTileTreeFromPack();
+    else
+        populateTileTree();
 
-    if (DetermineFileType(tileExt) == Content_DXT5NormalMap)
+    if (tileType == Content_DXT5NormalMap)
         setFormatOptions(Texture::DXT5NormalMap);
 }
 
 
+VirtualTexture::~VirtualTexture()
+{
+    // Tiles are decoded from the tile pack and with this texture's
+    // members, so wait for those being decoded.
+    for (auto& pending : pendingTiles)
+    {
+        pending.request->cancel();
+        delete pending.request->wait();
+    }
+
+    TileCache& cache = tileCache();
+    for (auto iter = cache.lru.begin(); iter != cache.lru.end(); )
+    {
+        if (iter->texture == this)
+        {
+            cache.memoryUsage -= iter->tile->memoryUsage;
+            iter = cache.lru.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
+
+
 const TextureTile VirtualTexture::getTile(int lod, int u, int v)
 {
     tilesRequested++;
@@ -97,6 +202,13 @@ const TextureTile VirtualTexture::getTile(int lod, int u, int v)
     Tile* tile = node->tile;
     unsigned int tileLOD = 0;
 
+    // Track the coarsest tile on the path, and the finest one that is
+    // already resident.
+    Tile* baseTile = tile;
+    unsigned int baseLOD = 0;
+    Tile* residentTile = tile != nullptr && tile->tex != nullptr ? tile : nullptr;
+    unsigned int residentLOD = 0;
+
     for (int n = 0; n < lod; n++)
     {
         unsigned int mask = 1 << (lod - n - 1);
@@ -110,6 +222,16 @@ const TextureTile VirtualTexture::getTile(int lod, int u, int v)
         {
             tile = node->tile;
             tileLOD = n + 1;
+            if (baseTile == nullptr)
+            {
+                baseTile = tile;
+                baseLOD = tileLOD;
+            }
+            if (tile->tex != nullptr)
+            {
+                residentTile = tile;
+                residentLOD = tileLOD;
+            }
         }
     }
 
@@ -117,10 +239,26 @@ const TextureTile VirtualTexture::getTile(int lod, int u, int v)
     if (!tile)
         return TextureTile(0);
 
-    // Make the tile resident.
-    unsigned int tileU = u >> (lod - tileLOD);
-    unsigned int tileV = v >> (lod - tileLOD);
-    makeResident(tile, tileLOD, tileU, tileV);
+    // Have the finest tile decoded in the background, and draw the finest
+    // resident tile in the meantime. When not even the coarsest tile is
+    // resident, load it right away so that the surface isn't drawn
+    // without a texture.
+    requestTile(tile, tileLOD, u >> (lod - tileLOD), v >> (lod - tileLOD), ImageDecoder::Normal);
+    if (residentTile == nullptr)
+    {
+        makeResident(baseTile, baseLOD, u >> (lod - baseLOD), v >> (lod - baseLOD));
+        residentTile = baseTile;
+        residentLOD = baseLOD;
+    }
+
+    if (residentTile == tile)
+        tileCache().stats.hits++;
+    else
+        tileCache().stats.misses++;
+
+    tile = residentTile;
+    tileLOD = residentLOD;
+    useTile(tile);
 
     // It's possible that we failed to make the tile resident, either
     // because the texture file was bad, or there was an unresolvable
@@ -177,13 +315,88 @@ int VirtualTexture::getVTileCount(int lod) const
 
 void VirtualTexture::beginUsage()
 {
-    ticks++;
+    ticks = ++tileCache().clock;
     tilesRequested = 0;
+    uploadTiles();
+
+    // Prefetch requests are predictions made for the previous frame; those
+    // that can't be started now are dropped and predicted again.
+    for (const auto& r : prefetchRequests)
+    {
+        if (pendingTiles.size() >= MaxPendingPrefetches)
+            break;
+        requestTile(r.tile, r.lod, r.u, r.v, ImageDecoder::Prefetch);
+    }
+    prefetchRequests.clear();
+}
+
+
+/*! Queue a tile to be loaded at low priority, if it isn't resident. The
+ *  tile is given in the same coordinates as for getTile(). Requests are
+ *  started at the next beginUsage() when few tiles are being decoded.
+ */
+void VirtualTexture::prefetchTile(int lod, int u, int v)
+{
+    lod += baseSplit;
+
+    if (lod < 0 || (unsigned int) lod >= nResolutionLevels ||
+        u < 0 || u >= (2 << lod) ||
+        v < 0 || v >= (1 << lod) ||
+        prefetchRequests.size() >= MaxPrefetchRequests)
+    {
+        return;
+    }
+
+    // Find the finest tile covering the area, as getTile() does
+    TileQuadtreeNode* node = tileTree[u >> lod];
+    Tile* tile = node->tile;
+    unsigned int tileLOD = 0;
+    for (int n = 0; n < lod; n++)
+    {
+        unsigned int mask = 1 << (lod - n - 1);
+        unsigned int child = (((v & mask) << 1) | (u & mask)) >> (lod - n - 1);
+        if (!node->children[child])
+            break;
+
+        node = node->children[child];
+        if (node->tile != nullptr)
+        {
+            tile = node->tile;
+            tileLOD = n + 1;
+        }
+    }
+
+    if (tile == nullptr || tile->tex != nullptr || tile->loadFailed || tile->loadPending)
+        return;
+
+    for (const auto& r : prefetchRequests)
+    {
+        if (r.tile == tile)
+            return;
+    }
+
+    prefetchRequests.push_back({ tile, tileLOD, (unsigned int) u >> (lod - tileLOD), (unsigned int) v >> (lod - tileLOD) });
 }
 
 
+/*! Evict the least recently used tiles of all virtual textures while their
+ *  memory usage is over budget. Eviction stops at the first tile used since
+ *  this texture's beginUsage(), even if that leaves the cache over budget.
+ */
 void VirtualTexture::endUsage()
 {
+    TileCache& cache = tileCache();
+    while (cache.memoryUsage > cache.memoryBudget && !cache.lru.empty())
+    {
+        const CacheEntry& e = cache.lru.front();
+        if (e.tile->lastUsed >= ticks)
+            break;
+
+        cache.memoryUsage -= e.tile->memoryUsage;
+        e.texture->evictTile(e.tile);
+        cache.lru.pop_front();
+        cache.stats.evictions++;
+    }
 }
 
 
@@ -197,50 +410,182 @@ unsigned int VirtualTexture::tileIndex(unsigned int lod,
 #endif
 
 
-ImageTexture* VirtualTexture::loadTileTexture(unsigned int lod, unsigned int u, unsigned int v)
+string VirtualTexture::tileFileName(unsigned int lod, unsigned int u, unsigned int v) const
 {
-    lod >>= baseSplit;
+    // Tiles of the tree level lod are in the directory of level lod - baseSplit
+    lod -= baseSplit;
 
     assert(lod < (unsigned)MaxResolutionLevels);
 
-    string path;
-    path = fmt::sprintf("%slevel%d/%s%d_%d%s", tilePath, lod, tilePrefix.c_str(), u, v, tileExt);
+    return fmt::sprintf("%slevel%d/%s%d_%d%s", tilePath, lod, tilePrefix.c_str(), u, v, tileExt);
+}
 
-    Image* img = LoadImageFromFile(path);
-    if (img == nullptr)
-        return nullptr;
 
+// Read and decode the image of a tile, either from the tile pack or from
+// its own file. This is called on the decoder threads.
+Image* VirtualTexture::loadTileImage(const Tile* tile, unsigned int lod, unsigned int u, unsigned int v) const
+{
+    if (tilePack == nullptr)
+        return LoadImageFromFile(tileFileName(lod, u, v));
+
+    return LoadImageFromMemory(tilePack->getTileData(tile->packOffset),
+                               tile->packSize,
+                               tileType,
+                               tileFileName(lod, u, v));
+}
+
+
+ImageTexture* VirtualTexture::createTileTexture(Image& img, unsigned int lod)
+{
     ImageTexture* tex = nullptr;
 
     // Only use mip maps for the LOD 0; for higher LODs, the function of mip
     // mapping is built into the texture.
-    MipMapMode mipMapMode = lod == 0 ? DefaultMipMaps : NoMipMaps;
+    MipMapMode mipMapMode = lod == baseSplit ? DefaultMipMaps : NoMipMaps;
 
-    if (isPow2(img->getWidth()) && isPow2(img->getHeight()))
-        tex = new ImageTexture(*img, EdgeClamp, mipMapMode);
+    if (isPow2(img.getWidth()) && isPow2(img.getHeight()))
+        tex = new ImageTexture(img, EdgeClamp, mipMapMode);
 
     // TODO: Virtual textures can have tiles in different formats, some
     // compressed and some not. The compression flag doesn't make much
     // sense for them.
-    compressed = img->isCompressed();
-
-    delete img;
+    compressed = img.isCompressed();
 
     return tex;
 }
 
 
+// Create the texture of a tile from its decoded image, and take ownership
+// of the image.
+void VirtualTexture::finishTile(Tile* tile, unsigned int lod, Image* img)
+{
+    if (img != nullptr)
+    {
+        tile->tex = createTileTexture(*img, lod);
+
+        // The GL creates the mip maps of the first level
+        tile->memoryUsage = (size_t) img->getSize();
+        if (lod == baseSplit && img->getMipLevelCount() == 1)
+            tile->memoryUsage += tile->memoryUsage / 3;
+
+        delete img;
+    }
+
+    tile->loadPending = false;
+    if (tile->tex == nullptr)
+    {
+        // cout << "Texture load failed!\n";
+        tile->loadFailed = true;
+        return;
+    }
+
+    tile->lastUsed = ticks;
+    TileCache& cache = tileCache();
+    cache.lru.push_back({ this, tile });
+    tile->lruPos = prev(cache.lru.end());
+    cache.memoryUsage += tile->memoryUsage;
+}
+
+
+// Mark a tile as used since this texture's beginUsage(); resident tiles
+// are moved to the most recently used end of the cache.
+void VirtualTexture::useTile(Tile* tile)
+{
+    if (tile->lastUsed == ticks)
+        return;
+
+    tile->lastUsed = ticks;
+    if (tile->tex != nullptr)
+    {
+        TileLruList& lru = tileCache().lru;
+        lru.splice(lru.end(), lru, tile->lruPos);
+    }
+}
+
+
+// Release the texture of a tile; it is loaded again when next needed.
+void VirtualTexture::evictTile(Tile* tile)
+{
+    delete tile->tex;
+    tile->tex = nullptr;
+    tile->memoryUsage = 0;
+}
+
+
+/*! Load a tile right away, waiting for it if it's already being decoded
+ *  in the background.
+ */
 void VirtualTexture::makeResident(Tile* tile, unsigned int lod, unsigned int u, unsigned int v)
 {
-    if (tile->tex == nullptr && !tile->loadFailed)
+    if (tile->tex != nullptr || tile->loadFailed)
+        return;
+
+    auto iter = find_if(pendingTiles.begin(), pendingTiles.end(),
+                        [tile](const PendingTile& p) { return p.tile == tile; });
+    if (iter != pendingTiles.end())
+    {
+        Image* img = iter->request->wait();
+        pendingTiles.erase(iter);
+        finishTile(tile, lod, img);
+    }
+    else
+    {
+        finishTile(tile, lod, loadTileImage(tile, lod, u, v));
+    }
+}
+
+
+/*! Queue a tile to be decoded in the background if it isn't resident. Its
+ *  texture is created by uploadTiles() in a later frame.
+ */
+void VirtualTexture::requestTile(Tile* tile, unsigned int lod, unsigned int u, unsigned int v,
+                                 ImageDecoder::Priority priority)
+{
+    if (tile->tex != nullptr || tile->loadFailed || tile->loadPending ||
+        pendingTiles.size() >= MaxPendingTiles)
+    {
+        return;
+    }
+
+    // Pending tiles are waited for before the texture is destroyed
+    PendingTile pending;
+    pending.tile = tile;
+    pending.lod = lod;
+    pending.request = GetImageDecoder()->submit(tileType, [this, tile, lod, u, v]()
+    {
+        return loadTileImage(tile, lod, u, v);
+    }, priority);
+    pendingTiles.push_back(std::move(pending));
+    tile->loadPending = true;
+}
+
+
+/*! Create the textures of tiles that have finished decoding. This runs on
+ *  the thread owning the GL context; at least one tile is uploaded per
+ *  frame, and then more until the time budget shared by all virtual
+ *  textures is spent.
+ */
+void VirtualTexture::uploadTiles()
+{
+    TileCache& cache = tileCache();
+
+    for (auto iter = pendingTiles.begin(); iter != pendingTiles.end(); )
     {
-        // Potentially evict other tiles in order to make this one fit
-        tile->tex = loadTileTexture(lod, u, v);
-        if (tile->tex == nullptr)
+        if (cache.tilesUploaded > 0 && cache.uploadTime > TileUploadBudget)
+            break;
+
+        if (!iter->request->isReady())
         {
-            // cout << "Texture load failed!\n";
-            tile->loadFailed = true;
+            ++iter;
+            continue;
         }
+
+        auto startTime = chrono::steady_clock::now();
+        finishTile(iter->tile, iter->lod, iter->request->wait());
+        iter = pendingTiles.erase(iter);
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - startTime;
+        cache.uploadTime += elapsed.count();
+        cache.tilesUploaded++;
     }
 }
 
@@ -290,6 +635,34 @@ void VirtualTexture::populateTileTree()
 }
 
 
+// Build the quadtree from the index of the tile pack, without touching
+// the tile images themselves.
+void VirtualTexture::populateTileTreeFromPack()
+{
+    unsigned int maxLevel = 0;
+    uint32_t nTiles = tilePack->getTileCount();
+
+    for (uint32_t i = 0; i < nTiles; i++)
+    {
+        TilePack::Entry entry;
+        if (!tilePack->getEntry(i, entry) || entry.level >= (uint32_t) MaxResolutionLevels)
+            continue;
+
+        unsigned int lod = entry.level + baseSplit;
+        if (entry.u >= (2u << lod) || entry.v >= (1u << lod))
+            continue;
+
+        Tile* tile = new Tile();
+        tile->packOffset = entry.offset;
+        tile->packSize = entry.size;
+        addTileToTree(tile, lod, entry.u, entry.v);
+        maxLevel = max(maxLevel, lod);
+    }
+
+    nResolutionLevels = maxLevel + 1;
+}
+
+
 void VirtualTexture::addTileToTree(Tile* tile, unsigned int lod, unsigned int u, unsigned int v)
 {
     TileQuadtreeNode* node = tileTree[u >> lod];
@@ -309,16 +682,31 @@ void VirtualTexture::addTileToTree(Tile* tile, unsigned int lod, unsigned int u,
     // Verify that the tile doesn't already exist
     if (!node->tile)
         node->tile = tile;
+    else
+        delete tile;
+}
+
+
+// If absolute notation is used for a file or directory, don't prepend
+// the current add-on path.
+static string AddOnPath(const string& path, const string& filename)
+{
+    if (filename.substr(0,1) != "/" && filename.substr(1,1) != ":")
+        return path + "/" + filename;
+    return filename;
 }
 
 
 static VirtualTexture* CreateVirtualTexture(Hash* texParams,
                                             const string& path)
 {
+    // Tiles are read either from a tile pack or from a directory tree
+    string tilePackFile;
     string imageDirectory;
-    if (!texParams->getString("ImageDirectory", imageDirectory))
+    if (!texParams->getString("TilePack", tilePackFile) &&
+        !texParams->getString("ImageDirectory", imageDirectory))
     {
-        DPRINTF(0, "ImageDirectory missing in virtual texture.\n");
+        DPRINTF(0, "ImageDirectory or TilePack missing in virtual texture.\n");
         return nullptr;
     }
 
@@ -351,13 +739,25 @@ static VirtualTexture* CreateVirtualTexture(Hash* texParams,
     string tilePrefix = "tx_";
     texParams->getString("TilePrefix", tilePrefix);
 
-    // if absolute directory notation for ImageDirectory used,
-    // don't prepend the current add-on path.
-    string directory = imageDirectory + "/";
-    if (directory.substr(0,1) != "/" && directory.substr(1,1) !=":")
+    if (!tilePackFile.empty())
     {
-        directory = path + "/" + directory;
+        auto* tilePack = new TilePack();
+        if (!tilePack->open(AddOnPath(path, tilePackFile)))
+        {
+            delete tilePack;
+            return nullptr;
+        }
+
+        // Tile names are only used in messages
+        return new VirtualTexture(tilePackFile + "/",
+                                  (unsigned int) baseSplit,
+                                  (unsigned int) tileSize,
+                                  tilePrefix,
+                                  tilePack->getTileType(),
+                                  tilePack);
     }
+
+    string directory = AddOnPath(path, imageDirectory + "/");
     return new VirtualTexture(directory,
                               (unsigned int) baseSplit,
                               (unsigned int) tileSize,
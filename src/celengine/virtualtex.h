@@ -10,8 +10,18 @@
 #ifndef _CELENGINE_VIRTUALTEX_H_
 #define _CELENGINE_VIRTUALTEX_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
 #include <string>
+#include <vector>
+#include <celengine/imagedecoder.h>
 #include <celengine/texture.h>
+#include <celengine/tilepack.h>
+#include <celutil/filetype.h>
+
+class Image;
 
 
 class VirtualTexture : public Texture
@@ -21,8 +31,9 @@ class VirtualTexture : public Texture
                    unsigned int _baseSplit,
                    unsigned int _tileSize,
                    std::string _tilePrefix,
-                   const std::string& _tileType);
-    ~VirtualTexture() = default;
+                   const std::string& _tileType,
+                   TilePack* _tilePack = nullptr);
+    ~VirtualTexture();
 
     virtual const TextureTile getTile(int lod, int u, int v);
     virtual void bind();
@@ -32,14 +43,70 @@ class VirtualTexture : public Texture
     virtual int getVTileCount(int lod) const;
     virtual void beginUsage();
     virtual void endUsage();
+    virtual void prefetchTile(int lod, int u, int v);
+
+    struct TileCacheStats
+    {
+        uint64_t hits{ 0 };         // finest tile was resident
+        uint64_t misses{ 0 };       // an ancestor tile was drawn instead
+        uint64_t evictions{ 0 };
+        std::size_t residentTiles{ 0 };
+        std::size_t memoryUsage{ 0 };
+        std::size_t memoryBudget{ 0 };
+    };
+
+    /*! The textures of the tiles of all virtual textures share one memory
+     *  budget, in bytes. When it is exceeded, the least recently used tiles
+     *  are evicted at the end of a texture's usage.
+     */
+    static void setTileMemoryBudget(std::size_t budget);
+    static TileCacheStats getTileCacheStats();
+
+    /*! Start a new frame: tile textures are created within a time budget
+     *  per frame that is shared by all virtual textures.
+     */
+    static void beginFrame();
 
  private:
+    class TileCache;
+    static TileCache& tileCache();
+
+    struct Tile;
+    struct CacheEntry
+    {
+        VirtualTexture* texture;
+        Tile* tile;
+    };
+    // Resident tiles, least recently used first
+    using TileLruList = std::list<CacheEntry>;
+
     struct Tile
     {
         Tile() = default;
         unsigned int lastUsed{ 0 };
+        TileLruList::iterator lruPos;   // valid while the texture is resident
+        std::size_t memoryUsage{ 0 };
+        uint64_t packOffset{ 0 };
+        uint32_t packSize{ 0 };
         ImageTexture* tex{ nullptr };
         bool loadFailed{ false };
+        bool loadPending{ false };
+    };
+
+    // A tile whose image is being decoded in the background
+    struct PendingTile
+    {
+        Tile* tile;
+        unsigned int lod;
+        ImageDecoder::RequestPtr request;
+    };
+
+    struct PrefetchRequest
+    {
+        Tile* tile;
+        unsigned int lod;
+        unsigned int u;
+        unsigned int v;
     };
 
     struct TileQuadtreeNode
@@ -50,9 +117,18 @@ class VirtualTexture : public Texture
     };
 
     void populateTileTree();
+    void populateTileTreeFromPack();
     void addTileToTree(Tile* tile, unsigned int lod, unsigned int u, unsigned int v);
     void makeResident(Tile* tile, unsigned int lod, unsigned int u, unsigned int v);
-    ImageTexture* loadTileTexture(unsigned int lod, unsigned int u, unsigned int v);
+    void requestTile(Tile* tile, unsigned int lod, unsigned int u, unsigned int v,
+                     ImageDecoder::Priority priority);
+    void uploadTiles();
+    void finishTile(Tile* tile, unsigned int lod, Image* img);
+    std::string tileFileName(unsigned int lod, unsigned int u, unsigned int v) const;
+    Image* loadTileImage(const Tile* tile, unsigned int lod, unsigned int u, unsigned int v) const;
+    ImageTexture* createTileTexture(Image& img, unsigned int lod);
+    void useTile(Tile* tile);
+    void evictTile(Tile* tile);
 
     Tile* tiles{ nullptr };
     Tile* findTile(unsigned int lod,
@@ -62,11 +138,15 @@ class VirtualTexture : public Texture
     std::string tilePath;
     std::string tileExt;
     std::string tilePrefix;
+    ContentType tileType{ Content_Unknown };
+    std::unique_ptr<TilePack> tilePack;
     unsigned int baseSplit{ 0 };
     unsigned int tileSize{ 0 };
     unsigned int ticks{ 0 };
     unsigned int tilesRequested{ 0 };
     unsigned int nResolutionLevels{ 0 };
+    std::vector<PendingTile> pendingTiles;
+    std::vector<PrefetchRequest> prefetchRequests;
 
     enum {
         TileNotLoaded  = -1,
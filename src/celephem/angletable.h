@@ -0,0 +1,115 @@
+// angletable.h
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Tabulation and interpolation of slowly varying angles.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+
+/*! AngleTable evaluates a function returning N smoothly varying values
+ *  on a regular grid and interpolates between the grid points with four
+ *  point Lagrange polynomials. The grid is computed in blocks the first
+ *  time a time within a block is requested, so only the span of time that
+ *  is actually in use is ever tabulated. Blocks are kept in a direct mapped
+ *  cache large enough to hold a contiguous span of nBlocks blocks.
+ *
+ *  The interpolation error is roughly 0.023 A (2 pi step / P)^4 for a
+ *  periodic term of amplitude A and period P. Times too far from the
+ *  origin to be indexed are evaluated directly. The table may be used
+ *  from several threads at once.
+ */
+template<unsigned int N> class AngleTable
+{
+ public:
+    using Values = std::array<double, N>;
+    using Function = Values (*)(double);
+
+    AngleTable(Function _f, double _step, unsigned int nBlocks) :
+        f(_f),
+        step(_step),
+        blocks(nBlocks)
+    {
+    }
+
+    Values get(double t) const
+    {
+        double x = t / step;
+        if (!(std::abs(x) < MaxIndex))
+            return f(t);
+
+        double k = std::floor(x);
+        double u = x - k;
+        int64_t index = (int64_t) k;
+        int64_t blockIndex = (index >= 0 ? index : index - BlockSize + 1) / BlockSize;
+        unsigned int first = (unsigned int) (index - blockIndex * BlockSize);
+
+        Values nodes[4];
+        Block& block = blocks[(uint64_t) blockIndex % blocks.size()];
+        bool found;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            found = block.index == blockIndex;
+            if (found)
+            {
+                for (unsigned int i = 0; i < 4; i++)
+                    nodes[i] = block.nodes[first + i];
+            }
+        }
+
+        if (!found)
+        {
+            // The block holds the grid points from one before its start
+            // to two after its end, so that every interval within it has
+            // the four points needed for interpolation.
+            std::vector<Values> values(BlockSize + 3);
+            for (unsigned int i = 0; i < BlockSize + 3; i++)
+                values[i] = f((double) (blockIndex * BlockSize + i - 1) * step);
+            for (unsigned int i = 0; i < 4; i++)
+                nodes[i] = values[first + i];
+
+            std::lock_guard<std::mutex> lock(mutex);
+            block.index = blockIndex;
+            block.nodes.swap(values);
+        }
+
+        // Lagrange weights for the points at -1, 0, 1 and 2
+        double w0 = -u * (u - 1.0) * (u - 2.0) / 6.0;
+        double w1 = (u + 1.0) * (u - 1.0) * (u - 2.0) / 2.0;
+        double w2 = -(u + 1.0) * u * (u - 2.0) / 2.0;
+        double w3 = (u + 1.0) * u * (u - 1.0) / 6.0;
+
+        Values result;
+        for (unsigned int i = 0; i < N; i++)
+            result[i] = w0 * nodes[0][i] + w1 * nodes[1][i] + w2 * nodes[2][i] + w3 * nodes[3][i];
+
+        return result;
+    }
+
+ private:
+    static constexpr const unsigned int BlockSize = 32;
+    static constexpr const double MaxIndex = 1.0e15;
+
+    struct Block
+    {
+        int64_t index{ std::numeric_limits<int64_t>::min() };
+        std::vector<Values> nodes;
+    };
+
+    Function f;
+    double step;
+    mutable std::vector<Block> blocks;
+    mutable std::mutex mutex;
+};
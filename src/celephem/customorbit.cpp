@@ -2537,7 +2537,7 @@ class PhoebeOrbit : public CachingOrbit
 };
 
 
-class UranianSatelliteOrbit : public CachingOrbit
+class UranianSatelliteOrbit : public AnalyticStateOrbit
 {
  private:
     double a;
@@ -2635,6 +2635,88 @@ class UranianSatelliteOrbit : public CachingOrbit
                       YRotation(p - theta)).toRotationMatrix();
         return R * Vector3d(x, 0, z);
     }
+
+    // Same computation as computePosition, with the derivatives of all the
+    // series and of the element to position conversion carried along.
+    void computeState(double jd, Vector3d& position, Vector3d& velocity) const override
+    {
+        double t = jd - 2444239.5;
+        int i;
+
+        double L = L0 + L1 * t;
+        double dL = L1;
+        for (i = 0; i < LTerms; i++)
+        {
+            double w = L_theta[i] * t + L_phi[i];
+            L += L_k[i] * sin(w);
+            dL += L_k[i] * L_theta[i] * cos(w);
+        }
+
+        double a0 = 0.0, da0 = 0.0;
+        double a1 = 0.0, da1 = 0.0;
+        for (i = 0; i < zTerms; i++)
+        {
+            double w = z_theta[i] * t + z_phi[i];
+            a0 += z_k[i] * cos(w);
+            a1 += z_k[i] * sin(w);
+            da0 -= z_k[i] * z_theta[i] * sin(w);
+            da1 += z_k[i] * z_theta[i] * cos(w);
+        }
+
+        double b0 = 0.0, db0 = 0.0;
+        double b1 = 0.0, db1 = 0.0;
+        for (i = 0; i < zetaTerms; i++)
+        {
+            double w = zeta_theta[i] * t + zeta_phi[i];
+            b0 += zeta_k[i] * cos(w);
+            b1 += zeta_k[i] * sin(w);
+            db0 -= zeta_k[i] * zeta_theta[i] * sin(w);
+            db1 += zeta_k[i] * zeta_theta[i] * cos(w);
+        }
+
+        double e2 = square(a0) + square(a1);
+        double e = sqrt(e2);
+        double de = e > 0.0 ? (a0 * da0 + a1 * da1) / e : 0.0;
+        double p = atan2(a1, a0);
+        double dp = e2 > 0.0 ? (a0 * da1 - a1 * da0) / e2 : 0.0;
+
+        double s2 = square(b0) + square(b1);
+        double s = sqrt(s2);
+        double gamma = 2.0 * asin(s);
+        double dgamma = s > 0.0 ? 2.0 * (b0 * db0 + b1 * db1) / (s * sqrt(1.0 - s2)) : 0.0;
+        double theta = atan2(b1, b0);
+        double dtheta = s2 > 0.0 ? (b0 * db1 - b1 * db0) / s2 : 0.0;
+
+        L += degToRad(174.99);
+
+        double M = L - p;
+        double dM = dL - dp;
+
+        double ecc = M;
+        for (i = 0; i < 4; i++)
+            ecc = M + e * sin(ecc);
+        double decc = (dM + de * sin(ecc)) / (1.0 - e * cos(ecc));
+
+        double q = sqrt(1 - square(e));
+        Vector3d r(a * (cos(ecc) - e), 0, a * q * -sin(ecc));
+        Vector3d dr(a * (-sin(ecc) * decc - de),
+                    0,
+                    -a * (q * cos(ecc) * decc - e * de / q * sin(ecc)));
+
+        // Differentiate the rotation R = A * B * C one factor at a time;
+        // the derivative of a rotation about axis u by angle w is
+        // dw/dt * (u x R).
+        Matrix3d A = YRotation(theta).toRotationMatrix();
+        Matrix3d B = XRotation(gamma).toRotationMatrix();
+        Matrix3d C = YRotation(p - theta).toRotationMatrix();
+        Vector3d Cr = C * r;
+        Vector3d BCr = B * Cr;
+        position = A * BCr;
+        velocity = A * (B * (C * dr)) +
+                   dtheta * Vector3d::UnitY().cross(position) +
+                   dgamma * (A * Vector3d::UnitX().cross(BCr)) +
+                   (dp - dtheta) * (A * (B * Vector3d::UnitY().cross(Cr)));
+    }
 };
 
 
@@ -2980,7 +3062,7 @@ static const HTC20Angles CalypsoAngles =
     3.25074880
 };
 
-class HTC20Orbit : public CachingOrbit
+class HTC20Orbit : public AnalyticStateOrbit
 {
  public:
     HTC20Orbit(int _nTerms, const double* _args, const double* _amplitudes,
@@ -3018,6 +3100,46 @@ class HTC20Orbit : public CachingOrbit
         return Vector3d(pos.x(), pos.z(), -pos.y())  * astro::AUtoKilometers(1.0);
     }
 
+    void computeState(double jd, Vector3d& position, Vector3d& velocity) const override
+    {
+        double t = jd - astro::J2000 - (4156.0 / 86400.0);
+        Vector3d pos(0.0, 0.0, 0.0);
+        Vector3d vel(0.0, 0.0, 0.0);
+
+        for (int i = 0; i < nTerms; i++)
+        {
+            const double* row = args + i * 5;
+            double ang = (row[1] * (angles.nu1 * t + angles.phi1) +
+                          row[2] * (angles.nu2 * t + angles.phi2) +
+                          row[3] * (angles.nu3 * t + angles.phi3) +
+                          row[4] * (angles.lambda * t + angles.theta));
+            double dang = (row[1] * angles.nu1 +
+                           row[2] * angles.nu2 +
+                           row[3] * angles.nu3 +
+                           row[4] * angles.lambda);
+
+            double u, du;
+            if (row[0] == 0.0)
+            {
+                u = cos(ang);
+                du = -sin(ang) * dang;
+            }
+            else
+            {
+                u = sin(ang);
+                du = cos(ang) * dang;
+            }
+
+            Vector3d amp(amplitudes[i * 6], amplitudes[i * 6 + 1], amplitudes[i * 6 + 2]);
+            pos += amp * u;
+            vel += amp * du;
+        }
+
+        // Convert to Celestia's coordinate system
+        position = Vector3d(pos.x(), pos.z(), -pos.y()) * astro::AUtoKilometers(1.0);
+        velocity = Vector3d(vel.x(), vel.z(), -vel.y()) * astro::AUtoKilometers(1.0);
+    }
+
     double getPeriod() const override
     {
         return period;
@@ -137,8 +137,8 @@ public:
         else if (T > P03LP_VALID_CENTURIES)
             T = P03LP_VALID_CENTURIES;
 
-        astro::PrecessionAngles prec = astro::PrecObliquity_P03LP(T);
-        astro::EclipticPole pole = astro::EclipticPrecession_P03LP(T);
+        astro::PrecessionAngles prec = astro::TabulatedPrecObliquity_P03LP(T);
+        astro::EclipticPole pole = astro::TabulatedEclipticPrecession_P03LP(T);
 
         double obliquity = degToRad(prec.epsA / 3600);
         double precession = degToRad(prec.pA / 3600);
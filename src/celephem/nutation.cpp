@@ -13,6 +13,7 @@
 #include <cmath>
 #include <iostream>
 #include <celmath/mathlib.h>
+#include "angletable.h"
 #include "nutation.h"
 
 using namespace std;
@@ -234,6 +235,34 @@ astro::Nutation_IAU2000B(double T)
 }
 
 
+// The shortest period terms in the series are close to five days. Blocks
+// hold 32 days, so the cache covers a little over five years.
+static const double NutationTableStep = 1.0 / 36525.0;
+static const unsigned int NutationTableBlocks = 64;
+
+static AngleTable<2>::Values
+computeNutation_IAU2000B(double T)
+{
+    astro::NutationAngles nutation = astro::Nutation_IAU2000B(T);
+    return {{ nutation.obliquity, nutation.longitude }};
+}
+
+static AngleTable<2> NutationTable(computeNutation_IAU2000B,
+                                   NutationTableStep,
+                                   NutationTableBlocks);
+
+
+astro::NutationAngles
+astro::TabulatedNutation_IAU2000B(double T)
+{
+    AngleTable<2>::Values values = NutationTable.get(T);
+    NutationAngles nutation;
+    nutation.obliquity = values[0];
+    nutation.longitude = values[1];
+    return nutation;
+}
+
+
 #ifdef TEST
 
 using namespace astro;
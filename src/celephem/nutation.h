@@ -22,4 +22,10 @@ struct NutationAngles
 
 extern NutationAngles Nutation_IAU2000B(double T);
 
+// Tabulated version of Nutation_IAU2000B, interpolated from values computed
+// once a day. The result differs from the direct evaluation by less than
+// 1.0e-8 radians (2 milliarcseconds.) The table only saves time when many
+// evaluations fall within a span of a few months.
+extern NutationAngles TabulatedNutation_IAU2000B(double T);
+
 };
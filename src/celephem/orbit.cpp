@@ -25,7 +25,7 @@ using namespace celmath;
 
 // Orbital velocity is computed by differentiation for orbits that don't
 // override velocityAtTime().
-static const double ORBITAL_VELOCITY_DIFF_DELTA = 1.0 / 1440.0;
+const double Orbit::VelocityDiffDelta = 1.0 / 1440.0;
 
 
 static Vector3d cubicInterpolate(const Vector3d& p0, const Vector3d& v0,
@@ -52,6 +52,15 @@ static Vector3d cubicInterpolate(const Vector3d& p0, const Vector3d& v0,
   * time span for aperiodic trajectories.
   */
 void Orbit::sample(double startTime, double endTime, OrbitSampleProc& proc) const
+{
+    adaptiveSample(startTime, endTime, proc, getSamplingParameters(startTime, endTime));
+}
+
+
+/** Return the default adaptive sampling parameters for sampling the orbit
+  * over the time range [ startTime, endTime ].
+  */
+Orbit::AdaptiveSamplingParameters Orbit::getSamplingParameters(double startTime, double endTime) const
 {
     double span = 0.0;
     if (isPeriodic())
@@ -63,10 +72,17 @@ void Orbit::sample(double startTime, double endTime, OrbitSampleProc& proc) cons
         double startValidInterval = 0.0;
         double endValidInterval = 0.0;
         getValidRange(startValidInterval, endValidInterval);
-        if (startValidInterval == endValidInterval)
+        if (startValidInterval != endValidInterval)
         {
             span = endValidInterval - startValidInterval;
         }
+        else if (getPeriod() > 0.0)
+        {
+            // Unbounded trajectories are drawn over a window of one
+            // 'period'; use it so that the parameters don't depend on the
+            // part of the window being sampled.
+            span = getPeriod();
+        }
         else
         {
             span = endTime - startTime;
@@ -79,7 +95,7 @@ void Orbit::sample(double startTime, double endTime, OrbitSampleProc& proc) cons
     samplingParams.minStep = span / 1.0e7;
     samplingParams.startStep = span / 1.0e5;
 
-    adaptiveSample(startTime, endTime, proc, samplingParams);
+    return samplingParams;
 }
 
 
@@ -90,12 +106,14 @@ void Orbit::adaptiveSample(double startTime, double endTime, OrbitSampleProc& pr
     double startStepSize = samplingParams.startStep;
     double maxStepSize   = samplingParams.maxStep;
     double minStepSize   = samplingParams.minStep;
+    if (proc.startStep() > 0.0)
+        startStepSize = max(minStepSize, min(proc.startStep(), maxStepSize));
     double tolerance     = samplingParams.tolerance;
     double t = startTime;
     const double stepFactor = 1.25;
 
-    Vector3d lastP = positionAtTime(t);
-    Vector3d lastV = velocityAtTime(t);
+    Vector3d lastP, lastV;
+    stateAtTime(t, lastP, lastV);
     proc.sample(t, lastP, lastV);
     int sampCount = 0;
     int nTests = 0;
@@ -106,8 +124,8 @@ void Orbit::adaptiveSample(double startTime, double endTime, OrbitSampleProc& pr
         maxStepSize = min(maxStepSize, endTime - t);
         double dt = min(maxStepSize, startStepSize * 2.0);
 
-        Vector3d p1 = positionAtTime(t + dt);
-        Vector3d v1 = velocityAtTime(t + dt);
+        Vector3d p1, v1;
+        stateAtTime(t + dt, p1, v1);
 
         double tmid = t + dt / 2.0;
         Vector3d pTest = positionAtTime(tmid);
@@ -126,8 +144,7 @@ void Orbit::adaptiveSample(double startTime, double endTime, OrbitSampleProc& pr
             {
                 dt /= stepFactor;
 
-                p1 = positionAtTime(t + dt);
-                v1 = velocityAtTime(t + dt);
+                stateAtTime(t + dt, p1, v1);
 
                 tmid = t + dt / 2.0;
                 pTest = positionAtTime(tmid);
@@ -147,8 +164,7 @@ void Orbit::adaptiveSample(double startTime, double endTime, OrbitSampleProc& pr
             {
                 dt *= stepFactor;
 
-                p1 = positionAtTime(t + dt);
-                v1 = velocityAtTime(t + dt);
+                stateAtTime(t + dt, p1, v1);
 
                 tmid = t + dt / 2.0;
                 pTest = positionAtTime(tmid);
@@ -165,6 +181,10 @@ void Orbit::adaptiveSample(double startTime, double endTime, OrbitSampleProc& pr
         lastP = p1;
         lastV = v1;
 
+        // Start the search for the next step from this one rather than
+        // from the initial step; the step changes slowly along the orbit.
+        startStepSize = dt;
+
         proc.sample(t, lastP, lastV);
         sampCount++;
     }
@@ -273,8 +293,15 @@ typedef pair<double, double> Solution;
 Vector3d Orbit::velocityAtTime(double tdb) const
 {
     Vector3d p0 = positionAtTime(tdb);
-    Vector3d p1 = positionAtTime(tdb + ORBITAL_VELOCITY_DIFF_DELTA);
-    return (p1 - p0) * (1.0 / ORBITAL_VELOCITY_DIFF_DELTA);
+    Vector3d p1 = positionAtTime(tdb + VelocityDiffDelta);
+    return (p1 - p0) * (1.0 / VelocityDiffDelta);
+}
+
+
+void Orbit::stateAtTime(double tdb, Vector3d& position, Vector3d& velocity) const
+{
+    position = positionAtTime(tdb);
+    velocity = velocityAtTime(tdb);
 }
 
 
@@ -318,10 +345,13 @@ double EllipticalOrbit::eccentricAnomaly(double M) const
     }
     else
     {
-        // Laguerre-Conway method for hyperbolic (ecc > 1) orbits.
-        double E = log(2 * M / eccentricity + 1.85);
-        Solution sol = solve_iteration_fixed(SolveKeplerLaguerreConwayHyp(eccentricity, M), E, 30);
-        return sol.first;
+        // Laguerre-Conway method for hyperbolic (ecc > 1) orbits. Kepler's
+        // equation is odd in M, and the starting value only works for
+        // positive M.
+        double absM = abs(M);
+        double E = log(2 * absM / eccentricity + 1.85);
+        Solution sol = solve_iteration_fixed(SolveKeplerLaguerreConwayHyp(eccentricity, absM), E, 30);
+        return M < 0.0 ? -sol.first : sol.first;
     }
 }
 
@@ -380,8 +410,11 @@ Vector3d EllipticalOrbit::velocityAtE(double E) const
     else if (eccentricity > 1.0)
     {
         double a = pericenterDistance / (1.0 - eccentricity);
-        x = -a * (eccentricity - cosh(E));
-        y = -a * sqrt(square(eccentricity) - 1) * sinh(E);
+        double meanMotion = 2.0 * PI / period;
+        double edot = meanMotion / (eccentricity * cosh(E) - 1);
+
+        x = a * sinh(E) * edot;
+        y = -a * sqrt(square(eccentricity) - 1) * cosh(E) * edot;
     }
     else
     {
@@ -435,39 +468,46 @@ double EllipticalOrbit::getBoundingRadius() const
 
 Vector3d CachingOrbit::positionAtTime(double jd) const
 {
-    if (jd != lastTime)
-    {
-        lastTime = jd;
-        lastPosition = computePosition(jd);
-        positionCacheValid = true;
-        velocityCacheValid = false;
-    }
-    else if (!positionCacheValid)
-    {
-        lastPosition = computePosition(jd);
-        positionCacheValid = true;
-    }
-
-    return lastPosition;
+    return positionCache.get(jd, [this](double t) { return computePosition(t); });
 }
 
 
 Vector3d CachingOrbit::velocityAtTime(double jd) const
 {
-    if (jd != lastTime)
-    {
-        lastVelocity = computeVelocity(jd);
-        lastTime = jd;  // must be set *after* call to computeVelocity
-        positionCacheValid = false;
-        velocityCacheValid = true;
-    }
-    else if (!velocityCacheValid)
+    return velocityCache.get(jd, [this](double t) { return computeVelocity(t); });
+}
+
+
+/*! Return position and velocity, evaluating the orbit at most once when
+ *  neither is cached and the orbit implements computeState(). Queries for
+ *  only one of them use positionAtTime() or velocityAtTime() instead.
+ */
+void CachingOrbit::stateAtTime(double jd, Vector3d& position, Vector3d& velocity) const
+{
+    bool computed = false;
+    velocity = velocityCache.get(jd, [this, &position, &computed](double t)
     {
-        lastVelocity = computeVelocity(jd);
-        velocityCacheValid = true;
-    }
+        Vector3d v;
+        computeState(t, position, v);
+        computed = true;
+        return v;
+    });
+
+    if (computed)
+        positionCache.insert(jd, position);
+    else
+        position = positionAtTime(jd);
+}
 
-    return lastVelocity;
+
+/*! Return the combined hit and miss counts of the position and velocity
+ *  caches.
+ */
+TimeCacheStatistics CachingOrbit::getCacheStatistics() const
+{
+    TimeCacheStatistics stats = positionCache.getStatistics();
+    stats += velocityCache.getStatistics();
+    return stats;
 }
 
 
@@ -484,9 +524,152 @@ Vector3d CachingOrbit::computeVelocity(double jd) const
     // don't affect the cached value.
     // TODO: check the valid ranges of the orbit to make sure that
     // jd+dt is still in range.
-    Vector3d p1 = computePosition(jd + ORBITAL_VELOCITY_DIFF_DELTA);
+    Vector3d p1 = computePosition(jd + VelocityDiffDelta);
+
+    return (p1 - p0) * (1.0 / VelocityDiffDelta);
+}
+
+
+/*! Calculate both position and velocity at the specified time. Orbit
+ *  theories that get the velocity as a by-product of the position, such
+ *  as analytic derivatives of series, should override this and
+ *  computeVelocity(). The default implementation uses the cached position
+ *  and computeVelocity().
+ */
+void CachingOrbit::computeState(double jd, Vector3d& position, Vector3d& velocity) const
+{
+    position = positionAtTime(jd);
+    velocity = computeVelocity(jd);
+}
+
+
+Vector3d AnalyticStateOrbit::computeVelocity(double jd) const
+{
+    Vector3d position, velocity;
+    computeState(jd, position, velocity);
+    return velocity;
+}
 
-    return (p1 - p0) * (1.0 / ORBITAL_VELOCITY_DIFF_DELTA);
+
+/*! Compute the positions at count times. Orbits that are much cheaper
+ *  to evaluate many times at once, such as orbits implemented by scripts,
+ *  should override this. The default implementation calls computePosition()
+ *  for each time. Returns false if the positions could not be computed.
+ */
+bool CachingOrbit::computePositions(const double* jd, Vector3d* positions, size_t count) const
+{
+    for (size_t i = 0; i < count; i++)
+        positions[i] = computePosition(jd[i]);
+
+    return true;
+}
+
+
+/*! Sample the orbit with the same tolerance as adaptiveSample(), but with
+ *  all positions requested through computePositions() in a few large
+ *  batches: the range is first sampled uniformly at the maximum step, then
+ *  all intervals whose midpoint deviates from the interpolated curve by
+ *  more than the tolerance are split at the same time, until no interval
+ *  needs splitting. No samples are passed to proc if computePositions()
+ *  fails, so the caller can fall back to adaptiveSample().
+ */
+bool CachingOrbit::batchSample(double startTime, double endTime, OrbitSampleProc& proc, const AdaptiveSamplingParameters& samplingParams) const
+{
+    // Limit the number of samples, which could otherwise grow up to the
+    // span divided by the minimum step for orbits that are not smooth.
+    const size_t MaxSamples = 100000;
+
+    struct StateSample
+    {
+        double t;
+        Vector3d position;
+        Vector3d velocity;
+    };
+
+    if (!(endTime > startTime) || !(samplingParams.maxStep > 0.0))
+        return false;
+
+    double n = ceil((endTime - startTime) / samplingParams.maxStep);
+    if (n > (double) MaxSamples)
+        return false;
+
+    // Velocities are computed by differentiation, from the positions at
+    // t and t + VelocityDiffDelta that are evaluated together.
+    auto computeStates = [this](const vector<double>& t, vector<StateSample>& states)
+    {
+        size_t count = t.size();
+        vector<double> times(2 * count);
+        vector<Vector3d> positions(2 * count);
+        for (size_t i = 0; i < count; i++)
+        {
+            times[2 * i] = t[i];
+            times[2 * i + 1] = t[i] + VelocityDiffDelta;
+        }
+
+        if (!computePositions(times.data(), positions.data(), times.size()))
+            return false;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            StateSample s;
+            s.t = t[i];
+            s.position = positions[2 * i];
+            s.velocity = (positions[2 * i + 1] - positions[2 * i]) * (1.0 / VelocityDiffDelta);
+            states.push_back(s);
+        }
+
+        return true;
+    };
+
+    vector<double> times;
+    for (size_t i = 0; i <= (size_t) n; i++)
+        times.push_back(startTime + (endTime - startTime) * (double) i / n);
+
+    vector<StateSample> samples;
+    if (!computeStates(times, samples))
+        return false;
+
+    vector<pair<size_t, size_t>> intervals;
+    for (size_t i = 0; i + 1 < samples.size(); i++)
+        intervals.emplace_back(i, i + 1);
+
+    while (!intervals.empty() && samples.size() < MaxSamples)
+    {
+        times.clear();
+        for (const auto& interval : intervals)
+            times.push_back(0.5 * (samples[interval.first].t + samples[interval.second].t));
+
+        vector<StateSample> midpoints;
+        if (!computeStates(times, midpoints))
+            return false;
+
+        vector<pair<size_t, size_t>> split;
+        for (size_t i = 0; i < intervals.size(); i++)
+        {
+            const StateSample& s0 = samples[intervals[i].first];
+            const StateSample& s1 = samples[intervals[i].second];
+            double dt = s1.t - s0.t;
+            Vector3d pInterp = cubicInterpolate(s0.position, s0.velocity * dt,
+                                                s1.position, s1.velocity * dt,
+                                                0.5);
+            if ((pInterp - midpoints[i].position).norm() > samplingParams.tolerance &&
+                dt > samplingParams.minStep)
+            {
+                size_t mid = samples.size();
+                samples.push_back(midpoints[i]);
+                split.emplace_back(intervals[i].first, mid);
+                split.emplace_back(mid, intervals[i].second);
+            }
+        }
+        intervals.swap(split);
+    }
+
+    sort(samples.begin(), samples.end(),
+         [](const StateSample& s0, const StateSample& s1) { return s0.t < s1.t; });
+    for (const auto& s : samples)
+        proc.sample(s.t, s.position, s.velocity);
+
+    return true;
 }
 
 
@@ -496,13 +679,8 @@ static EllipticalOrbit* StateVectorToOrbit(const Vector3d& position,
                                            double t)
 {
     Vector3d R = position;
-    Vector3d L = R.cross(v);
     double magR = R.norm();
-    double magL = L.norm();
     double magV = v.norm();
-    L *= (1.0 / magL);
-
-    Vector3d W = L.cross(R / magR);
 
     double G = astro::G * 1e-9; // convert from meters to kilometers
     double GM = G * mass;
@@ -511,7 +689,6 @@ static EllipticalOrbit* StateVectorToOrbit(const Vector3d& position,
     double a = 1.0 / (2.0 / magR - square(magV) / GM);
 
     // Compute the eccentricity
-    double p = square(magL) / GM;
     double q = R.dot(v);
     double ex = 1.0 - magR / a;
     double ey = q / sqrt(a * GM);
@@ -521,24 +698,24 @@ static EllipticalOrbit* StateVectorToOrbit(const Vector3d& position,
     double E = atan2(ey, ex);
     double M = E - e * sin(E);
 
+    // The orientation is computed in the ecliptic coordinates of the
+    // elements, converting back from Celestia's coordinate system.
+    Vector3d r(R.x(), -R.z(), R.y());
+    Vector3d vel(v.x(), -v.z(), v.y());
+    Vector3d h = r.cross(vel).normalized();
+
     // Compute the inclination
-    double cosi = L.dot(Vector3d::UnitY());
-    double i = 0.0;
-    if (cosi < 1.0)
-        i = acos(cosi);
+    double i = acos(max(-1.0, min(1.0, h.z())));
 
     // Compute the longitude of ascending node
-    double Om = atan2(L.x(), L.z());
-
-    // Compute the argument of pericenter
-    Vector3d U = R / magR;
-    double s_nu = (v.dot(U)) * sqrt(p / GM);
-    double c_nu = (v.dot(W)) * sqrt(p / GM) - 1;
-    s_nu /= e;
-    c_nu /= e;
-    Vector3d P = U * c_nu - W * s_nu;
-    Vector3d Q = U * s_nu + W * c_nu;
-    double om = atan2(P.y(), Q.y());
+    double Om = atan2(h.x(), -h.y());
+
+    // Compute the argument of pericenter, as the angle from the ascending
+    // node to the eccentricity vector. Measuring it from the node given by
+    // Om keeps it valid for orbits in the ecliptic, which have no node.
+    Vector3d node(cos(Om), sin(Om), 0.0);
+    Vector3d eccentricity = vel.cross(r.cross(vel)) / GM - r / magR;
+    double om = atan2(h.dot(node.cross(eccentricity)), node.dot(eccentricity));
 
     // Compute the period
     double T = 2 * PI * sqrt(cube(a) / GM);
@@ -604,6 +781,17 @@ Vector3d MixedOrbit::velocityAtTime(double jd) const
 }
 
 
+void MixedOrbit::stateAtTime(double jd, Vector3d& position, Vector3d& velocity) const
+{
+    if (jd < begin)
+        beforeApprox->stateAtTime(jd, position, velocity);
+    else if (jd < end)
+        primary->stateAtTime(jd, position, velocity);
+    else
+        afterApprox->stateAtTime(jd, position, velocity);
+}
+
+
 double MixedOrbit::getPeriod() const
 {
     return primary->getPeriod();
@@ -10,11 +10,21 @@
 #ifndef _CELENGINE_ORBIT_H_
 #define _CELENGINE_ORBIT_H_
 
+#include <celutil/timecache.h>
+#include <cstddef>
 #include <Eigen/Core>
 
 
 class OrbitSampleProc;
 
+/*! Orbits are immutable once loaded. All const methods may be called from
+ *  several threads at once and return the same results as when called
+ *  from a single thread. Implementations that keep state between calls
+ *  (caches, the last sample found, decoded data) must protect it, either
+ *  with a TimeCache, a lock, or an atomic value that is only used as a
+ *  hint. Orbits evaluated by a script serialize on the scripted object
+ *  lock, and SPICE orbits on the SPICE lock.
+ */
 class Orbit
 {
  public:
@@ -32,6 +42,14 @@ class Orbit
      */
     virtual Eigen::Vector3d velocityAtTime(double) const;
 
+    /*! Return both position and velocity at the specified time. Orbits that
+     * can compute both in a single evaluation override this; the default
+     * implementation calls positionAtTime() and velocityAtTime().
+     */
+    virtual void stateAtTime(double jd,
+                             Eigen::Vector3d& position,
+                             Eigen::Vector3d& velocity) const;
+
     virtual double getPeriod() const = 0;
     virtual double getBoundingRadius() const = 0;
 
@@ -44,6 +62,9 @@ class Orbit
     virtual void getValidRange(double& begin, double& end) const
         { begin = 0.0; end = 0.0; };
 
+    //! Time step in days used to differentiate position into velocity
+    static const double VelocityDiffDelta;
+
     struct AdaptiveSamplingParameters
     {
         double tolerance;
@@ -52,6 +73,7 @@ class Orbit
         double maxStep;
     };
 
+    AdaptiveSamplingParameters getSamplingParameters(double startTime, double endTime) const;
     void adaptiveSample(double startTime, double endTime, OrbitSampleProc& proc, const AdaptiveSamplingParameters& samplingParams) const;
 };
 
@@ -93,16 +115,26 @@ class OrbitSampleProc
     virtual ~OrbitSampleProc() = default;
 
     virtual void sample(double t, const Eigen::Vector3d& position, const Eigen::Vector3d& velocity) = 0;
+
+    /*! Return the step with which adaptive sampling should start, or zero
+     *  to use the default for the orbit. A proc extending a path that is
+     *  already sampled returns the spacing of the samples at the end being
+     *  extended, so that the sampler doesn't have to grow its step again
+     *  from the small default.
+     */
+    virtual double startStep() const { return 0.0; }
 };
 
 
 
 /*! Custom orbit classes should be derived from CachingOrbit.  The custom
  * orbits can be expensive to compute, with more than 50 periodic terms.
- * Celestia may need require position of a planet more than once per frame; in
- * order to avoid redundant calculation, the CachingOrbit class saves the
- * result of the last calculation and uses it if the time matches the cached
- * time.
+ * Celestia may need require position of a planet more than once per frame,
+ * often at a few different times (several views, light time correction,
+ * velocity differentiation.) In order to avoid redundant calculation, the
+ * CachingOrbit class saves the results of the last few calculations and
+ * reuses them if the time matches one of the cached times. The caches may
+ * be used from several threads at once.
  */
 class CachingOrbit : public Orbit
 {
@@ -112,18 +144,43 @@ class CachingOrbit : public Orbit
 
     virtual Eigen::Vector3d computePosition(double jd) const = 0;
     virtual Eigen::Vector3d computeVelocity(double jd) const;
+    virtual void computeState(double jd,
+                              Eigen::Vector3d& position,
+                              Eigen::Vector3d& velocity) const;
+    virtual bool computePositions(const double* jd,
+                                  Eigen::Vector3d* positions,
+                                  std::size_t count) const;
     virtual double getPeriod() const = 0;
     virtual double getBoundingRadius() const = 0;
 
     Eigen::Vector3d positionAtTime(double jd) const;
     Eigen::Vector3d velocityAtTime(double jd) const;
+    void stateAtTime(double jd,
+                     Eigen::Vector3d& position,
+                     Eigen::Vector3d& velocity) const;
+
+    TimeCacheStatistics getCacheStatistics() const;
+
+ protected:
+    bool batchSample(double startTime, double endTime, OrbitSampleProc& proc, const AdaptiveSamplingParameters& samplingParams) const;
 
  private:
-    mutable Eigen::Vector3d lastPosition;
-    mutable Eigen::Vector3d lastVelocity;
-    mutable double lastTime{ -1.0e30 };
-    mutable bool positionCacheValid{ false };
-    mutable bool velocityCacheValid{ false };
+    TimeCache<Eigen::Vector3d> positionCache;
+    TimeCache<Eigen::Vector3d> velocityCache;
+};
+
+
+/*! Base class for caching orbits whose computeState() evaluates the
+ *  velocity analytically along with the position. Such orbits override
+ *  computeState() only; the velocity alone is taken from it.
+ */
+class AnalyticStateOrbit : public CachingOrbit
+{
+ public:
+    virtual Eigen::Vector3d computeVelocity(double jd) const;
+    virtual void computeState(double jd,
+                              Eigen::Vector3d& position,
+                              Eigen::Vector3d& velocity) const = 0;
 };
 
 
@@ -141,6 +198,9 @@ class MixedOrbit : public Orbit
 
     virtual Eigen::Vector3d positionAtTime(double jd) const;
     virtual Eigen::Vector3d velocityAtTime(double jd) const;
+    virtual void stateAtTime(double jd,
+                             Eigen::Vector3d& position,
+                             Eigen::Vector3d& velocity) const;
     virtual double getPeriod() const;
     virtual double getBoundingRadius() const;
     virtual void sample(double startTime, double endTime, OrbitSampleProc& proc) const;
@@ -13,6 +13,7 @@
 #include <cmath>
 #include <iostream>
 #include <celmath/mathlib.h>
+#include "angletable.h"
 #include "precession.h"
 
 using namespace std;
@@ -157,6 +158,46 @@ astro::PrecObliquity_P03LP(double T)
 }
 
 
+// The long period terms have periods of several hundred centuries, so a
+// grid step of a year makes the interpolation error negligible.
+static const double PrecessionTableStep = 0.01;
+static const unsigned int PrecessionTableBlocks = 16;
+
+static AngleTable<4>::Values
+computePrecession_P03LP(double T)
+{
+    astro::EclipticPole pole = astro::EclipticPrecession_P03LP(T);
+    astro::PrecessionAngles angles = astro::PrecObliquity_P03LP(T);
+    return {{ pole.PA, pole.QA, angles.pA, angles.epsA }};
+}
+
+static AngleTable<4> PrecessionTable(computePrecession_P03LP,
+                                     PrecessionTableStep,
+                                     PrecessionTableBlocks);
+
+
+astro::EclipticPole
+astro::TabulatedEclipticPrecession_P03LP(double T)
+{
+    AngleTable<4>::Values values = PrecessionTable.get(T);
+    EclipticPole pole;
+    pole.PA = values[0];
+    pole.QA = values[1];
+    return pole;
+}
+
+
+astro::PrecessionAngles
+astro::TabulatedPrecObliquity_P03LP(double T)
+{
+    AngleTable<4>::Values values = PrecessionTable.get(T);
+    PrecessionAngles angles;
+    angles.pA = values[2];
+    angles.epsA = values[3];
+    return angles;
+}
+
+
 /*! Compute equatorial precession angles z, zeta, and theta using the P03
  *  precession model.
  */
@@ -59,6 +59,13 @@ struct EquatorialPrecessionAngles
 extern EclipticPole EclipticPrecession_P03LP(double T);
 extern PrecessionAngles PrecObliquity_P03LP(double T);
 
+// Tabulated versions of the P03LP functions, for callers that evaluate
+// precession at many nearby times, for example during time lapse playback.
+// The angles are interpolated from values computed once a year, and differ
+// from the direct evaluation by less than 1.0e-6 arcseconds.
+extern EclipticPole TabulatedEclipticPrecession_P03LP(double T);
+extern PrecessionAngles TabulatedPrecObliquity_P03LP(double T);
+
 extern EclipticPole EclipticPrecession_P03(double T);
 extern EclipticAngles EclipticPrecessionAngles_P03(double T);
 extern PrecessionAngles PrecObliquity_P03(double T);
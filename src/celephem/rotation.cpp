@@ -23,16 +23,6 @@ using namespace celmath;
 
 static const double ANGULAR_VELOCITY_DIFF_DELTA = 1.0 / 1440.0;
 
-// Choose a time interval for numerically differentiating orientation
-// to get the angular velocity for a rotation model.
-static double chooseDiffTimeDelta(const RotationModel& rm)
-{
-    if (rm.isPeriodic())
-        return rm.getPeriod() / 10000.0;
-
-    return ANGULAR_VELOCITY_DIFF_DELTA;
-}
-
 /***** RotationModel *****/
 
 /*! Return the angular velocity at the specified time (TDB). The default
@@ -41,9 +31,34 @@ static double chooseDiffTimeDelta(const RotationModel& rm)
 Vector3d
 RotationModel::angularVelocityAtTime(double tdb) const
 {
-    double dt = chooseDiffTimeDelta(*this);
+    double dt = getDiffTimeDelta();
     Quaterniond q0 = orientationAtTime(tdb);
     Quaterniond q1 = orientationAtTime(tdb + dt);
+    return differentiateOrientation(q0, q1, dt);
+}
+
+
+/*! Choose a time interval for numerically differentiating orientation
+ *  to get the angular velocity for a rotation model.
+ */
+double
+RotationModel::getDiffTimeDelta() const
+{
+    if (isPeriodic())
+        return getPeriod() / 10000.0;
+
+    return ANGULAR_VELOCITY_DIFF_DELTA;
+}
+
+
+/*! Return the angular velocity of a rotation from orientation q0 to
+ *  orientation q1 in time dt.
+ */
+Vector3d
+RotationModel::differentiateOrientation(const Quaterniond& q0,
+                                        const Quaterniond& q1,
+                                        double dt)
+{
     Quaterniond dq = q1.conjugate() * q0;
 
     if (std::abs(dq.w()) > 0.99999999)
@@ -55,82 +70,44 @@ RotationModel::angularVelocityAtTime(double tdb) const
 
 /***** CachingRotationModel *****/
 
-CachingRotationModel::CachingRotationModel() :
-    lastTime(365.0),
-    spinCacheValid(false),
-    equatorCacheValid(false),
-    angularVelocityCacheValid(false)
-{
-}
-
-
 Quaterniond
 CachingRotationModel::spin(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastSpin = computeSpin(tjd);
-        spinCacheValid = true;
-        equatorCacheValid = false;
-        angularVelocityCacheValid = false;
-    }
-    else if (!spinCacheValid)
-    {
-        lastSpin = computeSpin(tjd);
-        spinCacheValid = true;
-    }
-
-    return lastSpin;
+    return spinCache.get(tjd, [this](double t) { return computeSpin(t); });
 }
 
 
 Quaterniond
 CachingRotationModel::equatorOrientationAtTime(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastEquator = computeEquatorOrientation(tjd);
-        spinCacheValid = false;
-        equatorCacheValid = true;
-        angularVelocityCacheValid = false;
-    }
-    else if (!equatorCacheValid)
-    {
-        lastEquator = computeEquatorOrientation(tjd);
-        equatorCacheValid = true;
-    }
-
-    return lastEquator;
+    return equatorCache.get(tjd, [this](double t) { return computeEquatorOrientation(t); });
 }
 
 
 Vector3d
 CachingRotationModel::angularVelocityAtTime(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        lastTime = tjd;
-        spinCacheValid = false;
-        equatorCacheValid = false;
-        angularVelocityCacheValid = true;
-    }
-    else if (!angularVelocityCacheValid)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        angularVelocityCacheValid = true;
-    }
+    return angularVelocityCache.get(tjd, [this](double t) { return computeAngularVelocity(t); });
+}
+
 
-    return lastAngularVelocity;
+/*! Return the combined hit and miss counts of the spin, equator and
+ *  angular velocity caches.
+ */
+TimeCacheStatistics
+CachingRotationModel::getCacheStatistics() const
+{
+    TimeCacheStatistics stats = spinCache.getStatistics();
+    stats += equatorCache.getStatistics();
+    stats += angularVelocityCache.getStatistics();
+    return stats;
 }
 
 
 Vector3d
 CachingRotationModel::computeAngularVelocity(double tjd) const
 {
-    double dt = chooseDiffTimeDelta(*this);
+    double dt = getDiffTimeDelta();
     Quaterniond q0 = orientationAtTime(tjd);
 
     // Call computeSpin/computeEquatorOrientation instead of orientationAtTime
@@ -138,12 +115,7 @@ CachingRotationModel::computeAngularVelocity(double tjd) const
     Quaterniond spin = computeSpin(tjd + dt);
     Quaterniond equator = computeEquatorOrientation(tjd + dt);
     Quaterniond q1 = spin * equator;
-    Quaterniond dq = q1.conjugate() * q0;
-
-    if (std::abs(dq.w()) > 0.99999999)
-        return Vector3d::Zero();
-
-    return dq.vec().normalized() * (2.0 * acos(dq.w()) / dt);
+    return differentiateOrientation(q0, q1, dt);
 }
 
 
@@ -11,11 +11,14 @@
 #ifndef _CELENGINE_ROTATION_H_
 #define _CELENGINE_ROTATION_H_
 
+#include <celutil/timecache.h>
 #include <Eigen/Geometry>
 
 
 /*! A RotationModel object describes the orientation of an object
- *  over some time range.
+ *  over some time range. Rotation models follow the same thread safety
+ *  rules as orbits: every const method may be called from several threads
+ *  at once, and any state kept between calls must be protected.
  */
 class RotationModel
 {
@@ -71,13 +74,20 @@ class RotationModel
         begin = 0.0;
         end = 0.0;
     };
+
+ protected:
+    double getDiffTimeDelta() const;
+    static Eigen::Vector3d differentiateOrientation(const Eigen::Quaterniond& q0,
+                                                    const Eigen::Quaterniond& q1,
+                                                    double dt);
 };
 
 
 /*! CachingRotationModel is an abstract base class for complicated rotation
- *  models that are computationally expensive. The last calculated spin,
- *  equator orientation, and angular velocity are all cached and reused in
- *  order to avoid redundant calculation. Subclasses must override computeSpin(),
+ *  models that are computationally expensive. The spin, equator orientation,
+ *  and angular velocity calculated for the last few times are all cached and
+ *  reused in order to avoid redundant calculation. The caches may be used
+ *  from several threads at once. Subclasses must override computeSpin(),
  *  computeEquatorOrientation(), and getPeriod(). The default implementation
  *  of computeAngularVelocity uses differentiation to approximate the
  *  the instantaneous angular velocity. It may be overridden if there is some
@@ -89,7 +99,7 @@ class CachingRotationModel : public RotationModel
  public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-    CachingRotationModel();
+    CachingRotationModel() = default;
     virtual ~CachingRotationModel() = default;
 
     Eigen::Quaterniond spin(double tjd) const;
@@ -102,14 +112,12 @@ class CachingRotationModel : public RotationModel
     virtual double getPeriod() const = 0;
     virtual bool isPeriodic() const = 0;
 
+    TimeCacheStatistics getCacheStatistics() const;
+
 private:
-    mutable Eigen::Quaterniond lastSpin;
-    mutable Eigen::Quaterniond lastEquator;
-    mutable Eigen::Vector3d lastAngularVelocity;
-    mutable double lastTime;
-    mutable bool spinCacheValid;
-    mutable bool equatorCacheValid;
-    mutable bool angularVelocityCacheValid;
+    TimeCache<Eigen::Quaterniond> spinCache;
+    TimeCache<Eigen::Quaterniond> equatorCache;
+    TimeCache<Eigen::Vector3d> angularVelocityCache;
 };
 
 
@@ -13,6 +13,7 @@
 #include "orbit.h"
 #include "samporbit.h"
 #include "xyzvbinary.h"
+#include "xyzvcompressed.h"
 #include <celengine/astro.h>
 #include <celmath/mathlib.h>
 #include <celutil/bytes.h>
@@ -25,6 +26,8 @@
 #include <fstream>
 #include <limits>
 #include <iomanip>
+#include <atomic>
+#include <mutex>
 #include <fmt/printf.h>
 
 using namespace Eigen;
@@ -88,7 +91,9 @@ private:
     vector<Sample<T> > samples;
     double boundingRadius;
     double period;
-    mutable int lastSample;
+    // Index of the last sample span used; only a search hint, so it may be
+    // shared by threads without further synchronization.
+    mutable std::atomic<int> lastSample;
 
     TrajectoryInterpolation interpolation;
 };
@@ -177,7 +182,7 @@ template <typename T> Vector3d SampledOrbit<T>::computePosition(double jd) const
     {
         Sample<T> samp;
         samp.t = jd;
-        int n = lastSample;
+        int n = lastSample.load(std::memory_order_relaxed);
 
         if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
         {
@@ -189,7 +194,7 @@ template <typename T> Vector3d SampledOrbit<T>::computePosition(double jd) const
             else
                 n = iter - samples.begin();
 
-            lastSample = n;
+            lastSample.store(n, std::memory_order_relaxed);
         }
 
         if (n == 0)
@@ -292,7 +297,7 @@ template <typename T> Vector3d SampledOrbit<T>::computeVelocity(double jd) const
     {
         Sample<T> samp;
         samp.t = jd;
-        int n = lastSample;
+        int n = lastSample.load(std::memory_order_relaxed);
 
         if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
         {
@@ -303,7 +308,7 @@ template <typename T> Vector3d SampledOrbit<T>::computeVelocity(double jd) const
                 n = samples.size();
             else
                 n = iter - samples.begin();
-            lastSample = n;
+            lastSample.store(n, std::memory_order_relaxed);
         }
 
         if (n == 0)
@@ -318,9 +323,9 @@ template <typename T> Vector3d SampledOrbit<T>::computeVelocity(double jd) const
                 Sample<T> s1 = samples[n];
 
                 double dt = (s1.t - s0.t);
-                return (Vector3d(s1.x, s1.y, s1.z) - Vector3d(s0.x, s0.y, s0.z)) * (1.0 / dt);
+                vel = (Vector3d(s1.x, s1.y, s1.z) - Vector3d(s0.x, s0.y, s0.z)) * (1.0 / dt);
             }
-            if (interpolation == TrajectoryInterpolationCubic)
+            else if (interpolation == TrajectoryInterpolationCubic)
             {
                 Sample<T> s0, s1, s2, s3;
                 if (n > 1)
@@ -453,7 +458,9 @@ private:
     vector<SampleXYZV<T> > samples;
     double boundingRadius;
     double period;
-    mutable int lastSample;
+    // Index of the last sample span used; only a search hint, so it may be
+    // shared by threads without further synchronization.
+    mutable std::atomic<int> lastSample;
 
     TrajectoryInterpolation interpolation;
 };
@@ -529,7 +536,7 @@ template <typename T> Vector3d SampledOrbitXYZV<T>::computePosition(double jd) c
     {
         SampleXYZV<T> samp;
         samp.t = jd;
-        int n = lastSample;
+        int n = lastSample.load(std::memory_order_relaxed);
 
         if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
         {
@@ -541,7 +548,7 @@ template <typename T> Vector3d SampledOrbitXYZV<T>::computePosition(double jd) c
             else
                 n = iter - samples.begin();
 
-            lastSample = n;
+            lastSample.store(n, std::memory_order_relaxed);
         }
 
         if (n == 0)
@@ -600,7 +607,7 @@ template <typename T> Vector3d SampledOrbitXYZV<T>::computeVelocity(double jd) c
     {
         SampleXYZV<T> samp;
         samp.t = jd;
-        int n = lastSample;
+        int n = lastSample.load(std::memory_order_relaxed);
 
         if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
         {
@@ -612,7 +619,7 @@ template <typename T> Vector3d SampledOrbitXYZV<T>::computeVelocity(double jd) c
             else
                 n = iter - samples.begin();
 
-            lastSample = n;
+            lastSample.store(n, std::memory_order_relaxed);
         }
 
         if (n > 0 && n < (int) samples.size())
@@ -625,7 +632,7 @@ template <typename T> Vector3d SampledOrbitXYZV<T>::computeVelocity(double jd) c
                 double h = s1.t - s0.t;
                 vel = Vector3d(s1.position.x() - s0.position.x(),
                                s1.position.y() - s0.position.y(),
-                               s1.position.z() - s0.position.z()) * (1.0 / h) * astro::daysToSecs(1.0);
+                               s1.position.z() - s0.position.z()) * (1.0 / h);
             }
             else if (interpolation == TrajectoryInterpolationCubic)
             {
@@ -665,6 +672,236 @@ template <typename T> void SampledOrbitXYZV<T>::sample(double /* startTime */, d
 }
 
 
+// Sampled orbit with positions and velocities kept in the compressed xyzv
+// format. Segments are decoded on demand; only the most recently used one is
+// kept in decoded form, guarded by decodedMutex.
+class CompressedSampledOrbitXYZV : public CachingOrbit
+{
+public:
+    CompressedSampledOrbitXYZV(const XYZVCompressedHeader& _header,
+                               vector<XYZVCompressedSegment>&& _segments,
+                               vector<uint8_t>&& _payload,
+                               TrajectoryInterpolation _interpolation);
+    ~CompressedSampledOrbitXYZV() override = default;
+
+    double getPeriod() const override;
+    double getBoundingRadius() const override;
+    Vector3d computePosition(double jd) const override;
+    Vector3d computeVelocity(double jd) const override;
+
+    bool isPeriodic() const override;
+    void getValidRange(double& begin, double& end) const override;
+
+    void sample(double startTime, double endTime, OrbitSampleProc& proc) const override;
+
+private:
+    const XYZVBinaryData* decodeSegment(size_t index) const;
+    int bracket(double jd, XYZVBinaryData& s0, XYZVBinaryData& s1) const;
+
+    XYZVCompressedHeader header;
+    vector<XYZVCompressedSegment> segments;
+    vector<uint8_t> payload;
+    XYZVBinaryData last;
+
+    mutable std::mutex decodedMutex;
+    mutable vector<XYZVBinaryData> decoded;
+    mutable size_t decodedSegment;
+
+    TrajectoryInterpolation interpolation;
+};
+
+
+CompressedSampledOrbitXYZV::CompressedSampledOrbitXYZV(const XYZVCompressedHeader& _header,
+                                                       vector<XYZVCompressedSegment>&& _segments,
+                                                       vector<uint8_t>&& _payload,
+                                                       TrajectoryInterpolation _interpolation) :
+    header(_header),
+    segments(std::move(_segments)),
+    payload(std::move(_payload)),
+    decodedSegment(numeric_limits<size_t>::max()),
+    interpolation(_interpolation)
+{
+    const XYZVBinaryData* s = decodeSegment(segments.size() - 1);
+    last = s[segments.back().count - 1];
+}
+
+
+double CompressedSampledOrbitXYZV::getPeriod() const
+{
+    return last.tdb - segments.front().first.tdb;
+}
+
+
+bool CompressedSampledOrbitXYZV::isPeriodic() const
+{
+    return false;
+}
+
+
+void CompressedSampledOrbitXYZV::getValidRange(double& begin, double& end) const
+{
+    begin = segments.front().first.tdb;
+    end = last.tdb;
+}
+
+
+double CompressedSampledOrbitXYZV::getBoundingRadius() const
+{
+    return header.boundingRadius;
+}
+
+
+const XYZVBinaryData* CompressedSampledOrbitXYZV::decodeSegment(size_t index) const
+{
+    if (index != decodedSegment)
+    {
+        const XYZVCompressedSegment& segment = segments[index];
+        decoded.resize(segment.count);
+        // Segments are validated when the file is loaded
+        xyzvc::DecodeSegment(header, segment, payload.data(), payload.size(), decoded.data());
+        decodedSegment = index;
+    }
+
+    return decoded.data();
+}
+
+
+// Find the samples bracketing jd. Returns 0 if jd is before the first sample,
+// 2 if it is after the last one (s0 is set to the nearest sample in both
+// cases) and 1 otherwise.
+int CompressedSampledOrbitXYZV::bracket(double jd, XYZVBinaryData& s0, XYZVBinaryData& s1) const
+{
+    if (jd <= segments.front().first.tdb)
+    {
+        s0 = segments.front().first;
+        return 0;
+    }
+    if (jd >= last.tdb)
+    {
+        s0 = last;
+        return 2;
+    }
+
+    auto iter = upper_bound(segments.begin(), segments.end(), jd,
+                            [](double t, const XYZVCompressedSegment& s) { return t < s.first.tdb; });
+    size_t index = iter == segments.begin() ? 0 : (size_t) (iter - segments.begin()) - 1;
+
+    std::lock_guard<std::mutex> lock(decodedMutex);
+    const XYZVBinaryData* samples = decodeSegment(index);
+    uint32_t count = segments[index].count;
+
+    const XYZVBinaryData* s = lower_bound(samples, samples + count, jd,
+                                          [](const XYZVBinaryData& d, double t) { return d.tdb < t; });
+    if (s == samples + count)
+    {
+        // jd falls in the gap between this segment and the next one
+        s0 = samples[count - 1];
+        s1 = segments[index + 1].first;
+    }
+    else if (s == samples)
+    {
+        // jd is the time of the first sample of the segment
+        s0 = samples[0];
+        s1 = count > 1 ? samples[1] : segments[index + 1].first;
+    }
+    else
+    {
+        s0 = *(s - 1);
+        s1 = *s;
+    }
+
+    return 1;
+}
+
+
+Vector3d CompressedSampledOrbitXYZV::computePosition(double jd) const
+{
+    XYZVBinaryData s0, s1;
+    Vector3d pos;
+
+    if (bracket(jd, s0, s1) != 1)
+    {
+        pos = Map<const Vector3d>(s0.position);
+    }
+    else
+    {
+        Vector3d p0 = Map<const Vector3d>(s0.position);
+        Vector3d p1 = Map<const Vector3d>(s1.position);
+        double h = s1.tdb - s0.tdb;
+        double t = (jd - s0.tdb) / h;
+
+        if (interpolation == TrajectoryInterpolationLinear)
+        {
+            pos = p0 + t * (p1 - p0);
+        }
+        else if (interpolation == TrajectoryInterpolationCubic)
+        {
+            // Convert velocities from km/sec to km/Julian day
+            Vector3d v0 = Map<const Vector3d>(s0.velocity) * astro::daysToSecs(1.0);
+            Vector3d v1 = Map<const Vector3d>(s1.velocity) * astro::daysToSecs(1.0);
+            pos = cubicInterpolate(p0, v0 * h, p1, v1 * h, t);
+        }
+        else
+        {
+            // Unknown interpolation type
+            pos = Vector3d::Zero();
+        }
+    }
+
+    // Add correction for Celestia's coordinate system
+    return Vector3d(pos.x(), pos.z(), -pos.y());
+}
+
+
+Vector3d CompressedSampledOrbitXYZV::computeVelocity(double jd) const
+{
+    XYZVBinaryData s0, s1;
+    Vector3d vel(Vector3d::Zero());
+
+    if (bracket(jd, s0, s1) == 1)
+    {
+        Vector3d p0 = Map<const Vector3d>(s0.position);
+        Vector3d p1 = Map<const Vector3d>(s1.position);
+        double h = s1.tdb - s0.tdb;
+        double ih = 1.0 / h;
+
+        if (interpolation == TrajectoryInterpolationLinear)
+        {
+            vel = (p1 - p0) * ih;
+        }
+        else if (interpolation == TrajectoryInterpolationCubic)
+        {
+            double t = (jd - s0.tdb) * ih;
+            Vector3d v0 = Map<const Vector3d>(s0.velocity) * astro::daysToSecs(1.0);
+            Vector3d v1 = Map<const Vector3d>(s1.velocity) * astro::daysToSecs(1.0);
+            vel = cubicInterpolateVelocity(p0, v0 * h, p1, v1 * h, t) * ih;
+        }
+    }
+
+    // Add correction for Celestia's coordinate system
+    return Vector3d(vel.x(), vel.z(), -vel.y());
+}
+
+
+void CompressedSampledOrbitXYZV::sample(double /* startTime */, double /* endTime */,
+                                        OrbitSampleProc& proc) const
+{
+    vector<XYZVBinaryData> buffer(header.samplesPerSegment);
+    for (const auto& segment : segments)
+    {
+        xyzvc::DecodeSegment(header, segment, payload.data(), payload.size(), buffer.data());
+        for (uint32_t i = 0; i < segment.count; i++)
+        {
+            const XYZVBinaryData& s = buffer[i];
+            Vector3d v = Map<const Vector3d>(s.velocity) * astro::daysToSecs(1.0);
+            proc.sample(s.tdb,
+                        Vector3d(s.position[0], s.position[2], -s.position[1]),
+                        Vector3d(v.x(), v.z(), -v.y()));
+        }
+    }
+}
+
+
 // Scan past comments. A comment begins with the # character and ends
 // with a newline. Return true if the stream state is good. The stream
 // position will be at the first non-comment, non-whitespace character.
@@ -822,9 +1059,111 @@ template <typename T> SampledOrbitXYZV<T>* LoadSampledOrbitXYZV(const string& fi
     return orbit;
 }
 
-/* Load a binary xyzv sampled trajectory file.
+/* Load a compressed binary xyzv sampled trajectory file.
  */
-template <typename T> SampledOrbitXYZV<T>*
+static Orbit*
+LoadCompressedOrbitXYZV(const string& filename, TrajectoryInterpolation interpolation)
+{
+    ifstream in(filename, ios::in | ios::binary);
+    if (!in.good())
+    {
+        fmt::fprintf(cerr, _("Error openning %s.\n"), filename);
+        return nullptr;
+    }
+
+    XYZVCompressedHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    {
+        fmt::fprintf(cerr, _("Error reading header of %s.\n"), filename);
+        return nullptr;
+    }
+
+    if (string(header.magic) != xyzvc::Magic)
+    {
+        fmt::fprintf(cerr, _("Bad compressed xyzv file %s.\n"), filename);
+        return nullptr;
+    }
+
+    if (header.byteOrder != __BYTE_ORDER__)
+    {
+        fmt::fprintf(cerr, _("Unsupported byte order %i, expected %i.\n"),
+                     header.byteOrder, __BYTE_ORDER__);
+        return nullptr;
+    }
+
+    if (header.digits != std::numeric_limits<double>::digits)
+    {
+        fmt::fprintf(cerr, _("Unsupported digits number %i, expected %i.\n"),
+                     header.digits, std::numeric_limits<double>::digits);
+        return nullptr;
+    }
+
+    if (header.count == 0 || header.segmentCount == 0 || header.samplesPerSegment == 0)
+        return nullptr;
+
+    // Sizes read from the file are checked against its size before
+    // anything is allocated.
+    in.seekg(0, ios::end);
+    auto fileSize = (uint64_t) in.tellg();
+    in.seekg(sizeof(header));
+    if (header.segmentCount > xyzvc::MaxSegmentCount(fileSize))
+    {
+        fmt::fprintf(cerr, _("Bad compressed xyzv file %s.\n"), filename);
+        return nullptr;
+    }
+
+    vector<XYZVCompressedSegment> segments(header.segmentCount);
+    if (!in.read(reinterpret_cast<char*>(segments.data()), segments.size() * sizeof(XYZVCompressedSegment)))
+    {
+        fmt::fprintf(cerr, _("Error reading segment table of %s.\n"), filename);
+        return nullptr;
+    }
+
+    uint64_t payloadSize = 0;
+    uint64_t tableSize = sizeof(header) + segments.size() * sizeof(XYZVCompressedSegment);
+    if (!xyzvc::CheckSegmentTable(header, segments, fileSize - tableSize, payloadSize))
+    {
+        fmt::fprintf(cerr, _("Bad compressed xyzv file %s.\n"), filename);
+        return nullptr;
+    }
+
+    vector<uint8_t> payload(payloadSize);
+    if (!in.read(reinterpret_cast<char*>(payload.data()), payload.size()))
+    {
+        fmt::fprintf(cerr, _("Error reading %s.\n"), filename);
+        return nullptr;
+    }
+
+    // Validate every segment once so that decoding on demand can't fail,
+    // and check that samples are sorted across segment boundaries.
+    vector<XYZVBinaryData> buffer(header.samplesPerSegment);
+    double lastSampleTime = -numeric_limits<double>::infinity();
+    for (const auto& segment : segments)
+    {
+        if (!xyzvc::DecodeSegment(header, segment, payload.data(), payload.size(), buffer.data()))
+        {
+            fmt::fprintf(cerr, _("Bad compressed xyzv file %s.\n"), filename);
+            return nullptr;
+        }
+        for (uint32_t i = 0; i < segment.count; i++)
+        {
+            if (buffer[i].tdb <= lastSampleTime)
+            {
+                fmt::fprintf(cerr, _("Samples are not sorted by time in %s.\n"), filename);
+                return nullptr;
+            }
+            lastSampleTime = buffer[i].tdb;
+        }
+    }
+
+    return new CompressedSampledOrbitXYZV(header, std::move(segments), std::move(payload), interpolation);
+}
+
+
+/* Load a binary xyzv sampled trajectory file. Compressed files are
+ * recognized by their magic and decoded in double precision.
+ */
+template <typename T> Orbit*
 LoadSampledOrbitXYZVBinary(const string& filename, TrajectoryInterpolation interpolation, T /*unused*/)
 {
     ifstream in(filename);
@@ -841,6 +1180,12 @@ LoadSampledOrbitXYZVBinary(const string& filename, TrajectoryInterpolation inter
         return nullptr;
     }
 
+    if (string(header.magic) == xyzvc::Magic)
+    {
+        in.close();
+        return LoadCompressedOrbitXYZV(filename, interpolation);
+    }
+
     if (string(header.magic) != "CELXYZV")
     {
         fmt::fprintf(cerr, _("Bad binary xyzv file %s.\n"), filename);
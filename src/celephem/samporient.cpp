@@ -21,6 +21,7 @@
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <atomic>
 
 using namespace Eigen;
 using namespace std;
@@ -99,7 +100,9 @@ private:
 
 private:
     OrientationSampleVector samples;
-    mutable int lastSample{0};
+    // Index of the last sample span used; only a search hint, so it may be
+    // shared by threads without further synchronization.
+    mutable std::atomic<int> lastSample{0};
 
     enum InterpolationType
     {
@@ -165,7 +168,7 @@ SampledOrientation::getOrientation(double tjd) const
     {
         OrientationSample samp;
         samp.t = tjd;
-        int n = lastSample;
+        int n = lastSample.load(std::memory_order_relaxed);
 
         // Do a binary search to find the samples that define the orientation
         // at the current time. Cache the previous sample used and avoid
@@ -180,7 +183,7 @@ SampledOrientation::getOrientation(double tjd) const
             else
                 n = iter - samples.begin();
 
-            lastSample = n;
+            lastSample.store(n, std::memory_order_relaxed);
         }
 
         if (n == 0)
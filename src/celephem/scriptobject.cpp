@@ -18,6 +18,8 @@ using namespace std;
 
 // global script context for scripted orbits and rotations
 static lua_State* scriptObjectLuaState = NULL;
+static recursive_mutex scriptObjectMutex;
+static thread_local unsigned int scriptObjectLockDepth = 0;
 
 static const char* ScriptedObjectNamePrefix = "cel_script_object_";
 static unsigned int ScriptedObjectNameIndex = 1;
@@ -42,6 +44,31 @@ GetScriptedObjectContext()
 }
 
 
+ScriptedObjectLock::ScriptedObjectLock()
+{
+    scriptObjectMutex.lock();
+    scriptObjectLockDepth++;
+}
+
+
+ScriptedObjectLock::~ScriptedObjectLock()
+{
+    scriptObjectLockDepth--;
+    scriptObjectMutex.unlock();
+}
+
+
+/*! Return true if the calling thread holds the lock. Work that evaluates
+ *  scripted objects must not be handed to other threads and waited for
+ *  in that case, since they would block on the lock forever.
+ */
+bool
+ScriptedObjectLock::heldByCurrentThread()
+{
+    return scriptObjectLockDepth > 0;
+}
+
+
 /*! Generate a unique name for this script orbit object so that
  * we can refer to it later.
  */
@@ -126,3 +153,89 @@ SetLuaVariables(lua_State* state, Hash* parameters)
         }
     }
 }
+
+
+/*! Return true if the table at tableIndex has a function value for key.
+ */
+bool
+HasLuaMethod(lua_State* state,
+             int tableIndex,
+             const string& key)
+{
+    GetLuaTableEntry(state, tableIndex, key);
+    bool isFunction = lua_isfunction(state, -1) != 0;
+    lua_pop(state, 1);
+
+    return isFunction;
+}
+
+
+/*! Call a batch method of the script object with the given global name.
+ *  The method is called as object:method(times, out), where times is an
+ *  array of count time values and out is an array preallocated for
+ *  count * width numbers. The method stores the results for times[i] in
+ *  out[i * width + 1] .. out[(i + 1) * width], which are copied to values.
+ *  Evaluating many times with a single call avoids the overhead of a Lua
+ *  call per time, and lets a tracing JIT compile the loop in the method.
+ *  Returns false if the method is missing or fails; values are then left
+ *  unchanged. The caller must hold the scripted object lock.
+ */
+bool
+CallLuaBatchMethod(lua_State* state,
+                   const string& objectName,
+                   const string& methodName,
+                   const double* times,
+                   size_t count,
+                   int width,
+                   double* values)
+{
+    bool success = false;
+
+    lua_getglobal(state, objectName.c_str());
+    if (lua_istable(state, -1))
+    {
+        lua_pushstring(state, methodName.c_str());
+        lua_gettable(state, -2);
+        if (lua_isfunction(state, -1))
+        {
+            lua_pushvalue(state, -2); // push 'self' on stack
+
+            lua_createtable(state, (int) count, 0);
+            for (size_t i = 0; i < count; i++)
+            {
+                lua_pushnumber(state, times[i]);
+                lua_rawseti(state, -2, (int) i + 1);
+            }
+
+            // Keep a reference to the output table below the function so
+            // that it can be read after the call.
+            lua_createtable(state, (int) (count * width), 0);
+            lua_pushvalue(state, -1);
+            lua_insert(state, -5);
+
+            if (lua_pcall(state, 3, 0, 0) == 0)
+            {
+                for (size_t i = 0; i < count * width; i++)
+                {
+                    lua_rawgeti(state, -1, (int) i + 1);
+                    values[i] = lua_tonumber(state, -1);
+                    lua_pop(state, 1);
+                }
+                success = true;
+            }
+            else
+            {
+                // Pop the error message
+                lua_pop(state, 1);
+            }
+        }
+
+        // Pop the output table or the bad method value
+        lua_pop(state, 1);
+    }
+
+    // Pop the script object
+    lua_pop(state, 1);
+
+    return success;
+}
@@ -17,6 +17,8 @@
 #endif
 
 #include "lua.hpp"
+#include <cstddef>
+#include <mutex>
 #include <string>
 #include <celengine/parser.h>
 
@@ -25,6 +27,23 @@ void SetScriptedObjectContext(lua_State* l);
 
 lua_State* GetScriptedObjectContext();
 
+/*! Lock that serializes calls into the script context for its lifetime.
+ *  Lua states are not reentrant, and scripted orbits and rotations may be
+ *  evaluated from worker threads. The lock is recursive because Lua code
+ *  running with the lock held may itself evaluate scripted objects.
+ */
+class ScriptedObjectLock
+{
+ public:
+    ScriptedObjectLock();
+    ~ScriptedObjectLock();
+
+    ScriptedObjectLock(const ScriptedObjectLock&) = delete;
+    ScriptedObjectLock& operator=(const ScriptedObjectLock&) = delete;
+
+    static bool heldByCurrentThread();
+};
+
 
 std::string GenerateScriptObjectName();
 
@@ -39,4 +58,16 @@ double SafeGetLuaNumber(lua_State* state,
 
 void SetLuaVariables(lua_State* state, Hash* parameters);
 
+bool HasLuaMethod(lua_State* state,
+                  int tableIndex,
+                  const std::string& key);
+
+bool CallLuaBatchMethod(lua_State* state,
+                        const std::string& objectName,
+                        const std::string& methodName,
+                        const double* times,
+                        std::size_t count,
+                        int width,
+                        double* values);
+
 #endif // _CELENGINE_SCRIPTOBJECT_H_
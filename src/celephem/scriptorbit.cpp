@@ -9,8 +9,10 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cstdio>
 #include <cassert>
+#include <vector>
 #include "scriptobject.h"
 #include "scriptorbit.h"
 
@@ -41,6 +43,11 @@ using namespace std;
  *      position(time) - The position function takes a time value as input
  *         (TDB Julian day) and returns three values which are the x, y, and
  *         z coordinates. Units for the position are kilometers.
+ *      positions(times, out) - Optional batch version of position. times is
+ *         an array of n time values; the function stores the coordinates of
+ *         the positions in the preallocated array out as x1, y1, z1, x2, ...
+ *         When present, it is used whenever several positions are needed at
+ *         once, for example when sampling the orbit path.
  */
 bool
 ScriptedOrbit::initialize(const std::string& moduleName,
@@ -136,6 +143,7 @@ ScriptedOrbit::initialize(const std::string& moduleName,
     period          = SafeGetLuaNumber(luaState, -1, "period", 0.0);
     validRangeBegin = SafeGetLuaNumber(luaState, -1, "beginDate", 0.0);
     validRangeEnd   = SafeGetLuaNumber(luaState, -1, "endDate", 0.0);
+    batched         = HasLuaMethod(luaState, -1, "positions");
 
     // Pop the orbit object off the stack
     lua_pop(luaState, 1);
@@ -162,6 +170,7 @@ Vector3d
 ScriptedOrbit::computePosition(double tjd) const
 {
     Vector3d pos(Vector3d::Zero());
+    ScriptedObjectLock lock;
     lua_getglobal(luaState, luaOrbitObjectName.c_str());
     if (lua_istable(luaState, -1))
     {
@@ -202,6 +211,85 @@ ScriptedOrbit::computePosition(double tjd) const
 }
 
 
+// Call the positions method of the ScriptedOrbit object, in batches small
+// enough not to hold the script lock for long.
+bool
+ScriptedOrbit::computePositions(const double* tjd,
+                                Vector3d* positions,
+                                size_t count) const
+{
+    const size_t MaxBatchSize = 1024;
+
+    if (!batched)
+        return CachingOrbit::computePositions(tjd, positions, count);
+
+    vector<double> values(3 * min(count, MaxBatchSize));
+    for (size_t first = 0; first < count; first += MaxBatchSize)
+    {
+        size_t n = min(count - first, MaxBatchSize);
+        {
+            ScriptedObjectLock lock;
+            if (!CallLuaBatchMethod(luaState, luaOrbitObjectName, "positions",
+                                    tjd + first, n, 3, values.data()))
+            {
+                return false;
+            }
+        }
+
+        // Convert to Celestia's internal coordinate system
+        for (size_t i = 0; i < n; i++)
+            positions[first + i] = Vector3d(values[3 * i], values[3 * i + 2], -values[3 * i + 1]);
+    }
+
+    return true;
+}
+
+
+// Evaluate the position and the nearby position used to differentiate it
+// with a single call to a batched script.
+bool
+ScriptedOrbit::computeBatchedState(double tjd, Vector3d& position, Vector3d& velocity) const
+{
+    const double dt = VelocityDiffDelta;
+    double times[2] = { tjd, tjd + dt };
+    Vector3d p[2];
+    if (!batched || !computePositions(times, p, 2))
+        return false;
+
+    position = p[0];
+    velocity = (p[1] - p[0]) * (1.0 / dt);
+    return true;
+}
+
+
+Vector3d
+ScriptedOrbit::computeVelocity(double tjd) const
+{
+    Vector3d position, velocity;
+    if (computeBatchedState(tjd, position, velocity))
+        return velocity;
+
+    return CachingOrbit::computeVelocity(tjd);
+}
+
+
+void
+ScriptedOrbit::computeState(double tjd, Vector3d& position, Vector3d& velocity) const
+{
+    if (!computeBatchedState(tjd, position, velocity))
+        CachingOrbit::computeState(tjd, position, velocity);
+}
+
+
+void
+ScriptedOrbit::sample(double startTime, double endTime, OrbitSampleProc& proc) const
+{
+    AdaptiveSamplingParameters samplingParams = getSamplingParameters(startTime, endTime);
+    if (!batched || !batchSample(startTime, endTime, proc, samplingParams))
+        adaptiveSample(startTime, endTime, proc, samplingParams);
+}
+
+
 double
 ScriptedOrbit::getPeriod() const
 {
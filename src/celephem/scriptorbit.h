@@ -28,19 +28,31 @@ class ScriptedOrbit : public CachingOrbit
                     Hash* parameters);
 
     virtual Eigen::Vector3d computePosition(double tjd) const;
-    //virtual Vec3d computeVelocity(double tjd) const;
+    virtual Eigen::Vector3d computeVelocity(double tjd) const;
+    virtual void computeState(double tjd,
+                              Eigen::Vector3d& position,
+                              Eigen::Vector3d& velocity) const;
+    virtual bool computePositions(const double* tjd,
+                                  Eigen::Vector3d* positions,
+                                  std::size_t count) const;
+    virtual void sample(double startTime, double endTime, OrbitSampleProc& proc) const;
     virtual bool isPeriodic() const;
     virtual double getPeriod() const;
     virtual double getBoundingRadius() const;
     virtual void getValidRange(double& begin, double& end) const;
 
  private:
+    bool computeBatchedState(double tjd,
+                             Eigen::Vector3d& position,
+                             Eigen::Vector3d& velocity) const;
+
     lua_State* luaState{ nullptr };
     std::string luaOrbitObjectName;
     double boundingRadius{ 1.0 };
     double period{ 0.0 };
     double validRangeBegin{ 0.0 };
     double validRangeEnd{ 0.0 };
+    bool batched{ false };
 };
 
 #endif // _CELENGINE_SCRIPTORBIT_H_
@@ -9,8 +9,10 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <cmath>
 #include <cstdio>
 #include <cassert>
+#include <vector>
 #include "scriptobject.h"
 #include "scriptrotation.h"
 
@@ -39,6 +41,11 @@ using namespace std;
  *      orientation(time) - The orientation function takes a time value as
  *         input (TDB Julian day) and returns three values which are the the
  *         quaternion (w, x, y, z).
+ *      orientations(times, out) - Optional batch version of orientation.
+ *         times is an array of n time values; the function stores the
+ *         quaternions in the preallocated array out as w1, x1, y1, z1,
+ *         w2, ... When present, it is used whenever several orientations
+ *         are needed at once, for example to compute the angular velocity.
  */
 bool
 ScriptedRotation::initialize(const std::string& moduleName,
@@ -119,6 +126,7 @@ ScriptedRotation::initialize(const std::string& moduleName,
     period          = SafeGetLuaNumber(luaState, -1, "period", 0.0);
     validRangeBegin = SafeGetLuaNumber(luaState, -1, "beginDate", 0.0);
     validRangeEnd   = SafeGetLuaNumber(luaState, -1, "endDate", 0.0);
+    batched         = HasLuaMethod(luaState, -1, "orientations");
 
     // Pop the rotations object off the stack
     lua_pop(luaState, 1);
@@ -138,6 +146,8 @@ ScriptedRotation::initialize(const std::string& moduleName,
 Quaterniond
 ScriptedRotation::spin(double tjd) const
 {
+    // The lock also protects the cached orientation
+    ScriptedObjectLock lock;
     if (tjd != lastTime || !cacheable)
     {
         lua_getglobal(luaState, luaRotationObjectName.c_str());
@@ -207,3 +217,41 @@ ScriptedRotation::getValidRange(double& begin, double& end) const
     begin = validRangeBegin;
     end = validRangeEnd;
 }
+
+
+// Call the orientations method of the ScriptedRotation object
+bool
+ScriptedRotation::computeSpins(const double* tjd,
+                               Quaterniond* spins,
+                               size_t count) const
+{
+    vector<double> values(4 * count);
+    {
+        ScriptedObjectLock lock;
+        if (!CallLuaBatchMethod(luaState, luaRotationObjectName, "orientations",
+                                tjd, count, 4, values.data()))
+        {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++)
+        spins[i] = Quaterniond(values[4 * i], values[4 * i + 1], values[4 * i + 2], values[4 * i + 3]);
+
+    return true;
+}
+
+
+Vector3d
+ScriptedRotation::angularVelocityAtTime(double tjd) const
+{
+    // Evaluate both orientations needed for differentiation with a
+    // single call.
+    double dt = getDiffTimeDelta();
+    double times[2] = { tjd, tjd + dt };
+    Quaterniond q[2];
+    if (!batched || !computeSpins(times, q, 2))
+        return RotationModel::angularVelocityAtTime(tjd);
+
+    return differentiateOrientation(q[0], q[1], dt);
+}
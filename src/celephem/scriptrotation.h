@@ -14,6 +14,7 @@
 
 #include <celengine/parser.h>
 #include "rotation.h"
+#include <cstddef>
 
 struct lua_State;
 
@@ -29,17 +30,23 @@ class ScriptedRotation : public RotationModel
                     Hash* parameters);
 
     virtual Eigen::Quaterniond spin(double tjd) const;
+    virtual Eigen::Vector3d angularVelocityAtTime(double tjd) const;
 
     virtual bool isPeriodic() const;
     virtual double getPeriod() const;
     virtual void getValidRange(double& begin, double& end) const;
 
  private:
+    bool computeSpins(const double* tjd,
+                      Eigen::Quaterniond* spins,
+                      std::size_t count) const;
+
     lua_State* luaState{ nullptr };
     std::string luaRotationObjectName;
     double period{ 0.0 };
     double validRangeBegin{ 0.0 };
     double validRangeEnd{ 0.0 };
+    bool batched{ false };
 
     // Cached values
     mutable double lastTime{ -1.0e50 };
@@ -13,6 +13,7 @@
 #include "spiceinterface.h"
 #include <iostream>
 #include <cstdio>
+#include <mutex>
 #include <set>
 
 using namespace std;
@@ -23,6 +24,14 @@ using namespace std;
 // kernel pool.
 static set<string> ResidentSpiceKernels;
 
+static mutex spiceMutex;
+
+
+std::mutex& GetSpiceMutex()
+{
+    return spiceMutex;
+}
+
 
 /*! Perform one-time initialization of SPICE.
  */
@@ -12,6 +12,7 @@
 #ifndef _CELENGINE_SPICEINTERFACE_H_
 #define _CELENGINE_SPICEINTERFACE_H_
 
+#include <mutex>
 #include <string>
 
 extern bool InitializeSpice();
@@ -22,4 +23,8 @@ extern bool GetNaifId(const std::string& name, int* id);
 extern bool IsSpiceKernelLoaded(const std::string& filepath);
 extern bool LoadSpiceKernel(const std::string& filepath);
 
+// The SPICE Toolkit is not thread safe; any call that may be made from a
+// worker thread must hold this lock.
+extern std::mutex& GetSpiceMutex();
+
 #endif // _CELENGINE_SPICEINTERFACE_H_
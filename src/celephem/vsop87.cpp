@@ -11011,7 +11011,51 @@ static double SumSeries(const VSOPSeries& series, double t)
     return x;
 };
 
-class VSOP87Orbit : public CachingOrbit
+
+// Evaluate a series together with its derivative with respect to t.
+static void SumSeries(const VSOPSeries& series, double t, double& x, double& dx)
+{
+    x = 0.0;
+    dx = 0.0;
+    if (series.nTerms < 1)
+        return;
+
+    VSOPTerm* term = &series.terms[0];
+    for (int i = 0; i < series.nTerms; i++, term++)
+    {
+        double w = term->B + term->C * t;
+        x += term->A * cos(w);
+        dx -= term->A * term->C * sin(w);
+    }
+}
+
+
+// Evaluate sum(S_i(t) * t^i) over n series S_i, and its derivative with
+// respect to t.
+static void SumSeriesPolynomial(const VSOPSeries* series, int n, double t, double& x, double& dx)
+{
+    x = 0.0;
+    dx = 0.0;
+
+    double T = 1.0;
+    double dT = 0.0;
+    for (int i = 0; i < n; i++)
+    {
+        double s, ds;
+        SumSeries(series[i], t, s, ds);
+        x += s * T;
+        dx += ds * T + s * dT;
+        dT = dT * t + T;
+        T *= t;
+    }
+}
+
+
+// Julian days per Julian millennium, the time unit of VSOP87
+static const double DaysPerMillennium = 365250.0;
+
+
+class VSOP87Orbit : public AnalyticStateOrbit
 {
  private:
     VSOPSeries* vsL;
@@ -11096,6 +11140,35 @@ class VSOP87Orbit : public CachingOrbit
                         -sin(l) * sin(b) * r);
     }
 
+    void computeState(double jd, Vector3d& position, Vector3d& velocity) const override
+    {
+        double t = (jd - 2451545.0) / DaysPerMillennium;
+
+        double l, dl, b, db, r, dr;
+        SumSeriesPolynomial(vsL, nL, t, l, dl);
+        SumSeriesPolynomial(vsB, nB, t, b, db);
+        SumSeriesPolynomial(vsR, nR, t, r, dr);
+
+        // Derivatives are per millennium; convert them to per day
+        r *= KM_PER_AU;
+        dr *= KM_PER_AU / DaysPerMillennium;
+        dl /= DaysPerMillennium;
+        db /= DaysPerMillennium;
+
+        // Corrections for internal coordinate system
+        b -= PI / 2;
+        l += PI;
+
+        double cl = cos(l), sl = sin(l);
+        double cb = cos(b), sb = sin(b);
+        position = Vector3d(cl * sb * r,
+                            cb * r,
+                            -sl * sb * r);
+        velocity = Vector3d(dr * cl * sb - r * sl * sb * dl + r * cl * cb * db,
+                            dr * cb - r * sb * db,
+                            -dr * sl * sb - r * cl * sb * dl - r * sl * cb * db);
+    }
+
 
     /** Custom implementation of sample() for VSOP87 orbits. The default
       * implementation runs too slowly and produces too many samples.
@@ -11121,7 +11194,7 @@ class VSOP87Orbit : public CachingOrbit
 
 
 // VSOP87 orbit with rectangular variables
-class VSOP87OrbitRect : public CachingOrbit
+class VSOP87OrbitRect : public AnalyticStateOrbit
 {
  private:
     VSOPSeries* vsX;
@@ -11202,6 +11275,23 @@ class VSOP87OrbitRect : public CachingOrbit
         // Corrections for internal coordinate system
         return Vector3d(v.x(), v.z(), -v.y());
     }
+
+    void computeState(double jd, Vector3d& position, Vector3d& velocity) const override
+    {
+        double t = (jd - 2451545.0) / DaysPerMillennium;
+
+        Vector3d p, v;
+        SumSeriesPolynomial(vsX, nX, t, p.x(), v.x());
+        SumSeriesPolynomial(vsY, nY, t, p.y(), v.y());
+        SumSeriesPolynomial(vsZ, nZ, t, p.z(), v.z());
+
+        p *= KM_PER_AU;
+        v *= KM_PER_AU / DaysPerMillennium;
+
+        // Corrections for internal coordinate system
+        position = Vector3d(p.x(), p.z(), -p.y());
+        velocity = Vector3d(v.x(), v.z(), -v.y());
+    }
 };
 
 
@@ -0,0 +1,294 @@
+#pragma once
+
+#include "xyzvbinary.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compressed binary xyzv trajectories.
+//
+// The file starts with an XYZVCompressedHeader followed by segmentCount
+// XYZVCompressedSegment records and the residual payload. Samples are grouped
+// into segments of at most samplesPerSegment records. The first sample of a
+// segment is stored at full double precision in the segment record, so each
+// segment can be decoded independently. Every following sample is predicted
+// from the previous decoded ones and only the quantized prediction residuals
+// are stored as zigzag LEB128 varints.
+//
+// The quantization steps are derived from maxError (km) so that the position
+// of a decoded sample differs from the original one by at most maxError / 2,
+// and the cubic interpolant between decoded samples by at most maxError.
+//
+// Velocities are in km/s, as in the uncompressed binary format.
+
+struct XYZVCompressedHeader
+{
+    char magic[8];
+    uint16_t byteOrder;
+    uint16_t digits;
+    uint32_t samplesPerSegment;
+    uint64_t count;
+    uint64_t segmentCount;
+    double maxError;        // km
+    double timeQuantum;     // days
+    double boundingRadius;  // km
+};
+
+struct XYZVCompressedSegment
+{
+    XYZVBinaryData first;
+    double positionQuantum; // km
+    double velocityQuantum; // km/s
+    uint64_t offset;        // offset of the residuals from the payload start
+    uint32_t count;         // number of samples including the first one
+    uint32_t size;          // size of the residuals in bytes
+};
+
+namespace xyzvc
+{
+constexpr char Magic[8] = "CELXYZC";
+constexpr double SecondsPerDay = 86400.0;
+
+// Maximum of |h * (t^3 - 2t^2 + t)| for t in [0, 1] is 4h/27; the velocity
+// error at both ends of the span contributes to the interpolated position.
+constexpr double HermiteVelocityGain = 2.0 * 4.0 / 27.0;
+
+inline uint64_t zigzag(int64_t v)
+{
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+inline int64_t unzigzag(uint64_t v)
+{
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+inline void putVarint(std::vector<uint8_t>& out, int64_t value)
+{
+    uint64_t v = zigzag(value);
+    while (v >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+inline bool getVarint(const uint8_t*& in, const uint8_t* end, int64_t& value)
+{
+    uint64_t v = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7)
+    {
+        if (in == end)
+            return false;
+        uint8_t b = *in++;
+        v |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if ((b & 0x80) == 0)
+        {
+            value = unzigzag(v);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Prediction of the next sample from the previous decoded ones, assuming
+// constant acceleration estimated from the last two velocities. Encoder and
+// decoder must use exactly the same arithmetic here.
+inline void predict(const XYZVBinaryData* prev2, const XYZVBinaryData& prev,
+                    double tdb, XYZVBinaryData& next)
+{
+    double dt = (tdb - prev.tdb) * SecondsPerDay;
+    double k = 0.0;
+    if (prev2 != nullptr)
+        k = dt / ((prev.tdb - prev2->tdb) * SecondsPerDay);
+
+    next.tdb = tdb;
+    for (int i = 0; i < 3; i++)
+    {
+        double dv = prev2 != nullptr ? (prev.velocity[i] - prev2->velocity[i]) * k : 0.0;
+        next.position[i] = prev.position[i] + (prev.velocity[i] + 0.5 * dv) * dt;
+        next.velocity[i] = prev.velocity[i] + dv;
+    }
+}
+
+inline double positionQuantum(double maxError)
+{
+    // Half a quantum per component keeps the norm of the error below
+    // maxError / 2.
+    return maxError / std::sqrt(3.0);
+}
+
+inline double velocityQuantum(double maxError, double maxStep)
+{
+    // Keep the contribution of velocity errors to the interpolated position
+    // below maxError / 4; maxStep is in days.
+    double h = maxStep * SecondsPerDay;
+    if (h <= 0.0)
+        return positionQuantum(maxError);
+    return maxError / (2.0 * HermiteVelocityGain * h * std::sqrt(3.0));
+}
+
+inline bool quantize(double value, double quantum, int64_t& q)
+{
+    double r = std::round(value / quantum);
+    if (!(std::abs(r) < 4.0e18))
+        return false;
+    q = static_cast<int64_t>(r);
+    return true;
+}
+
+// Encode count samples as one segment, appending residuals to payload.
+// Returns false if a residual cannot be represented, i.e. if maxError is
+// unreasonably small for the trajectory, or if two samples are rounded to
+// the same time; samples must be at least timeQuantum apart.
+inline bool EncodeSegment(const XYZVCompressedHeader& header,
+                          const XYZVBinaryData* samples,
+                          uint32_t count,
+                          XYZVCompressedSegment& segment,
+                          std::vector<uint8_t>& payload)
+{
+    double maxStep = 0.0;
+    for (uint32_t i = 1; i < count; i++)
+        maxStep = std::max(maxStep, samples[i].tdb - samples[i - 1].tdb);
+
+    segment.first = samples[0];
+    segment.positionQuantum = positionQuantum(header.maxError);
+    segment.velocityQuantum = velocityQuantum(header.maxError, maxStep);
+    segment.offset = payload.size();
+    segment.count = count;
+
+    XYZVBinaryData prev2;
+    XYZVBinaryData prev = samples[0];
+    int64_t prevTick = 0;
+    int64_t prevStep = 0;
+    for (uint32_t i = 1; i < count; i++)
+    {
+        const XYZVBinaryData& s = samples[i];
+
+        // Times are stored as the second difference of the tick count since
+        // the segment start, which is zero for uniformly spaced samples.
+        int64_t tick;
+        if (!quantize(s.tdb - segment.first.tdb, header.timeQuantum, tick) || tick <= prevTick)
+            return false;
+        putVarint(payload, (tick - prevTick) - prevStep);
+        prevStep = tick - prevTick;
+        prevTick = tick;
+
+        XYZVBinaryData pred;
+        predict(i > 1 ? &prev2 : nullptr, prev,
+                segment.first.tdb + static_cast<double>(tick) * header.timeQuantum, pred);
+        for (int j = 0; j < 3; j++)
+        {
+            int64_t q;
+            if (!quantize(s.position[j] - pred.position[j], segment.positionQuantum, q))
+                return false;
+            putVarint(payload, q);
+            pred.position[j] += static_cast<double>(q) * segment.positionQuantum;
+        }
+        for (int j = 0; j < 3; j++)
+        {
+            int64_t q;
+            if (!quantize(s.velocity[j] - pred.velocity[j], segment.velocityQuantum, q))
+                return false;
+            putVarint(payload, q);
+            pred.velocity[j] += static_cast<double>(q) * segment.velocityQuantum;
+        }
+
+        prev2 = prev;
+        prev = pred;
+    }
+
+    segment.size = static_cast<uint32_t>(payload.size() - segment.offset);
+    return true;
+}
+
+// Every sample after the first one of a segment takes at least one byte for
+// its time and for each component of its position and velocity.
+constexpr uint32_t MinResidualSize = 7;
+
+// Largest number of segment records that fit in a file of fileSize bytes,
+// to be checked before the segment table is read.
+inline uint64_t MaxSegmentCount(uint64_t fileSize)
+{
+    if (fileSize <= sizeof(XYZVCompressedHeader))
+        return 0;
+    return (fileSize - sizeof(XYZVCompressedHeader)) / sizeof(XYZVCompressedSegment);
+}
+
+// Check that the segments follow each other in the payload, that it fits
+// in maxPayloadSize bytes and that they hold header.count samples, and
+// compute the payload size. samplesPerSegment is limited to the sample
+// count, so that buffers sized by it are bounded by the file size.
+inline bool CheckSegmentTable(XYZVCompressedHeader& header,
+                              const std::vector<XYZVCompressedSegment>& segments,
+                              uint64_t maxPayloadSize,
+                              uint64_t& payloadSize)
+{
+    payloadSize = 0;
+    uint64_t count = 0;
+    for (const auto& segment : segments)
+    {
+        if (segment.count == 0 || segment.count > header.samplesPerSegment ||
+            segment.offset != payloadSize ||
+            static_cast<uint64_t>(segment.count - 1) * MinResidualSize > segment.size)
+        {
+            return false;
+        }
+        payloadSize += segment.size;
+        count += segment.count;
+    }
+
+    if (payloadSize > maxPayloadSize || count != header.count)
+        return false;
+
+    header.samplesPerSegment = static_cast<uint32_t>(std::min<uint64_t>(header.samplesPerSegment, count));
+    return true;
+}
+
+// Decode a segment into out, which must have room for segment.count samples.
+inline bool DecodeSegment(const XYZVCompressedHeader& header,
+                          const XYZVCompressedSegment& segment,
+                          const uint8_t* payload,
+                          std::size_t payloadSize,
+                          XYZVBinaryData* out)
+{
+    if (segment.count == 0 || segment.offset + segment.size > payloadSize)
+        return false;
+
+    const uint8_t* in = payload + segment.offset;
+    const uint8_t* end = in + segment.size;
+
+    out[0] = segment.first;
+    int64_t prevTick = 0;
+    int64_t prevStep = 0;
+    for (uint32_t i = 1; i < segment.count; i++)
+    {
+        int64_t r;
+        if (!getVarint(in, end, r))
+            return false;
+        prevStep += r;
+        prevTick += prevStep;
+
+        XYZVBinaryData& s = out[i];
+        predict(i > 1 ? &out[i - 2] : nullptr, out[i - 1],
+                segment.first.tdb + static_cast<double>(prevTick) * header.timeQuantum, s);
+        for (int j = 0; j < 3; j++)
+        {
+            if (!getVarint(in, end, r))
+                return false;
+            s.position[j] += static_cast<double>(r) * segment.positionQuantum;
+        }
+        for (int j = 0; j < 3; j++)
+        {
+            if (!getVarint(in, end, r))
+                return false;
+            s.velocity[j] += static_cast<double>(r) * segment.velocityQuantum;
+        }
+    }
+
+    return in == end;
+}
+}
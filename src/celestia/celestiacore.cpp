@@ -30,6 +30,10 @@
 #include <celengine/axisarrow.h>
 #include <celengine/planetgrid.h>
 #include <celengine/visibleregion.h>
+#include <celengine/virtualtex.h>
+#include <celengine/texmanager.h>
+#include <celengine/meshmanager.h>
+#include <celengine/texturecache.h>
 #include <celmath/geomutil.h>
 #include <celutil/util.h>
 #include <celutil/filetype.h>
@@ -307,6 +311,22 @@ CelestiaCore::~CelestiaCore()
     if (movieCapture != nullptr)
         recordEnd();
 
+    // Orbit paths may still be sampled in the background; scripted orbits
+    // must not be evaluated once the scripts are gone.
+    renderer->invalidateOrbitCache();
+
+    VirtualTexture::TileCacheStats tileStats = VirtualTexture::getTileCacheStats();
+    if (tileStats.hits + tileStats.misses != 0)
+    {
+        fmt::fprintf(clog, "Virtual texture tiles: %llu hits, %llu misses, %llu evictions, %zu resident (%zu of %zu bytes)\n",
+                     (unsigned long long) tileStats.hits,
+                     (unsigned long long) tileStats.misses,
+                     (unsigned long long) tileStats.evictions,
+                     tileStats.residentTiles,
+                     tileStats.memoryUsage,
+                     tileStats.memoryBudget);
+    }
+
 #ifdef CELX
     // Clean up all scripts
     delete celxScript;
@@ -4282,6 +4302,15 @@ bool CelestiaCore::initRenderer()
     detailOptions.orbitWindowEnd = config->orbitWindowEnd;
     detailOptions.orbitPeriodsShown = config->orbitPeriodsShown;
     detailOptions.linearFadeFraction = config->linearFadeFraction;
+    detailOptions.orbitCacheMemory = (size_t) config->orbitCacheMemory * 1024 * 1024;
+
+    VirtualTexture::setTileMemoryBudget((size_t) config->virtualTextureMemory * 1024 * 1024);
+    if (config->textureMemory != 0)
+        GetTextureManager()->setMemoryBudget((size_t) config->textureMemory * 1024 * 1024);
+    if (config->modelMemory != 0)
+        GetGeometryManager()->setMemoryBudget((size_t) config->modelMemory * 1024 * 1024);
+    if (!config->textureCacheDir.empty())
+        EnableTextureCache(config->textureCacheDir);
 
     // Prepare the scene for rendering.
 #ifdef USE_GLCONTEXT
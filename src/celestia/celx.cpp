@@ -21,6 +21,7 @@
 #include <celengine/execution.h>
 #include <celengine/timeline.h>
 #include <celengine/timelinephase.h>
+#include <celephem/scriptobject.h>
 #include <fmt/printf.h>
 #include "imagecapture.h"
 #include "url.h"
@@ -1425,6 +1426,10 @@ bool LuaState::callLuaHook(void* obj, const char* method)
     if (!eventHandlerEnabled)
         return false;
 
+    // The hook state may also be the context of scripted orbits and
+    // rotations, which can be evaluated on worker threads.
+    ScriptedObjectLock lock;
+
     lua_pushlightuserdata(costate, obj);
     lua_gettable(costate, LUA_REGISTRYINDEX);
     if (!lua_istable(costate, -1))
@@ -1466,6 +1471,8 @@ bool LuaState::callLuaHook(void* obj, const char* method, const char* keyName)
     if (!eventHandlerEnabled)
         return false;
 
+    ScriptedObjectLock lock;
+
     lua_pushlightuserdata(costate, obj);
     lua_gettable(costate, LUA_REGISTRYINDEX);
     if (!lua_istable(costate, -1))
@@ -1509,6 +1516,8 @@ bool LuaState::callLuaHook(void* obj, const char* method, float x, float y)
     if (!eventHandlerEnabled)
         return false;
 
+    ScriptedObjectLock lock;
+
     lua_pushlightuserdata(costate, obj);
     lua_gettable(costate, LUA_REGISTRYINDEX);
     if (!lua_istable(costate, -1))
@@ -1553,6 +1562,8 @@ bool LuaState::callLuaHook(void* obj, const char* method, float x, float y, int
     if (!eventHandlerEnabled)
         return false;
 
+    ScriptedObjectLock lock;
+
     lua_pushlightuserdata(costate, obj);
     lua_gettable(costate, LUA_REGISTRYINDEX);
     if (!lua_istable(costate, -1))
@@ -1598,6 +1609,8 @@ bool LuaState::callLuaHook(void* obj, const char* method, double dt)
     if (!eventHandlerEnabled)
         return false;
 
+    ScriptedObjectLock lock;
+
     lua_pushlightuserdata(costate, obj);
     lua_gettable(costate, LUA_REGISTRYINDEX);
     if (!lua_istable(costate, -1))
@@ -21,6 +21,7 @@
 #include <celengine/planetgrid.h>
 #include <celengine/multitexture.h>
 #include "celestiacore.h"
+#include "occultationfinder.h"
 
 using namespace Eigen;
 using namespace std;
@@ -1218,6 +1219,94 @@ static int object_getphase(lua_State* l)
 }
 
 
+/*! object:findoccultations(table: objects, number: starttime, number: endtime [, string: types])
+*
+* Find the transits and occultations among a list of objects as seen
+* from this object, which may be a body, a surface location or a star.
+* types is "transits", "occultations" or "all" (the default.) The result
+* is an array of tables in chronological order, each with the fields
+* type ("transit" or "occultation"), foreground, background, starttime
+* and endtime.
+*
+* \verbatim
+* -- Example: find the mutual events of the Galilean satellites seen
+* -- from Earth during 2021.
+* --
+* earth = celestia:find("Sol/Earth")
+* moons = { celestia:find("Sol/Jupiter/Io"), celestia:find("Sol/Jupiter/Europa"),
+*           celestia:find("Sol/Jupiter/Ganymede"), celestia:find("Sol/Jupiter/Callisto") }
+* events = earth:findoccultations(moons, celestia:utctotdb(2021, 1, 1),
+*                                 celestia:utctotdb(2022, 1, 1))
+*
+* \endverbatim
+*/
+static int object_findoccultations(lua_State* l)
+{
+    CelxLua celx(l);
+    celx.checkArgs(4, 5, "Three or four arguments expected for object:findoccultations");
+
+    Selection* sel = this_object(l);
+
+    if (!lua_istable(l, 2))
+    {
+        celx.doError("First argument to object:findoccultations must be a table");
+        return 0;
+    }
+
+    vector<Selection> objects;
+    lua_pushnil(l);
+    while (lua_next(l, 2) != 0)
+    {
+        Selection* obj = to_object(l, -1);
+        if (obj == nullptr)
+        {
+            celx.doError("Table argument to object:findoccultations must contain objects");
+            return 0;
+        }
+        objects.push_back(*obj);
+        lua_pop(l, 1);
+    }
+
+    double startTime = celx.safeGetNumber(3, AllErrors, "Second argument to object:findoccultations must be a number");
+    double endTime = celx.safeGetNumber(4, AllErrors, "Third argument to object:findoccultations must be a number");
+    const char* types = celx.safeGetString(5, WrongType, "Fourth argument to object:findoccultations must be a string");
+
+    int typeMask = OccultationEvent::Transit | OccultationEvent::Occultation;
+    if (types != nullptr)
+    {
+        if (strcmp(types, "transits") == 0)
+            typeMask = OccultationEvent::Transit;
+        else if (strcmp(types, "occultations") == 0)
+            typeMask = OccultationEvent::Occultation;
+        else if (strcmp(types, "all") != 0)
+            celx.doError("Unknown event type passed to object:findoccultations");
+    }
+
+    vector<OccultationEvent> events;
+    OccultationFinder finder(*sel);
+    finder.findEvents(objects, startTime, endTime, typeMask, events);
+
+    lua_createtable(l, events.size(), 0);
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const OccultationEvent& event = events[i];
+        lua_newtable(l);
+        celx.setTable("type", event.type == OccultationEvent::Transit ? "transit" : "occultation");
+        lua_pushstring(l, "foreground");
+        object_new(l, event.foreground);
+        lua_settable(l, -3);
+        lua_pushstring(l, "background");
+        object_new(l, event.background);
+        lua_settable(l, -3);
+        celx.setTable("starttime", event.startTime);
+        celx.setTable("endtime", event.endTime);
+        lua_rawseti(l, -2, i + 1);
+    }
+
+    return 1;
+}
+
+
 // Phases iterator function; two upvalues expected. Used by
 // object:phases method.
 static int object_phases_iter(lua_State* l)
@@ -1404,6 +1493,7 @@ void CreateObjectMetaTable(lua_State* l)
     celx.registerMethod("bodyframe", object_bodyframe);
     celx.registerMethod("getphase", object_getphase);
     celx.registerMethod("phases", object_phases);
+    celx.registerMethod("findoccultations", object_findoccultations);
     celx.registerMethod("preloadtexture", object_preloadtexture);
     celx.registerMethod("setringstexture", object_setringstexture);
     celx.registerMethod("gettemperature", object_gettemperature);
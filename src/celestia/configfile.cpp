@@ -138,6 +138,12 @@ CelestiaConfig* ReadCelestiaConfig(const string& filename, CelestiaConfig *confi
     config->orbitPathSamplePoints = getUint(configParams, "OrbitPathSamplePoints", 100);
     config->shadowTextureSize = getUint(configParams, "ShadowTextureSize", 256);
     config->eclipseTextureSize = getUint(configParams, "EclipseTextureSize", 128);
+    config->virtualTextureMemory = getUint(configParams, "VirtualTextureMemory", 512);
+    config->textureMemory = getUint(configParams, "TextureMemory", 0);
+    config->modelMemory = getUint(configParams, "ModelMemory", 0);
+    config->orbitCacheMemory = getUint(configParams, "OrbitCacheMemory", 16);
+    configParams->getString("TextureCache", config->textureCacheDir);
+    config->textureCacheDir = WordExp(config->textureCacheDir);
 
     config->consoleLogRows = getUint(configParams, "LogSize", 200);
 
@@ -62,6 +62,11 @@ public:
     unsigned int shadowTextureSize;
     unsigned int eclipseTextureSize;
     unsigned int orbitPathSamplePoints;
+    unsigned int virtualTextureMemory; // MB
+    unsigned int textureMemory; // MB, 0 for unlimited
+    unsigned int modelMemory; // MB, 0 for unlimited
+    unsigned int orbitCacheMemory; // MB
+    std::string textureCacheDir;
 
     unsigned int aaSamples;
 
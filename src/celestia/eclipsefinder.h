@@ -20,8 +20,9 @@ struct Eclipse
 {
     // values must be 2^n
     enum Type {
-        Solar = 0x01,
-        Lunar = 0x02
+        Solar  = 0x01,
+        Lunar  = 0x02,
+        Mutual = 0x04
     };
 
     Body* occulter{ nullptr };
@@ -48,6 +49,11 @@ class EclipseFinder
  public:
     EclipseFinder(Body*, EclipseFinderWatcher* = nullptr);
 
+    /*! Set the precision in days of the eclipse start and end times. The
+     *  default is ten seconds.
+     */
+    void setPrecision(double precision);
+
     void findEclipses(double startDate,
                       double endDate,
                       int eclipseTypeMask,
@@ -55,6 +61,7 @@ class EclipseFinder
  private:
     Body* body;
     EclipseFinderWatcher* watcher;
+    double precision;
 };
 #endif // _ECLIPSEFINDER_H_
 
@@ -0,0 +1,292 @@
+// eventsearch.cpp
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Search for the time intervals during which a function of time is
+// negative, as for eclipses, transits and occultations.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "eventsearch.h"
+#include "celutil/threadpool.h"
+#ifdef CELX
+#include <celephem/scriptobject.h>
+#endif
+
+using namespace std;
+
+
+// Event functions have a single minimum per period of the geometry.
+// Sampling them this many times per period is enough to bracket every
+// minimum, which is then refined to see whether it is an event.
+constexpr const int SamplesPerPeriod = 16;
+constexpr const double MinSearchStep = 1.0 / 1440.0;    // one minute
+constexpr const double DefaultSearchStep = 1.0 / 24.0;  // one hour
+
+const double EventSearch::MaxStep = 1.0;                // one day
+
+// The search is split into this many slices; progress is reported and
+// the search may be aborted between slices.
+constexpr const int SearchSlices = 200;
+
+// Give up extending an event after this many search steps; it only
+// happens for events lasting most of the period, such as a body that
+// stays in shadow for most of its orbit.
+constexpr const int MaxEventSteps = 1000;
+
+
+EventSearch::EventSearch(const Function& _f,
+                         double _startDate,
+                         double _endDate,
+                         double _step,
+                         double _precision) :
+    f(_f),
+    startDate(_startDate),
+    endDate(_endDate),
+    step(_step),
+    precision(_precision),
+    lastEventEnd(-numeric_limits<double>::infinity())
+{
+}
+
+
+// Choose a sampling step from the period with which the geometry
+// repeats, for example the synodic period of two satellites.
+double EventSearch::stepForPeriod(double period)
+{
+    if (!(period > 0.0) || isinf(period))
+        return DefaultSearchStep;
+
+    return min(max(period / SamplesPerPeriod, MinSearchStep), MaxStep);
+}
+
+
+bool EventSearch::inEvent(double t) const
+{
+    bool valid = false;
+    return f(t, valid) < 0.0 && valid;
+}
+
+
+// Given a time tIn during an event and a time tOut outside of it, find
+// the contact time between them with a binary search. The returned time
+// is always one when the event is /not/ in progress.
+double EventSearch::findContact(double tIn, double tOut) const
+{
+    while (abs(tOut - tIn) > precision)
+    {
+        double t = 0.5 * (tIn + tOut);
+        if (inEvent(t))
+            tIn = t;
+        else
+            tOut = t;
+    }
+
+    return tOut;
+}
+
+
+// Find the start and end of the event in progress at time t.
+EventInterval EventSearch::findEvent(double t) const
+{
+    double before = t - step;
+    for (int i = 0; i < MaxEventSteps && inEvent(before); i++)
+        before -= step;
+
+    double after = t + step;
+    for (int i = 0; i < MaxEventSteps && inEvent(after); i++)
+        after += step;
+
+    EventInterval event;
+    event.startTime = findContact(t, before);
+    event.endTime = findContact(t, after);
+
+    return event;
+}
+
+
+// Minimize the event function over [a, b] with a golden section search,
+// stopping as soon as a time during an event is found. Returns false if
+// there is no event around the minimum.
+bool EventSearch::findEventTime(double a, double b, double tolerance, double& eventTime) const
+{
+    const double g = 0.5 * (sqrt(5.0) - 1.0);
+    bool valid = false;
+
+    double c = b - g * (b - a);
+    double fc = f(c, valid);
+    if (fc < 0.0 && valid)
+    {
+        eventTime = c;
+        return true;
+    }
+
+    double d = a + g * (b - a);
+    double fd = f(d, valid);
+    if (fd < 0.0 && valid)
+    {
+        eventTime = d;
+        return true;
+    }
+
+    while (b - a > tolerance)
+    {
+        if (fc < fd)
+        {
+            b = d;
+            d = c;
+            fd = fc;
+            c = b - g * (b - a);
+            fc = f(c, valid);
+            if (fc < 0.0 && valid)
+            {
+                eventTime = c;
+                return true;
+            }
+        }
+        else
+        {
+            a = c;
+            c = d;
+            fc = fd;
+            d = a + g * (b - a);
+            fd = f(d, valid);
+            if (fd < 0.0 && valid)
+            {
+                eventTime = d;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+
+//! Report an event that is already in progress at the start date.
+void EventSearch::start()
+{
+    if (inEvent(startDate))
+    {
+        EventInterval event = findEvent(startDate);
+        events.push_back(event);
+        lastEventEnd = event.endTime;
+    }
+}
+
+
+/*! Sample the event function up to the given fraction of the search
+ *  interval, and examine every local minimum that is found.
+ */
+void EventSearch::advance(double fraction)
+{
+    double sliceEnd = fraction >= 1.0 ? numeric_limits<double>::infinity() :
+                      startDate + fraction * (endDate - startDate);
+
+    for (;;)
+    {
+        double t = startDate + (double) nextSample * step;
+        // One sample past the end date is needed to detect a minimum
+        // near the end.
+        if (t > sliceEnd || t > endDate + step)
+            break;
+        nextSample++;
+
+        bool valid = false;
+        double value = f(t, valid);
+        if (nSamples >= 2 && f1 < f0 && f1 <= value)
+            examineMinimum(t - 2.0 * step, t);
+
+        f0 = f1;
+        f1 = value;
+        nSamples++;
+    }
+}
+
+
+void EventSearch::examineMinimum(double a, double b)
+{
+    if (b <= lastEventEnd)
+        return;
+
+    double t;
+    if (!findEventTime(max(a, lastEventEnd), b, max(precision, step / 64.0), t))
+        return;
+
+    EventInterval event = findEvent(t);
+    if (event.startTime <= endDate && event.endTime > lastEventEnd)
+    {
+        events.push_back(event);
+        lastEventEnd = event.endTime;
+    }
+}
+
+
+void RunEventSearches(vector<EventSearch>& searches,
+                      const function<bool(double)>& progress)
+{
+    // Event functions may evaluate scripted orbits and rotations. When the
+    // caller is running script code, it holds the script lock and workers
+    // evaluating them would wait for it forever, so search serially.
+    bool serial = false;
+#ifdef CELX
+    serial = ScriptedObjectLock::heldByCurrentThread();
+#endif
+
+    ThreadPool* threadPool = GetThreadPool();
+    auto forEachSearch = [&](const function<void(size_t)>& f)
+    {
+        if (serial)
+        {
+            for (size_t i = 0; i < searches.size(); i++)
+                f(i);
+        }
+        else
+        {
+            threadPool->parallelFor(0, searches.size(), f);
+        }
+    };
+
+    forEachSearch([&](size_t i)
+    {
+        searches[i].start();
+    });
+
+    for (int slice = 1; slice <= SearchSlices; slice++)
+    {
+        double fraction = (double) slice / (double) SearchSlices;
+        forEachSearch([&](size_t i)
+        {
+            searches[i].advance(fraction);
+        });
+
+        if (progress && !progress(fraction))
+            break;
+    }
+}
+
+
+void MergeEvents(vector<EventInterval>& events)
+{
+    if (events.empty())
+        return;
+
+    sort(events.begin(), events.end(),
+         [](const EventInterval& e0, const EventInterval& e1) { return e0.startTime < e1.startTime; });
+
+    size_t n = 0;
+    for (size_t i = 1; i < events.size(); i++)
+    {
+        if (events[i].startTime <= events[n].endTime)
+            events[n].endTime = max(events[n].endTime, events[i].endTime);
+        else
+            events[++n] = events[i];
+    }
+    events.resize(n + 1);
+}
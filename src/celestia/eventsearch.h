@@ -0,0 +1,94 @@
+// eventsearch.h
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Search for the time intervals during which a function of time is
+// negative, as for eclipses, transits and occultations.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+
+struct EventInterval
+{
+    double startTime;
+    double endTime;
+};
+
+
+/*! An EventSearch finds the intervals within [startDate, endDate] during
+ *  which an event function is negative. The function is sampled at a fixed
+ *  step, which must be short enough that every event lies around a local
+ *  minimum of the sampled values; each minimum is refined with a golden
+ *  section search and the contact times found by bisection. The function
+ *  also reports whether the configuration is valid at all (for example,
+ *  bodies with intersecting bounding spheres don't eclipse each other.)
+ *
+ *  Separate searches are independent and may be advanced from several
+ *  threads at once; see RunEventSearches().
+ */
+class EventSearch
+{
+ public:
+    using Function = std::function<double(double t, bool& valid)>;
+
+    EventSearch(const Function& f,
+                double startDate,
+                double endDate,
+                double step,
+                double precision);
+
+    void start();
+    void advance(double fraction);
+
+    const std::vector<EventInterval>& getEvents() const { return events; }
+
+    //! Choose a sampling step for events that repeat with the given period.
+    static double stepForPeriod(double period);
+
+    //! The longest step returned by stepForPeriod()
+    static const double MaxStep;
+
+ private:
+    bool inEvent(double t) const;
+    double findContact(double tIn, double tOut) const;
+    EventInterval findEvent(double t) const;
+    bool findEventTime(double a, double b, double tolerance, double& t) const;
+    void examineMinimum(double a, double b);
+
+    Function f;
+    double startDate;
+    double endDate;
+    double step;
+    double precision;
+
+    long nextSample{ 0 };
+    int nSamples{ 0 };
+    double f0{ 0.0 };
+    double f1{ 0.0 };
+
+    double lastEventEnd;
+    std::vector<EventInterval> events;
+};
+
+
+/*! Run the searches over their intervals in parallel. The intervals are
+ *  divided into slices, and progress is called with the fraction of the
+ *  work done after each slice; it may return false to abort the search.
+ *  The searches are run serially when called from script code, which
+ *  holds the lock needed to evaluate scripted orbits and rotations.
+ */
+void RunEventSearches(std::vector<EventSearch>& searches,
+                      const std::function<bool(double)>& progress);
+
+/*! Sort events by start time and merge those that overlap, as reported
+ *  by searches over adjacent intervals.
+ */
+void MergeEvents(std::vector<EventInterval>& events);
@@ -0,0 +1,225 @@
+// occultationfinder.cpp
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Find transits and occultations of one object by another as seen from
+// an observer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "occultationfinder.h"
+#include "eventsearch.h"
+#include <celengine/body.h>
+#include <celengine/location.h>
+#include <celutil/threadpool.h>
+
+using namespace Eigen;
+using namespace std;
+
+
+// Split the search of each pair into enough intervals to give every
+// thread two of them, but don't make the intervals shorter than this
+// many sampling steps.
+constexpr const int MinStepsPerInterval = 64;
+
+
+OccultationFinder::OccultationFinder(const Selection& _observer) :
+    observer(_observer),
+    precision(1.0 / (24.0 * 360.0)) // ten seconds
+{
+}
+
+
+void OccultationFinder::setPrecision(double _precision)
+{
+    precision = _precision;
+}
+
+
+void OccultationFinder::setProgressCallback(const function<bool(double)>& _progress)
+{
+    progress = _progress;
+}
+
+
+static Body* parentBody(const Selection& sel)
+{
+    if (sel.location() != nullptr)
+        return sel.location()->getParentBody();
+    return sel.body();
+}
+
+
+// Return the angle between the centers of two objects as seen from the
+// observer, minus the sum of their angular radii. The disks overlap when
+// the value is negative. Events seen from inside either object are not
+// valid.
+static double diskSeparation(const Selection& observer,
+                             const Selection& a,
+                             const Selection& b,
+                             double t,
+                             bool& valid)
+{
+    UniversalCoord origin = observer.getPosition(t);
+    Vector3d pa = a.getPosition(t).offsetFromKm(origin);
+    Vector3d pb = b.getPosition(t).offsetFromKm(origin);
+    double da = pa.norm();
+    double db = pb.norm();
+    double ra = a.radius();
+    double rb = b.radius();
+
+    valid = da > ra && db > rb;
+
+    double separation = atan2(pa.cross(pb).norm(), pa.dot(pb));
+    return separation - asin(min(1.0, ra / da)) - asin(min(1.0, rb / db));
+}
+
+
+// Shortest period with which the geometry of the observer and the two
+// objects changes: the orbital periods of the bodies involved, and the
+// rotation period of the body an observer on the surface stands on.
+static double geometryPeriod(const Selection& observer,
+                             const Selection& a,
+                             const Selection& b,
+                             double t)
+{
+    double period = numeric_limits<double>::infinity();
+    auto update = [&period](double p)
+    {
+        if (p > 0.0)
+            period = min(period, p);
+    };
+
+    for (const Selection* sel : { &observer, &a, &b })
+    {
+        const Body* body = parentBody(*sel);
+        if (body != nullptr && body->getOrbit(t) != nullptr)
+            update(body->getOrbit(t)->getPeriod());
+    }
+
+    const Body* ground = observer.location() != nullptr ? parentBody(observer) : nullptr;
+    if (ground != nullptr && ground->getRotationModel(t) != nullptr)
+        update(ground->getRotationModel(t)->getPeriod());
+
+    return period;
+}
+
+
+void OccultationFinder::findEvents(const vector<Selection>& objects,
+                                   double startDate,
+                                   double endDate,
+                                   int eventTypeMask,
+                                   vector<OccultationEvent>& events)
+{
+    // Objects that the observer is standing on or at the center of can't
+    // take part in an event.
+    const Body* observerBody = parentBody(observer);
+    vector<Selection> candidates;
+    for (const auto& sel : objects)
+    {
+        if (sel.empty() || sel == observer ||
+            (observerBody != nullptr && sel.body() == observerBody))
+        {
+            continue;
+        }
+        if (find(candidates.begin(), candidates.end(), sel) == candidates.end())
+            candidates.push_back(sel);
+    }
+
+    vector<pair<Selection, Selection>> pairs;
+    for (size_t i = 0; i < candidates.size(); i++)
+        for (size_t j = i + 1; j < candidates.size(); j++)
+            pairs.emplace_back(candidates[i], candidates[j]);
+
+    if (pairs.empty() || !(endDate > startDate))
+        return;
+
+    size_t nWorkers = GetThreadPool()->threadCount() + 1;
+    size_t intervalsPerPair = max((size_t) 1, (2 * nWorkers + pairs.size() - 1) / pairs.size());
+
+    // The searches of pair i are searchStart[i] to searchStart[i + 1]
+    vector<size_t> searchStart;
+    vector<EventSearch> searches;
+    for (const auto& p : pairs)
+    {
+        searchStart.push_back(searches.size());
+
+        const Selection& a = p.first;
+        const Selection& b = p.second;
+        Selection obs = observer;
+        auto f = [obs, a, b](double t, bool& valid)
+        {
+            return diskSeparation(obs, a, b, t, valid);
+        };
+
+        double step = EventSearch::stepForPeriod(geometryPeriod(observer, a, b, startDate));
+        size_t maxIntervals = (size_t) ((endDate - startDate) / (step * MinStepsPerInterval));
+        size_t nIntervals = min(intervalsPerPair, max((size_t) 1, maxIntervals));
+        double length = (endDate - startDate) / (double) nIntervals;
+        for (size_t k = 0; k < nIntervals; k++)
+        {
+            double start = startDate + (double) k * length;
+            double end = k + 1 == nIntervals ? endDate : start + length;
+            searches.emplace_back(f, start, end, step, precision);
+        }
+    }
+    searchStart.push_back(searches.size());
+
+    RunEventSearches(searches, [&](double fraction)
+    {
+        return !progress || progress(startDate + fraction * (endDate - startDate));
+    });
+
+    size_t firstNew = events.size();
+    for (size_t i = 0; i < pairs.size(); i++)
+    {
+        // Events crossing the boundary between two intervals are found by
+        // both searches.
+        vector<EventInterval> intervals;
+        for (size_t k = searchStart[i]; k < searchStart[i + 1]; k++)
+        {
+            const auto& found = searches[k].getEvents();
+            intervals.insert(intervals.end(), found.begin(), found.end());
+        }
+        MergeEvents(intervals);
+
+        for (const auto& interval : intervals)
+        {
+            // Classify the event by the geometry at mid-event
+            double t = 0.5 * (interval.startTime + interval.endTime);
+            UniversalCoord origin = observer.getPosition(t);
+            Selection a = pairs[i].first;
+            Selection b = pairs[i].second;
+            double da = a.getPosition(t).offsetFromKm(origin).norm();
+            double db = b.getPosition(t).offsetFromKm(origin).norm();
+            if (db < da)
+            {
+                swap(a, b);
+                swap(da, db);
+            }
+
+            OccultationEvent event;
+            event.foreground = a;
+            event.background = b;
+            event.type = a.radius() / da < b.radius() / db ? OccultationEvent::Transit :
+                                                             OccultationEvent::Occultation;
+            event.startTime = interval.startTime;
+            event.endTime = interval.endTime;
+
+            if ((event.type & eventTypeMask) != 0)
+                events.push_back(event);
+        }
+    }
+
+    stable_sort(events.begin() + firstNew, events.end(),
+                [](const OccultationEvent& e0, const OccultationEvent& e1)
+                {
+                    return e0.startTime < e1.startTime;
+                });
+}
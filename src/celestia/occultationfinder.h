@@ -0,0 +1,78 @@
+// occultationfinder.h
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Find transits and occultations of one object by another as seen from
+// an observer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <celengine/selection.h>
+
+
+struct OccultationEvent
+{
+    // values must be 2^n
+    enum Type
+    {
+        Transit     = 0x01,
+        Occultation = 0x02,
+    };
+
+    Type type{ Transit };
+
+    // The nearer and farther of the two objects
+    Selection foreground;
+    Selection background;
+
+    double startTime{ 0.0 };
+    double endTime{ 0.0 };
+};
+
+
+/*! OccultationFinder searches for the times when the disk of one object
+ *  overlaps the disk of another as seen from an observer, which may be any
+ *  selection with a position: a body, a location on a body's surface or a
+ *  star. The event is a transit when the nearer object appears smaller than
+ *  the farther one (Venus across the Sun, a moon across its planet) and an
+ *  occultation otherwise (the Moon covering a planet.) Mutual events of two
+ *  satellites are found the same way. Objects are treated as spheres and
+ *  light time is ignored.
+ *
+ *  Every pair of candidate objects is searched, split into several time
+ *  intervals so that long searches of few pairs are also run in parallel.
+ */
+class OccultationFinder
+{
+ public:
+    OccultationFinder(const Selection& observer);
+
+    /*! Set the precision in days of the event start and end times. The
+     *  default is ten seconds.
+     */
+    void setPrecision(double precision);
+
+    /*! Set a function called with the time searched so far; it returns
+     *  false to abort the search. Events found before the search is
+     *  aborted are still reported.
+     */
+    void setProgressCallback(const std::function<bool(double)>& progress);
+
+    void findEvents(const std::vector<Selection>& objects,
+                    double startDate,
+                    double endDate,
+                    int eventTypeMask,
+                    std::vector<OccultationEvent>& events);
+
+ private:
+    Selection observer;
+    double precision;
+    std::function<bool(double)> progress;
+};
@@ -45,7 +45,7 @@ static unsigned int bswap_32(uint32_t val) {
     (((val) & 0x0000ff00) <<  8) | (((val) & 0x000000ff) << 24);
 }
 
-static unsigned int bswap_64(uint64_t val) {
+static uint64_t bswap_64(uint64_t val) {
   return (((val & 0xff00000000000000ull) >> 56) |
           ((val & 0x00ff000000000000ull) >> 40) |
           ((val & 0x0000ff0000000000ull) >> 24) |
@@ -86,6 +86,8 @@ inline double bswap_double(double d)
 
 #define LE_TO_CPU_INT32(ret, val) (ret = bswap_32(val))
 
+#define LE_TO_CPU_INT64(ret, val) (ret = bswap_64(val))
+
 #define LE_TO_CPU_FLOAT(ret, val) SWAP_FLOAT(ret, val)
 
 #define LE_TO_CPU_DOUBLE(ret, val) (ret = bswap_double(d))
@@ -112,6 +114,8 @@ inline double bswap_double(double d)
 
 #define LE_TO_CPU_INT32(ret, val) (ret = val)
 
+#define LE_TO_CPU_INT64(ret, val) (ret = val)
+
 #define LE_TO_CPU_FLOAT(ret, val) (ret = val)
 
 #define LE_TO_CPU_DOUBLE(ret, val) (ret = val)
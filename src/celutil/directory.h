@@ -10,6 +10,7 @@
 #ifndef _CELUTIL_DIRECTORY_H_
 #define _CELUTIL_DIRECTORY_H_
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -43,6 +44,10 @@ class Directory
 extern std::string WordExp(const std::string&);
 extern Directory* OpenDirectory(const std::string&);
 extern bool IsDirectory(const std::string&);
+//! Create a directory and its parents; succeeds if it already exists.
+extern bool MakeDirectory(const std::string&);
+//! Get the time a file was last modified, in units that depend on the platform.
+extern bool GetModificationTime(const std::string&, std::int64_t& mtime);
 
 
 #endif // _CELUTIL_DIRECTORY_H_
@@ -0,0 +1,41 @@
+// mappedfile.h
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Read-only memory mapping of a whole file.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+
+/*! A MappedFile maps the contents of a file into memory for reading. Pages
+ *  are read from disk by the operating system when they are first
+ *  accessed, so large archives can be opened without reading them, and
+ *  the data may be read from several threads at once.
+ */
+class MappedFile
+{
+ public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& filename);
+    void close();
+
+    bool isOpen() const { return data != nullptr; }
+    const unsigned char* getData() const { return data; }
+    std::size_t getSize() const { return size; }
+
+ private:
+    const unsigned char* data{ nullptr };
+    std::size_t size{ 0 };
+};
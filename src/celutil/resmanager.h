@@ -10,16 +10,27 @@
 #ifndef _CELUTIL_RESMANAGER_H_
 #define _CELUTIL_RESMANAGER_H_
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <limits>
+#include <list>
+#include <set>
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 #include <celutil/reshandle.h>
+#include <celutil/threadpool.h>
 
 
 enum ResourceState {
     ResourceNotLoaded     = 0,
     ResourceLoaded        = 1,
     ResourceLoadingFailed = 2,
+    ResourceLoading       = 3,
 };
 
 
@@ -32,6 +43,22 @@ template<class T> class ResourceInfo
     virtual std::string resolve(const std::string&) = 0;
     virtual T* load(const std::string&) = 0;
 
+    /*! Resources that can be loaded in the background override these to
+     *  split loading in two steps. loadAsync() is called on a worker
+     *  thread, with a copy of the resource info; the function it returns
+     *  is called later on the thread using the resource manager, and
+     *  completes loading--creating a texture from a decoded image, for
+     *  example. An empty function means that loading failed.
+     */
+    virtual bool hasAsyncLoad() const { return false; }
+    virtual std::function<T*()> loadAsync(const std::string&) { return nullptr; }
+
+    /*! Return the memory used by the loaded resource in bytes. Resources
+     *  that report zero are never released to keep within the memory
+     *  budget of the manager.
+     */
+    virtual std::size_t getMemoryUsage() const { return 0; }
+
     typedef T ResourceType;
     ResourceState state;
     std::string resolvedName;
@@ -39,6 +66,16 @@ template<class T> class ResourceInfo
 };
 
 
+/*! A ResourceManager loads resources when they are first needed, and
+ *  shares them between all handles that resolve to the same name. It is
+ *  used from a single thread; only the first step of background loads
+ *  runs on the loader threads.
+ *
+ *  The manager can be given a memory budget. When the resources it holds
+ *  use more than that, endFrame() releases the least recently used ones;
+ *  find() loads them again if they're needed later, so pointers returned
+ *  by find() must not be kept beyond the frame.
+ */
 template<class T> class ResourceManager
 {
  private:
@@ -52,9 +89,23 @@ template<class T> class ResourceManager
     typedef typename T::ResourceType ResourceType;
 
  private:
+    typedef std::function<ResourceType*()> LoadCompletion;
     typedef std::vector<T> ResourceTable;
     typedef std::map<T, ResourceHandle> ResourceHandleMap;
-    typedef std::map<std::string, ResourceType*> NameMap;
+
+    // Loaded resources are kept by resolved name. Those that report their
+    // memory usage are also linked in lruList, least recently used first,
+    // and moved to its end when found in a new frame.
+    typedef std::list<const std::string*> LruList;
+    struct LoadedResource
+    {
+        ResourceType* resource;
+        std::size_t size;
+        unsigned int lastUsed;
+        std::vector<ResourceHandle> handles;   // handles sharing the resource
+        typename LruList::iterator lruPos;
+    };
+    typedef std::map<std::string, LoadedResource> NameMap;
 
     typedef typename ResourceHandleMap::value_type ResourceHandleMapValue;
     typedef typename NameMap::value_type NameMapValue;
@@ -62,6 +113,185 @@ template<class T> class ResourceManager
     ResourceTable resources;
     ResourceHandleMap handles;
     NameMap loadedResources;
+    LruList lruList;
+    // Entry in loadedResources of each handle, or end() if not loaded
+    std::vector<typename NameMap::iterator> loadedEntries;
+
+    // Background loads, by resolved name. The first of the worker and a
+    // blocking find() to set started does the load, so a resource needed
+    // right away isn't kept waiting behind the loader queue.
+    struct PendingLoad
+    {
+        std::future<LoadCompletion> result;
+        std::shared_ptr<std::atomic<bool>> started;
+    };
+    std::map<std::string, PendingLoad> pendingLoads;
+    // Resolved names of resources that could not be loaded
+    std::set<std::string> failedLoads;
+
+    std::size_t memoryUsage{ 0 };
+    std::size_t memoryBudget{ std::numeric_limits<std::size_t>::max() };
+    unsigned int evictionDelay{ 100 };
+    unsigned int frame{ 0 };
+
+    // Make handle h refer to a loaded resource
+    void attach(ResourceHandle h, typename NameMap::iterator iter)
+    {
+        resources[h].resource = iter->second.resource;
+        resources[h].state = ResourceLoaded;
+        iter->second.handles.push_back(h);
+        loadedEntries[h] = iter;
+    }
+
+    void publish(ResourceHandle h, ResourceType* resource)
+    {
+        resources[h].resource = resource;
+        if (resource == nullptr)
+        {
+            resources[h].state = ResourceLoadingFailed;
+            failedLoads.insert(resources[h].resolvedName);
+            return;
+        }
+
+        std::size_t size = resources[h].getMemoryUsage();
+        auto result = loadedResources.insert(NameMapValue(resources[h].resolvedName,
+                                                          LoadedResource{ resource, size, frame, {}, lruList.end() }));
+        typename NameMap::iterator iter = result.first;
+        if (size != 0)
+            iter->second.lruPos = lruList.insert(lruList.end(), &iter->first);
+        memoryUsage += size;
+        attach(h, iter);
+    }
+
+    // Return the resource of handle h, and mark it as used in this frame
+    ResourceType* use(ResourceHandle h)
+    {
+        LoadedResource& loaded = loadedEntries[h]->second;
+        if (loaded.lastUsed != frame)
+        {
+            loaded.lastUsed = frame;
+            if (loaded.lruPos != lruList.end())
+                lruList.splice(lruList.end(), lruList, loaded.lruPos);
+        }
+        return loaded.resource;
+    }
+
+    // Release the least recently used resources until the memory usage is
+    // back under budget, or no more resources may be released.
+    void evict()
+    {
+        while (memoryUsage > memoryBudget && !lruList.empty())
+        {
+            typename NameMap::iterator iter = loadedResources.find(*lruList.front());
+            LoadedResource& loaded = iter->second;
+
+            // The rest of the list has been used even more recently
+            if (frame - loaded.lastUsed < evictionDelay)
+                break;
+
+            for (ResourceHandle h : loaded.handles)
+            {
+                resources[h].state = ResourceNotLoaded;
+                resources[h].resource = nullptr;
+                loadedEntries[h] = loadedResources.end();
+            }
+
+            memoryUsage -= loaded.size;
+            delete loaded.resource;
+            lruList.pop_front();
+            loadedResources.erase(iter);
+        }
+    }
+
+    // Resolve the name of a resource and load it, or with async set, start
+    // loading it in the background if it supports that.
+    void startLoad(ResourceHandle h, bool async)
+    {
+        T& info = resources[h];
+        info.resolvedName = info.resolve(baseDir);
+        typename NameMap::iterator iter = loadedResources.find(info.resolvedName);
+        if (iter != loadedResources.end())
+        {
+            attach(h, iter);
+        }
+        else if (pendingLoads.count(info.resolvedName) != 0)
+        {
+            // Resources with the same name are loaded only once
+            info.state = ResourceLoading;
+        }
+        else if (failedLoads.count(info.resolvedName) != 0)
+        {
+            info.resource = nullptr;
+            info.state = ResourceLoadingFailed;
+        }
+        else if (async && info.hasAsyncLoad())
+        {
+            info.state = ResourceLoading;
+            T worker(info);
+            std::string name = info.resolvedName;
+            auto started = std::make_shared<std::atomic<bool>>(false);
+            PendingLoad& pending = pendingLoads[name];
+            pending.started = started;
+            pending.result = GetLoaderThreadPool()->submit([worker, name, started]() mutable
+            {
+                if (started->exchange(true))
+                    return LoadCompletion();
+                return worker.loadAsync(name);
+            });
+        }
+        else
+        {
+            publish(h, info.load(info.resolvedName));
+        }
+    }
+
+    // Complete a background load once the worker is done, or with wait
+    // set, after waiting for it; a load that no worker has started yet is
+    // then done on this thread instead. The resource only becomes visible
+    // to find() here, on the thread using the manager.
+    void finishLoad(ResourceHandle h, bool wait)
+    {
+        T& info = resources[h];
+        typename NameMap::iterator iter = loadedResources.find(info.resolvedName);
+        if (iter != loadedResources.end())
+        {
+            // Completed for another handle with the same name
+            attach(h, iter);
+            return;
+        }
+
+        auto pending = pendingLoads.find(info.resolvedName);
+        if (pending == pendingLoads.end())
+        {
+            if (failedLoads.count(info.resolvedName) != 0)
+            {
+                // Failed for another handle with the same name
+                info.state = ResourceLoadingFailed;
+            }
+            else
+            {
+                // Completed for another handle with the same name, and
+                // released since to keep within the memory budget
+                info.state = ResourceNotLoaded;
+                startLoad(h, !wait);
+            }
+            return;
+        }
+
+        if (wait && !pending->second.started->exchange(true))
+        {
+            pendingLoads.erase(pending);
+            publish(h, info.load(info.resolvedName));
+            return;
+        }
+
+        if (!wait && pending->second.result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+
+        LoadCompletion complete = pending->second.result.get();
+        pendingLoads.erase(pending);
+        publish(h, complete ? complete() : nullptr);
+    }
 
  public:
     ResourceHandle getHandle(const T& info)
@@ -75,6 +305,7 @@ template<class T> class ResourceManager
         {
             ResourceHandle h = handles.size();
             resources.push_back(info);
+            loadedEntries.push_back(loadedResources.end());
             handles.insert(ResourceHandleMapValue(info, h));
             return h;
         }
@@ -89,37 +320,74 @@ template<class T> class ResourceManager
         else
         {
             if (resources[h].state == ResourceNotLoaded)
-            {
-                resources[h].resolvedName = resources[h].resolve(baseDir);
-                typename NameMap::iterator iter =
-                    loadedResources.find(resources[h].resolvedName);
-                if (iter != loadedResources.end())
-                {
-                    resources[h].resource = iter->second;
-                    resources[h].state = ResourceLoaded;
-                }
-                else
-                {
-                    resources[h].resource = resources[h].load(resources[h].resolvedName);
-                    if (resources[h].resource == nullptr)
-                    {
-                        resources[h].state = ResourceLoadingFailed;
-                    }
-                    else
-                    {
-                        resources[h].state = ResourceLoaded;
-                        loadedResources.insert(NameMapValue(resources[h].resolvedName, resources[h].resource));
-                    }
-                }
-            }
+                startLoad(h, false);
+            if (resources[h].state == ResourceLoading)
+                finishLoad(h, true);
 
-            if (resources[h].state == ResourceLoaded)
-                return resources[h].resource;
-            else
+            if (resources[h].state != ResourceLoaded)
                 return nullptr;
+
+            return use(h);
         }
     }
 
+    /*! Like find(), but without blocking: a resource that can be loaded in
+     *  the background is, and findAsync() returns nullptr with the state of
+     *  the resource ResourceLoading until it has been loaded. find() may be
+     *  called for a resource that is loading: it loads the resource itself
+     *  if no loader thread has started on it yet, or else waits for it.
+     */
+    ResourceType* findAsync(ResourceHandle h)
+    {
+        if (h >= (int) handles.size() || h < 0)
+            return nullptr;
+
+        if (resources[h].state == ResourceNotLoaded)
+            startLoad(h, true);
+        if (resources[h].state == ResourceLoading)
+            finishLoad(h, false);
+
+        if (resources[h].state != ResourceLoaded)
+            return nullptr;
+
+        return use(h);
+    }
+
+    ResourceState getState(ResourceHandle h) const
+    {
+        if (h >= (int) handles.size() || h < 0)
+            return ResourceLoadingFailed;
+        else
+            return resources[h].state;
+    }
+
+    /*! Set the memory in bytes that loaded resources may use before the
+     *  least recently used are released; unlimited by default.
+     */
+    void setMemoryBudget(std::size_t budget)
+    {
+        memoryBudget = budget;
+    }
+
+    //! Set the number of frames a resource must go unused before it may be released.
+    void setEvictionDelay(unsigned int frames)
+    {
+        evictionDelay = frames;
+    }
+
+    std::size_t getMemoryUsage() const
+    {
+        return memoryUsage;
+    }
+
+    //! Mark the end of a frame, releasing resources if over budget.
+    void endFrame()
+    {
+        frame++;
+        if (memoryUsage > memoryBudget)
+            evict();
+    }
+
     const T* getResourceInfo(ResourceHandle h)
     {
         if (h >= (int) handles.size() || h < 0)
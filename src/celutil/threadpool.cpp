@@ -0,0 +1,93 @@
+// threadpool.cpp
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Pool of worker threads for background and data parallel work.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "threadpool.h"
+
+using namespace std;
+
+
+static ThreadPool* CreateThreadPool()
+{
+    // The thread calling parallelFor takes part in the work, so one worker
+    // fewer than the number of cores keeps them all busy.
+    unsigned int n = thread::hardware_concurrency();
+    return new ThreadPool(n > 1 ? n - 1 : 0);
+}
+
+
+ThreadPool* GetThreadPool()
+{
+    // Initialization of a local static is thread safe
+    static ThreadPool* threadPool = CreateThreadPool();
+    return threadPool;
+}
+
+
+ThreadPool* GetLoaderThreadPool()
+{
+    static ThreadPool* loaderThreadPool = new ThreadPool(2);
+    return loaderThreadPool;
+}
+
+
+ThreadPool::ThreadPool(unsigned int nThreads)
+{
+    for (unsigned int i = 0; i < nThreads; i++)
+        threads.emplace_back(&ThreadPool::run, this);
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    available.notify_all();
+
+    for (auto& t : threads)
+        t.join();
+}
+
+
+void ThreadPool::enqueue(function<void()> task)
+{
+    if (threads.empty())
+    {
+        task();
+        return;
+    }
+
+    {
+        lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    available.notify_one();
+}
+
+
+void ThreadPool::run()
+{
+    for (;;)
+    {
+        function<void()> task;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            // Queued work is finished before the pool shuts down
+            if (tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
@@ -0,0 +1,130 @@
+// threadpool.h
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Pool of worker threads for background and data parallel work.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+class ThreadPool
+{
+ public:
+    /*! Create a pool with nThreads workers. With nThreads = 0 no worker
+     *  threads are created and all work runs on the calling thread.
+     */
+    explicit ThreadPool(unsigned int nThreads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned int threadCount() const
+    {
+        return (unsigned int) threads.size();
+    }
+
+    /*! Queue a task and return a future for its result. */
+    template<class F> std::future<typename std::result_of<F()>::type> submit(F f)
+    {
+        typedef typename std::result_of<F()>::type R;
+        auto task = std::make_shared<std::packaged_task<R()>>(std::move(f));
+        std::future<R> result = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    /*! Call f(i) for every i in [begin, end) and wait until all calls have
+     *  finished. The calling thread takes part in the work, so parallelFor
+     *  may safely be nested inside tasks running on the pool.
+     */
+    template<class F> void parallelFor(std::size_t begin, std::size_t end, F f)
+    {
+        if (end <= begin)
+            return;
+
+        std::size_t n = end - begin;
+        if (threads.empty() || n == 1)
+        {
+            for (std::size_t i = begin; i < end; i++)
+                f(i);
+            return;
+        }
+
+        struct State
+        {
+            std::atomic<std::size_t> next;
+            std::atomic<std::size_t> done;
+            std::mutex mutex;
+            std::condition_variable finished;
+        };
+
+        auto state = std::make_shared<State>();
+        state->next = begin;
+        state->done = 0;
+
+        // Helpers that start after every index has been claimed return
+        // without touching f, so capturing it by reference is safe.
+        auto work = [state, end, n, &f]()
+        {
+            std::size_t i;
+            while ((i = state->next.fetch_add(1)) < end)
+            {
+                f(i);
+                if (state->done.fetch_add(1) + 1 == n)
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->finished.notify_all();
+                }
+            }
+        };
+
+        std::size_t helpers = std::min(threads.size(), n - 1);
+        for (std::size_t i = 0; i < helpers; i++)
+            enqueue(work);
+        work();
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&state, n]() { return state->done == n; });
+    }
+
+ private:
+    void enqueue(std::function<void()> task);
+    void run();
+
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping{ false };
+};
+
+/*! Return the pool shared by the whole application. It has one worker less
+ *  than the number of hardware threads, as the thread waiting for results
+ *  usually takes part in the work.
+ */
+extern ThreadPool* GetThreadPool();
+
+/*! Return the pool for loading resources in the background. Its tasks
+ *  spend most of their time waiting for file reads, so they are kept off
+ *  the pool for per-frame work.
+ */
+extern ThreadPool* GetLoaderThreadPool();
@@ -0,0 +1,116 @@
+// timecache.h
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Small fixed size cache of values keyed by time.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <mutex>
+
+
+struct TimeCacheStatistics
+{
+    uint64_t hits{ 0 };
+    uint64_t misses{ 0 };
+
+    double hitRate() const
+    {
+        uint64_t total = hits + misses;
+        return total == 0 ? 0.0 : (double) hits / (double) total;
+    }
+
+    TimeCacheStatistics& operator+=(const TimeCacheStatistics& other)
+    {
+        hits += other.hits;
+        misses += other.misses;
+        return *this;
+    }
+};
+
+
+/*! TimeCache remembers the values computed for the last N distinct times.
+ *  Slots are replaced in round robin order. All methods may be called
+ *  concurrently from several threads. The lock is not held while a missing
+ *  value is computed, so the compute function may itself use the cache (for
+ *  example a velocity computed by differentiating cached positions.)
+ */
+template<class T, unsigned int N = 4> class TimeCache
+{
+ public:
+    TimeCache() { clear(); }
+
+    // Copies start out empty; cached values belong to the original object.
+    TimeCache(const TimeCache&) : TimeCache() {}
+    TimeCache& operator=(const TimeCache&) { clear(); return *this; }
+
+    template<class F> T get(double t, F compute) const
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (unsigned int i = 0; i < N; i++)
+            {
+                if (times[i] == t)
+                {
+                    stats.hits++;
+                    return values[i];
+                }
+            }
+            stats.misses++;
+        }
+
+        // Another thread may have stored the same time in the meantime
+        T value = compute(t);
+        insert(t, value);
+        return value;
+    }
+
+    /*! Store a value computed elsewhere, for example as a by-product of
+     *  computing another cached quantity.
+     */
+    void insert(double t, const T& value) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (unsigned int i = 0; i < N; i++)
+        {
+            if (times[i] == t)
+            {
+                values[i] = value;
+                return;
+            }
+        }
+
+        times[next] = t;
+        values[next] = value;
+        next = (next + 1) % N;
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // NaN never compares equal, so empty slots never match
+        for (unsigned int i = 0; i < N; i++)
+            times[i] = std::numeric_limits<double>::quiet_NaN();
+        next = 0;
+    }
+
+    TimeCacheStatistics getStatistics() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+ private:
+    mutable std::mutex mutex;
+    mutable double times[N];
+    mutable T values[N];
+    mutable unsigned int next{ 0 };
+    mutable TimeCacheStatistics stats;
+};
@@ -104,6 +104,29 @@ bool IsDirectory(const std::string& filename)
     return stat(filename.c_str(), &buf) == 0 ? S_ISDIR(buf.st_mode) : false;
 }
 
+bool MakeDirectory(const std::string& dirname)
+{
+    if (IsDirectory(dirname))
+        return true;
+
+    // Create the parent directories first
+    auto pos = dirname.find_last_of('/');
+    if (pos != string::npos && pos > 0 && !MakeDirectory(dirname.substr(0, pos)))
+        return false;
+
+    return mkdir(dirname.c_str(), 0777) == 0 || IsDirectory(dirname);
+}
+
+bool GetModificationTime(const std::string& filename, std::int64_t& mtime)
+{
+    struct stat buf;
+    if (stat(filename.c_str(), &buf) != 0)
+        return false;
+
+    mtime = (std::int64_t) buf.st_mtime;
+    return true;
+}
+
 std::string WordExp(const std::string& filename)
 {
 #ifndef WORDEXP_PROBLEM
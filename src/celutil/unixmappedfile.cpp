@@ -0,0 +1,63 @@
+// unixmappedfile.cpp
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mappedfile.h"
+
+using namespace std;
+
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+
+bool MappedFile::open(const string& filename)
+{
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat buf;
+    if (fstat(fd, &buf) != 0 || buf.st_size <= 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* addr = mmap(nullptr, (size_t) buf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+    if (addr == MAP_FAILED)
+        return false;
+
+    data = static_cast<const unsigned char*>(addr);
+    size = (size_t) buf.st_size;
+
+    return true;
+}
+
+
+void MappedFile::close()
+{
+    if (data != nullptr)
+        munmap(const_cast<unsigned char*>(data), size);
+
+    data = nullptr;
+    size = 0;
+}
@@ -103,6 +103,30 @@ bool IsDirectory(const std::string& filename)
     return ((attr & FILE_ATTRIBUTE_DIRECTORY) != 0);
 }
 
+bool MakeDirectory(const std::string& dirname)
+{
+    if (IsDirectory(dirname))
+        return true;
+
+    // Create the parent directories first
+    auto pos = dirname.find_last_of("/\\");
+    if (pos != string::npos && pos > 0 && !MakeDirectory(dirname.substr(0, pos)))
+        return false;
+
+    return CreateDirectoryA(dirname.c_str(), nullptr) != 0 || IsDirectory(dirname);
+}
+
+bool GetModificationTime(const std::string& filename, std::int64_t& mtime)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &data))
+        return false;
+
+    mtime = ((std::int64_t) data.ftLastWriteTime.dwHighDateTime << 32) |
+            data.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
 std::string WordExp(const std::string& filename) {
     return filename;
 }
@@ -0,0 +1,63 @@
+// winmappedfile.cpp
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <windows.h>
+#include "mappedfile.h"
+
+using namespace std;
+
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+
+bool MappedFile::open(const string& filename)
+{
+    close();
+
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr)
+        return false;
+
+    // The view keeps the mapping object alive until it is unmapped
+    void* addr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (addr == nullptr)
+        return false;
+
+    data = static_cast<const unsigned char*>(addr);
+    size = (size_t) fileSize.QuadPart;
+
+    return true;
+}
+
+
+void MappedFile::close()
+{
+    if (data != nullptr)
+        UnmapViewOfFile(data);
+
+    data = nullptr;
+    size = 0;
+}
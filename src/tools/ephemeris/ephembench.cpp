@@ -0,0 +1,641 @@
+// ephembench.cpp
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Microbenchmarks for the orbit and rotation model classes.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Every orbit and rotation model is evaluated along three time sequences:
+// increasing times, decreasing times and uniformly distributed random times,
+// all covering the same span. The results are written as CSV or JSON, one
+// record per model, method and access pattern, with the best and median
+// time per call over several runs. For models that cache recent times, the
+// hit rate of their caches over all calls of a case is reported as well.
+//
+// Precession and nutation are timed both evaluated directly and
+// interpolated from their tables, and the largest difference between the
+// two is reported. The velocities of every orbit are likewise compared
+// with central differences of its positions.
+//
+// Sampled trajectories and orientations are generated from analytic models
+// into a work directory, so no data files are needed. Custom orbits based
+// on the JPL ephemeris are included when data/jpleph.dat is found.
+
+#include <celephem/customorbit.h>
+#include <celephem/customrotation.h>
+#include <celephem/nutation.h>
+#include <celephem/orbit.h>
+#include <celephem/precession.h>
+#include <celephem/rotation.h>
+#include <celephem/samporbit.h>
+#include <celephem/samporient.h>
+#include <celephem/xyzvcompressed.h>
+#include <celengine/astro.h>
+#include <celmath/mathlib.h>
+#include <celutil/bytes.h> // __BYTE_ORDER__
+#include <fmt/printf.h>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#define chdir _chdir
+#else
+#include <unistd.h>
+#endif
+
+using namespace Eigen;
+using namespace std;
+
+
+constexpr const double SampleInterval = 1.0;    // days
+constexpr const double SolarMass = 1.989e30;    // kg
+
+static const char* CustomOrbitNames[] =
+{
+    "mercury", "venus", "earth", "moon", "mars", "jupiter", "saturn",
+    "uranus", "neptune", "pluto",
+    "vsop87-mercury", "vsop87-venus", "vsop87-earth", "vsop87-mars",
+    "vsop87-jupiter", "vsop87-saturn", "vsop87-uranus", "vsop87-neptune",
+    "vsop87-sun",
+    "jpl-mercury-sun", "jpl-earth-ssb", "jpl-moon-earth", "jpl-jupiter-ssb",
+    "jpl-sun-ssb",
+    "htc20-helene", "htc20-telesto", "htc20-calypso",
+    "phobos", "deimos", "io", "europa", "ganymede", "callisto",
+    "mimas", "enceladus", "tethys", "dione", "rhea", "titan", "hyperion",
+    "iapetus", "phoebe", "miranda", "ariel", "umbriel", "titania", "oberon",
+    "triton",
+};
+
+static const char* CustomRotationNames[] =
+{
+    "earth-p03lp",
+    "iau-mercury", "iau-venus", "iau-earth", "iau-mars", "iau-jupiter",
+    "iau-saturn", "iau-uranus", "iau-neptune", "iau-pluto", "iau-moon",
+    "iau-phobos", "iau-deimos", "iau-metis", "iau-adrastea", "iau-amalthea",
+    "iau-thebe", "iau-io", "iau-europa", "iau-ganymede", "iau-callisto",
+    "iau-pan", "iau-atlas", "iau-prometheus", "iau-pandora", "iau-mimas",
+    "iau-enceladus", "iau-tethys", "iau-telesto", "iau-calypso", "iau-dione",
+    "iau-helene", "iau-rhea", "iau-titan", "iau-iapetus", "iau-phoebe",
+};
+
+
+struct OrbitCase
+{
+    string name;
+    unique_ptr<Orbit> orbit;
+};
+
+struct RotationCase
+{
+    string name;
+    unique_ptr<RotationModel> rotation;
+};
+
+struct AccessPattern
+{
+    string name;
+    vector<double> times;
+};
+
+struct Result
+{
+    string kind;
+    string model;
+    string method;
+    string access;
+    size_t calls;
+    double best;    // ns per call
+    double median;  // ns per call
+    double hitRate; // of the time caches; negative for models without
+};
+
+
+static string dataDir;
+static string workDir = ".";
+static string filter;
+static bool jsonOutput = false;
+static size_t nCalls = 10000;
+static int nRuns = 5;
+static double startTime = astro::J2000 - 3652.5;
+static double endTime = astro::J2000 + 3652.5;
+
+
+static void Usage()
+{
+    cerr << "Usage: ephembench [options]\n";
+    cerr << "  -d, --dir <dir>       data directory, for data/jpleph.dat\n";
+    cerr << "  -w, --work <dir>      directory for generated trajectory files\n";
+    cerr << "  -f, --filter <text>   only run models whose name contains text\n";
+    cerr << "  -n, --calls <n>       calls per run (default 10000)\n";
+    cerr << "  -r, --runs <n>        runs per benchmark (default 5)\n";
+    cerr << "  --json                write JSON instead of CSV\n";
+}
+
+
+static bool parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if ((arg == "-d" || arg == "--dir") && hasValue)
+            dataDir = argv[++i];
+        else if ((arg == "-w" || arg == "--work") && hasValue)
+            workDir = argv[++i];
+        else if ((arg == "-f" || arg == "--filter") && hasValue)
+            filter = argv[++i];
+        else if ((arg == "-n" || arg == "--calls") && hasValue)
+            nCalls = strtoul(argv[++i], nullptr, 10);
+        else if ((arg == "-r" || arg == "--runs") && hasValue)
+            nRuns = atoi(argv[++i]);
+        else if (arg == "--json")
+            jsonOutput = true;
+        else
+            return false;
+    }
+
+    return nCalls > 0 && nRuns > 0;
+}
+
+
+static vector<AccessPattern> makeAccessPatterns()
+{
+    vector<AccessPattern> patterns(3);
+    patterns[0].name = "sequential";
+    patterns[1].name = "reverse";
+    patterns[2].name = "random";
+
+    double dt = (endTime - startTime) / (double) nCalls;
+    mt19937_64 rng(1);
+    uniform_real_distribution<double> uniform(startTime, endTime);
+    for (size_t i = 0; i < nCalls; i++)
+    {
+        patterns[0].times.push_back(startTime + (double) i * dt);
+        patterns[1].times.push_back(endTime - (double) i * dt);
+        patterns[2].times.push_back(uniform(rng));
+    }
+
+    return patterns;
+}
+
+
+// Trajectory files use the conventional ecliptic axes, with velocities in
+// km/s, while Orbit uses Celestia's internal axes and km/day.
+static void toFileCoordinates(const Vector3d& p, const Vector3d& v,
+                              XYZVBinaryData& sample, double tdb)
+{
+    sample.tdb = tdb;
+    sample.position[0] = p.x();
+    sample.position[1] = -p.z();
+    sample.position[2] = p.y();
+    sample.velocity[0] = v.x() / 86400.0;
+    sample.velocity[1] = -v.z() / 86400.0;
+    sample.velocity[2] = v.y() / 86400.0;
+}
+
+
+static vector<XYZVBinaryData> sampleOrbit(const Orbit& orbit)
+{
+    vector<XYZVBinaryData> samples;
+    for (double t = startTime - SampleInterval; t <= endTime + SampleInterval; t += SampleInterval)
+    {
+        XYZVBinaryData sample;
+        toFileCoordinates(orbit.positionAtTime(t), orbit.velocityAtTime(t), sample, t);
+        samples.push_back(sample);
+    }
+
+    return samples;
+}
+
+
+static bool writeTrajectories(const vector<XYZVBinaryData>& samples,
+                              const string& xyzFile,
+                              const string& xyzvFile,
+                              const string& compressedFile)
+{
+    ofstream xyz(xyzFile);
+    ofstream xyzv(xyzvFile);
+    for (const auto& s : samples)
+    {
+        fmt::fprintf(xyz, "%.9f %.17g %.17g %.17g\n",
+                     s.tdb, s.position[0], s.position[1], s.position[2]);
+        fmt::fprintf(xyzv, "%.9f %.17g %.17g %.17g %.17g %.17g %.17g\n",
+                     s.tdb, s.position[0], s.position[1], s.position[2],
+                     s.velocity[0], s.velocity[1], s.velocity[2]);
+    }
+    if (!xyz.good() || !xyzv.good())
+        return false;
+
+    XYZVCompressedHeader header;
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, xyzvc::Magic, 8);
+    header.byteOrder = __BYTE_ORDER__;
+    header.digits = numeric_limits<double>::digits;
+    header.samplesPerSegment = 256;
+    header.count = samples.size();
+    header.maxError = 1.0;
+    header.timeQuantum = 1.0e-6;
+    for (const auto& s : samples)
+    {
+        header.boundingRadius = max(header.boundingRadius,
+                                    Map<const Vector3d>(s.position).norm());
+    }
+
+    vector<XYZVCompressedSegment> segments;
+    vector<uint8_t> payload;
+    for (size_t i = 0; i < samples.size(); i += header.samplesPerSegment)
+    {
+        uint32_t count = (uint32_t) min((size_t) header.samplesPerSegment, samples.size() - i);
+        XYZVCompressedSegment segment;
+        if (!xyzvc::EncodeSegment(header, &samples[i], count, segment, payload))
+            return false;
+        segments.push_back(segment);
+    }
+    header.segmentCount = segments.size();
+
+    ofstream out(compressedFile, ios::out | ios::binary);
+    out.write(reinterpret_cast<char*>(&header), sizeof header);
+    out.write(reinterpret_cast<char*>(segments.data()), segments.size() * sizeof(XYZVCompressedSegment));
+    out.write(reinterpret_cast<char*>(payload.data()), payload.size());
+
+    return out.good();
+}
+
+
+static bool writeOrientations(const RotationModel& rotation, const string& qFile)
+{
+    ofstream out(qFile);
+    for (double t = startTime - SampleInterval; t <= endTime + SampleInterval; t += SampleInterval / 8.0)
+    {
+        Quaterniond q = rotation.orientationAtTime(t);
+        fmt::fprintf(out, "%.9f %.17g %.17g %.17g %.17g\n", t, q.w(), q.x(), q.y(), q.z());
+    }
+
+    return out.good();
+}
+
+
+static void addOrbit(vector<OrbitCase>& cases, const string& name, Orbit* orbit)
+{
+    if (orbit == nullptr)
+    {
+        fmt::fprintf(cerr, "Skipping orbit %s\n", name);
+        return;
+    }
+
+    cases.push_back(OrbitCase());
+    cases.back().name = name;
+    cases.back().orbit.reset(orbit);
+}
+
+
+static void addRotation(vector<RotationCase>& cases, const string& name, RotationModel* rotation)
+{
+    if (rotation == nullptr)
+    {
+        fmt::fprintf(cerr, "Skipping rotation model %s\n", name);
+        return;
+    }
+
+    cases.push_back(RotationCase());
+    cases.back().name = name;
+    cases.back().rotation.reset(rotation);
+}
+
+
+static vector<OrbitCase> makeOrbits(vector<string>& tempFiles)
+{
+    vector<OrbitCase> cases;
+
+    // An Earth like orbit and a hyperbolic one
+    EllipticalOrbit* earthLike = new EllipticalOrbit(1.471e8, 0.0167, 0.0, 0.0, 1.8, 0.0, 365.25);
+    addOrbit(cases, "elliptical", earthLike);
+    double gm = astro::G * SolarMass * 1.0e-9 * 86400.0 * 86400.0;
+    double q = 1.0e8;
+    double e = 1.5;
+    double a = q / (e - 1.0);
+    addOrbit(cases, "hyperbolic",
+             new EllipticalOrbit(q, e, 0.3, 0.2, 0.1, 0.0, 2.0 * PI * sqrt(a * a * a / gm)));
+
+    for (const char* name : CustomOrbitNames)
+        addOrbit(cases, name, GetCustomOrbit(name));
+
+    vector<XYZVBinaryData> samples = sampleOrbit(*earthLike);
+    string xyzFile = workDir + "/ephembench.xyz";
+    string xyzvFile = workDir + "/ephembench.xyzv";
+    string compressedFile = workDir + "/ephembench-compressed.xyzv";
+    tempFiles.push_back(xyzFile);
+    tempFiles.push_back(xyzvFile);
+    tempFiles.push_back(compressedFile + "bin");
+    if (!writeTrajectories(samples, xyzFile, xyzvFile, compressedFile + "bin"))
+    {
+        cerr << "Error writing sampled trajectories\n";
+        return cases;
+    }
+
+    const struct
+    {
+        const char* name;
+        TrajectoryInterpolation interpolation;
+    } interpolations[] =
+    {
+        { "linear", TrajectoryInterpolationLinear },
+        { "cubic",  TrajectoryInterpolationCubic  },
+    };
+
+    for (const auto& interp : interpolations)
+    {
+        string suffix = string("-") + interp.name;
+        addOrbit(cases, "xyz-single" + suffix,
+                 LoadSampledTrajectorySinglePrec(xyzFile, interp.interpolation));
+        addOrbit(cases, "xyz-double" + suffix,
+                 LoadSampledTrajectoryDoublePrec(xyzFile, interp.interpolation));
+        addOrbit(cases, "xyzv-single" + suffix,
+                 LoadXYZVTrajectorySinglePrec(xyzvFile, interp.interpolation));
+        addOrbit(cases, "xyzv-double" + suffix,
+                 LoadXYZVTrajectoryDoublePrec(xyzvFile, interp.interpolation));
+        addOrbit(cases, "xyzv-compressed" + suffix,
+                 LoadXYZVTrajectoryDoublePrec(compressedFile, interp.interpolation));
+    }
+
+    // A sampled trajectory covering the middle half of the span, extended
+    // with osculating orbits before and after.
+    Orbit* primary = LoadXYZVTrajectoryDoublePrec(xyzvFile, TrajectoryInterpolationCubic);
+    if (primary != nullptr)
+    {
+        double span = endTime - startTime;
+        addOrbit(cases, "mixed",
+                 new MixedOrbit(primary, startTime + span / 4.0, endTime - span / 4.0, SolarMass));
+    }
+
+    return cases;
+}
+
+
+static vector<RotationCase> makeRotations(vector<string>& tempFiles)
+{
+    vector<RotationCase> cases;
+
+    addRotation(cases, "constant",
+                new ConstantOrientation(Quaterniond(AngleAxisd(0.5, Vector3d::UnitX()))));
+    UniformRotationModel* uniform = new UniformRotationModel(0.9973, 0.5f, astro::J2000, 0.4f, 0.1f);
+    addRotation(cases, "uniform", uniform);
+    addRotation(cases, "precessing",
+                new PrecessingRotationModel(0.9973, 0.5f, astro::J2000, 0.4f, 0.1f, 9413040.0));
+
+    for (const char* name : CustomRotationNames)
+        addRotation(cases, name, GetCustomRotationModel(name));
+
+    string qFile = workDir + "/ephembench.q";
+    tempFiles.push_back(qFile);
+    if (writeOrientations(*uniform, qFile))
+        addRotation(cases, "sampled", LoadSampledOrientation(qFile));
+    else
+        cerr << "Error writing sampled orientation\n";
+
+    return cases;
+}
+
+
+// Time f over all of the times of an access pattern, nRuns times, and
+// return the best and median time per call.
+static void measure(const vector<double>& times,
+                    const function<double(double)>& f,
+                    double& best,
+                    double& median)
+{
+    // The sum keeps the calls from being optimized away.
+    volatile double sink = 0.0;
+    vector<double> runs;
+
+    // The first pass warms up caches and is not timed.
+    for (int run = -1; run < nRuns; run++)
+    {
+        double sum = 0.0;
+        auto start = chrono::steady_clock::now();
+        for (double t : times)
+            sum += f(t);
+        auto end = chrono::steady_clock::now();
+        sink = sink + sum;
+
+        if (run >= 0)
+            runs.push_back(chrono::duration<double, nano>(end - start).count() / (double) times.size());
+    }
+
+    sort(runs.begin(), runs.end());
+    best = runs.front();
+    median = runs[runs.size() / 2];
+}
+
+
+// Largest difference between two functions over all of the times of the
+// access patterns.
+static double maxDifference(const vector<AccessPattern>& patterns,
+                            const function<double(double)>& f,
+                            const function<double(double)>& g)
+{
+    double maxDiff = 0.0;
+    for (const auto& pattern : patterns)
+        for (double t : pattern.times)
+            maxDiff = max(maxDiff, abs(f(t) - g(t)));
+    return maxDiff;
+}
+
+
+// Largest difference between the velocity of an orbit and the central
+// difference of its positions over all of the times of the access
+// patterns, relative to the speed.
+static double maxVelocityDifference(const vector<AccessPattern>& patterns, const Orbit& orbit)
+{
+    const double h = 1.0e-3;    // days
+    double maxDiff = 0.0;
+    for (const auto& pattern : patterns)
+    {
+        for (double t : pattern.times)
+        {
+            // The step is rounded along with the times
+            double t0 = t - h;
+            double t1 = t + h;
+            Vector3d v = orbit.velocityAtTime(t);
+            Vector3d fd = (orbit.positionAtTime(t1) - orbit.positionAtTime(t0)) / (t1 - t0);
+            double speed = v.norm();
+            if (speed > 0.0)
+                maxDiff = max(maxDiff, (v - fd).norm() / speed);
+        }
+    }
+    return maxDiff;
+}
+
+
+static void writeResults(const vector<Result>& results)
+{
+    if (jsonOutput)
+    {
+        cout << "[\n";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Result& r = results[i];
+            string hitRate = r.hitRate < 0.0 ? "null" : fmt::sprintf("%.4f", r.hitRate);
+            fmt::printf("  { \"kind\": \"%s\", \"model\": \"%s\", \"method\": \"%s\", "
+                        "\"access\": \"%s\", \"calls\": %u, \"best_ns\": %.2f, \"median_ns\": %.2f, "
+                        "\"hit_rate\": %s }%s\n",
+                        r.kind, r.model, r.method, r.access, (unsigned int) r.calls,
+                        r.best, r.median, hitRate, i + 1 < results.size() ? "," : "");
+        }
+        cout << "]\n";
+    }
+    else
+    {
+        cout << "kind,model,method,access,calls,best_ns,median_ns,hit_rate\n";
+        for (const auto& r : results)
+        {
+            string hitRate = r.hitRate < 0.0 ? "" : fmt::sprintf("%.4f", r.hitRate);
+            fmt::printf("%s,%s,%s,%s,%u,%.2f,%.2f,%s\n",
+                        r.kind, r.model, r.method, r.access, (unsigned int) r.calls,
+                        r.best, r.median, hitRate);
+        }
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    if (!dataDir.empty() && chdir(dataDir.c_str()) != 0)
+    {
+        fmt::fprintf(cerr, "Cannot change directory to %s\n", dataDir);
+        return 1;
+    }
+
+    clog.rdbuf(nullptr);
+
+    vector<string> tempFiles;
+    vector<OrbitCase> orbits = makeOrbits(tempFiles);
+    vector<RotationCase> rotations = makeRotations(tempFiles);
+    vector<AccessPattern> patterns = makeAccessPatterns();
+
+    vector<Result> results;
+    auto run = [&](const string& kind, const string& model, const string& method,
+                   const function<double(double)>& f,
+                   const function<TimeCacheStatistics()>& cacheStats = nullptr)
+    {
+        for (const auto& pattern : patterns)
+        {
+            Result r{ kind, model, method, pattern.name, pattern.times.size(), 0.0, 0.0, -1.0 };
+            TimeCacheStatistics before;
+            if (cacheStats)
+                before = cacheStats();
+            measure(pattern.times, f, r.best, r.median);
+            if (cacheStats)
+            {
+                TimeCacheStatistics after = cacheStats();
+                TimeCacheStatistics timed;
+                timed.hits = after.hits - before.hits;
+                timed.misses = after.misses - before.misses;
+                r.hitRate = timed.hitRate();
+            }
+            results.push_back(r);
+            fmt::fprintf(cerr, "%s %s %s %s: %.1f ns\n", kind, model, method, pattern.name, r.median);
+        }
+    };
+
+    for (const auto& c : orbits)
+    {
+        if (c.name.find(filter) == string::npos)
+            continue;
+
+        const Orbit* orbit = c.orbit.get();
+        function<TimeCacheStatistics()> cacheStats;
+        if (auto caching = dynamic_cast<const CachingOrbit*>(orbit))
+            cacheStats = [caching]() { return caching->getCacheStatistics(); };
+
+        run("orbit", c.name, "position",
+            [orbit](double t) { return orbit->positionAtTime(t).x(); }, cacheStats);
+        run("orbit", c.name, "velocity",
+            [orbit](double t) { return orbit->velocityAtTime(t).x(); }, cacheStats);
+        run("orbit", c.name, "state", [orbit](double t)
+            {
+                Vector3d p, v;
+                orbit->stateAtTime(t, p, v);
+                return p.x() + v.x();
+            }, cacheStats);
+        fmt::fprintf(cerr, "orbit %s: largest relative velocity difference from finite differences %g\n",
+                     c.name, maxVelocityDifference(patterns, *orbit));
+    }
+
+    for (const auto& c : rotations)
+    {
+        if (c.name.find(filter) == string::npos)
+            continue;
+
+        const RotationModel* rotation = c.rotation.get();
+        function<TimeCacheStatistics()> cacheStats;
+        if (auto caching = dynamic_cast<const CachingRotationModel*>(rotation))
+            cacheStats = [caching]() { return caching->getCacheStatistics(); };
+
+        run("rotation", c.name, "orientation",
+            [rotation](double t) { return rotation->orientationAtTime(t).w(); }, cacheStats);
+        run("rotation", c.name, "angularVelocity",
+            [rotation](double t) { return rotation->angularVelocityAtTime(t).x(); }, cacheStats);
+    }
+
+    // The precession and nutation functions take the time in Julian
+    // centuries since J2000.
+    auto centuries = [](double t) { return (t - astro::J2000) / 36525.0; };
+    auto angles = [&](const char* category,
+                      const string& model,
+                      const function<double(double)>& direct,
+                      const function<double(double)>& tabulated,
+                      const char* units)
+    {
+        if (model.find(filter) == string::npos)
+            return;
+
+        run(category, model, "direct", direct);
+        run(category, model, "tabulated", tabulated);
+        fmt::fprintf(cerr, "%s %s: largest difference %g %s\n",
+                     category, model, maxDifference(patterns, direct, tabulated), units);
+    };
+
+    angles("precession", "p03lp-pole",
+           [&](double t) { return astro::EclipticPrecession_P03LP(centuries(t)).PA; },
+           [&](double t) { return astro::TabulatedEclipticPrecession_P03LP(centuries(t)).PA; },
+           "arcsec");
+    angles("precession", "p03lp-obliquity",
+           [&](double t) { return astro::PrecObliquity_P03LP(centuries(t)).epsA; },
+           [&](double t) { return astro::TabulatedPrecObliquity_P03LP(centuries(t)).epsA; },
+           "arcsec");
+    angles("nutation", "iau2000b-longitude",
+           [&](double t) { return astro::Nutation_IAU2000B(centuries(t)).longitude; },
+           [&](double t) { return astro::TabulatedNutation_IAU2000B(centuries(t)).longitude; },
+           "rad");
+
+    writeResults(results);
+
+    for (const auto& file : tempFiles)
+        remove(file.c_str());
+
+    return 0;
+}
@@ -0,0 +1,489 @@
+// ephemquery.cpp
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Evaluate positions and velocities of solar system objects for a list of
+// queries without starting the renderer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Each line of the query file has the form
+//
+//     <object> <start> <end> <step> [<center> [ecliptic|equatorial|bodyfixed]]
+//
+// Object and center are paths such as "Sol/Earth/Moon"; paths containing
+// spaces must be quoted. Times are TDB Julian dates and the step is in days.
+// The center defaults to the star of the object's system, the axes to the
+// J2000 ecliptic. Lines starting with # are comments.
+//
+// Positions are written in km and velocities in km/s, either as CSV or as
+// binary records with the layout of EphemerisRecord in native byte order.
+
+#include "universeloader.h"
+#include <celengine/astro.h>
+#include <celengine/body.h>
+#include <celengine/selection.h>
+#include <celengine/universe.h>
+#include <celutil/bytes.h> // __BYTE_ORDER__
+#include <celutil/threadpool.h>
+#include <fmt/printf.h>
+#include <Eigen/Geometry>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#define chdir _chdir
+#else
+#include <unistd.h>
+#endif
+
+using namespace Eigen;
+using namespace std;
+
+
+// Number of samples evaluated by one task
+constexpr const size_t BlockSize = 4096;
+
+constexpr char Magic[8] = "CELEPHQ";
+
+struct EphemerisFileHeader
+{
+    char magic[8];
+    uint16_t byteOrder;
+    uint16_t reserved0;
+    uint32_t reserved1;
+};
+
+struct EphemerisRecord
+{
+    uint32_t query;
+    uint32_t reserved;
+    double tdb;
+    double position[3];
+    double velocity[3];
+};
+
+
+enum class Axes
+{
+    Ecliptic,
+    Equatorial,
+    BodyFixed
+};
+
+struct Query
+{
+    Selection object;
+    Selection center;
+    Axes axes{ Axes::Ecliptic };
+    double start{ 0.0 };
+    double end{ 0.0 };
+    double step{ 0.0 };
+    size_t count{ 0 };
+};
+
+struct QueryBlock
+{
+    size_t query;
+    size_t first;
+    size_t count;
+};
+
+
+static string configFileName = "celestia.cfg";
+static string dataDir;
+static string queryFileName;
+static string outputFileName;
+static bool binaryOutput = false;
+static unsigned int nThreads = 0;
+
+
+static void Usage()
+{
+    cerr << "Usage: ephemquery [options] <query file> [output file]\n";
+    cerr << "  -c, --conf <file>     configuration file (default celestia.cfg)\n";
+    cerr << "  -d, --dir <dir>       data directory\n";
+    cerr << "  -b, --binary          write binary records instead of CSV\n";
+    cerr << "  -j, --threads <n>     number of threads (default all cores)\n";
+    cerr << "The query file - reads queries from the standard input, and\n";
+    cerr << "results go to the standard output if no output file is given.\n";
+}
+
+
+static bool parseCommandLine(int argc, char* argv[])
+{
+    int fileCount = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if ((arg == "-c" || arg == "--conf") && hasValue)
+        {
+            configFileName = argv[++i];
+        }
+        else if ((arg == "-d" || arg == "--dir") && hasValue)
+        {
+            dataDir = argv[++i];
+        }
+        else if (arg == "-b" || arg == "--binary")
+        {
+            binaryOutput = true;
+        }
+        else if ((arg == "-j" || arg == "--threads") && hasValue)
+        {
+            nThreads = (unsigned int) strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg[0] == '-' && arg != "-")
+        {
+            cerr << "Unknown command line switch: " << arg << '\n';
+            return false;
+        }
+        else if (fileCount == 0)
+        {
+            queryFileName = arg;
+            fileCount++;
+        }
+        else if (fileCount == 1)
+        {
+            outputFileName = arg;
+            fileCount++;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return fileCount > 0;
+}
+
+
+// Split a line into whitespace separated fields; double quotes group
+// fields containing spaces.
+static vector<string> splitFields(const string& line)
+{
+    vector<string> fields;
+    size_t i = 0;
+    while (i < line.size())
+    {
+        if (isspace((unsigned char) line[i]))
+        {
+            i++;
+        }
+        else if (line[i] == '"')
+        {
+            size_t end = line.find('"', i + 1);
+            if (end == string::npos)
+                end = line.size();
+            fields.push_back(line.substr(i + 1, end - i - 1));
+            i = end + 1;
+        }
+        else
+        {
+            size_t start = i;
+            while (i < line.size() && !isspace((unsigned char) line[i]))
+                i++;
+            fields.push_back(line.substr(start, i - start));
+        }
+    }
+
+    return fields;
+}
+
+
+static bool parseNumber(const string& s, double& value)
+{
+    char* end = nullptr;
+    value = strtod(s.c_str(), &end);
+    return end != s.c_str() && *end == '\0' && isfinite(value);
+}
+
+
+static bool parseQuery(const Universe& universe,
+                       const vector<string>& fields,
+                       Query& query)
+{
+    if (fields.size() < 4 || fields.size() > 6)
+    {
+        cerr << "Expected <object> <start> <end> <step> [<center> [<axes>]]\n";
+        return false;
+    }
+
+    query.object = universe.findPath(fields[0]);
+    if (query.object.empty())
+    {
+        fmt::fprintf(cerr, "Object %s not found\n", fields[0]);
+        return false;
+    }
+
+    if (!parseNumber(fields[1], query.start) ||
+        !parseNumber(fields[2], query.end) ||
+        !parseNumber(fields[3], query.step) ||
+        query.end < query.start || query.step <= 0.0)
+    {
+        cerr << "Bad time range\n";
+        return false;
+    }
+    query.count = (size_t) floor((query.end - query.start) / query.step + 1.0e-9) + 1;
+
+    if (fields.size() > 4)
+    {
+        query.center = universe.findPath(fields[4]);
+        if (query.center.empty())
+        {
+            fmt::fprintf(cerr, "Center %s not found\n", fields[4]);
+            return false;
+        }
+    }
+    else if (query.object.body() != nullptr)
+    {
+        query.center = Selection(query.object.body()->getSystem()->getStar());
+    }
+    else
+    {
+        query.center = query.object;
+    }
+
+    if (fields.size() > 5)
+    {
+        if (fields[5] == "ecliptic")
+        {
+            query.axes = Axes::Ecliptic;
+        }
+        else if (fields[5] == "equatorial")
+        {
+            query.axes = Axes::Equatorial;
+        }
+        else if (fields[5] == "bodyfixed" && query.center.body() != nullptr)
+        {
+            query.axes = Axes::BodyFixed;
+        }
+        else
+        {
+            fmt::fprintf(cerr, "Bad axes %s\n", fields[5]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+static bool readQueries(const Universe& universe, istream& in, vector<Query>& queries)
+{
+    string line;
+    int lineNumber = 0;
+    while (getline(in, line))
+    {
+        lineNumber++;
+
+        vector<string> fields = splitFields(line);
+        if (fields.empty() || fields[0][0] == '#')
+            continue;
+
+        Query query;
+        if (!parseQuery(universe, fields, query))
+        {
+            fmt::fprintf(cerr, "Error in query on line %d\n", lineNumber);
+            return false;
+        }
+        queries.push_back(query);
+    }
+
+    return true;
+}
+
+
+static void evaluate(const Query& query, size_t queryIndex, double tdb,
+                     EphemerisRecord& record)
+{
+    Vector3d pos = query.object.getPosition(tdb).offsetFromKm(query.center.getPosition(tdb));
+    Vector3d vel = query.object.getVelocity(tdb) - query.center.getVelocity(tdb);
+
+    switch (query.axes)
+    {
+    case Axes::Ecliptic:
+        break;
+    case Axes::Equatorial:
+        pos = astro::eclipticToEquatorial() * pos;
+        vel = astro::eclipticToEquatorial() * vel;
+        break;
+    case Axes::BodyFixed:
+        {
+            const Body* center = query.center.body();
+            Quaterniond q = center->getEclipticToBodyFixed(tdb);
+            vel = q * (vel - center->getAngularVelocity(tdb).cross(pos));
+            pos = q * pos;
+        }
+        break;
+    }
+
+    // Convert from Celestia's internal coordinate system (y axis toward the
+    // north pole) to the usual one, and velocities from km/day to km/s.
+    record.query = (uint32_t) queryIndex;
+    record.reserved = 0;
+    record.tdb = tdb;
+    record.position[0] = pos.x();
+    record.position[1] = -pos.z();
+    record.position[2] = pos.y();
+    record.velocity[0] = vel.x() / 86400.0;
+    record.velocity[1] = -vel.z() / 86400.0;
+    record.velocity[2] = vel.y() / 86400.0;
+}
+
+
+static vector<EphemerisRecord> evaluateBlock(const vector<Query>& queries,
+                                             const QueryBlock& block)
+{
+    const Query& query = queries[block.query];
+    vector<EphemerisRecord> records(block.count);
+    for (size_t i = 0; i < block.count; i++)
+    {
+        double tdb = query.start + (double) (block.first + i) * query.step;
+        evaluate(query, block.query, tdb, records[i]);
+    }
+
+    return records;
+}
+
+
+static void writeRecords(ostream& out, const vector<EphemerisRecord>& records)
+{
+    if (binaryOutput)
+    {
+        out.write(reinterpret_cast<const char*>(records.data()),
+                  records.size() * sizeof(EphemerisRecord));
+        return;
+    }
+
+    for (const auto& r : records)
+    {
+        fmt::fprintf(out, "%u,%.9f,%.17g,%.17g,%.17g,%.17g,%.17g,%.17g\n",
+                     r.query, r.tdb,
+                     r.position[0], r.position[1], r.position[2],
+                     r.velocity[0], r.velocity[1], r.velocity[2]);
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    if (!dataDir.empty() && chdir(dataDir.c_str()) != 0)
+    {
+        fmt::fprintf(cerr, "Cannot change directory to %s\n", dataDir);
+        return 1;
+    }
+
+    // Catalogs report what they load on clog; keep it off the terminal.
+    clog.rdbuf(nullptr);
+
+    unique_ptr<Universe> universe(LoadUniverse(configFileName));
+    if (universe == nullptr)
+        return 1;
+
+    vector<Query> queries;
+    if (queryFileName == "-")
+    {
+        if (!readQueries(*universe, cin, queries))
+            return 1;
+    }
+    else
+    {
+        ifstream queryFile(queryFileName, ios::in);
+        if (!queryFile.good())
+        {
+            fmt::fprintf(cerr, "Error opening %s\n", queryFileName);
+            return 1;
+        }
+        if (!readQueries(*universe, queryFile, queries))
+            return 1;
+    }
+
+    ofstream outputFile;
+    if (!outputFileName.empty())
+    {
+        outputFile.open(outputFileName, ios::out | ios::binary);
+        if (!outputFile.good())
+        {
+            fmt::fprintf(cerr, "Error opening %s\n", outputFileName);
+            return 1;
+        }
+    }
+    ostream& out = outputFileName.empty() ? cout : outputFile;
+
+    if (binaryOutput)
+    {
+        EphemerisFileHeader header;
+        memset(&header, 0, sizeof header);
+        memcpy(header.magic, Magic, sizeof header.magic);
+        header.byteOrder = __BYTE_ORDER__;
+        out.write(reinterpret_cast<const char*>(&header), sizeof header);
+    }
+    else
+    {
+        out << "query,tdb,x,y,z,vx,vy,vz\n";
+    }
+
+    vector<QueryBlock> blocks;
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        for (size_t first = 0; first < queries[i].count; first += BlockSize)
+            blocks.push_back({ i, first, min(BlockSize, queries[i].count - first) });
+    }
+
+    unique_ptr<ThreadPool> ownPool;
+    ThreadPool* threadPool = GetThreadPool();
+    if (nThreads > 0)
+    {
+        ownPool.reset(new ThreadPool(nThreads - 1));
+        threadPool = ownPool.get();
+    }
+
+    // Keep a bounded number of blocks in flight and write the results in
+    // query order as they complete, so memory use does not depend on the
+    // total number of samples.
+    size_t maxPending = 2 * (threadPool->threadCount() + 1);
+    deque<future<vector<EphemerisRecord>>> pending;
+    size_t next = 0;
+    while (next < blocks.size() || !pending.empty())
+    {
+        while (next < blocks.size() && pending.size() < maxPending)
+        {
+            const QueryBlock& block = blocks[next++];
+            const vector<Query>& q = queries;
+            pending.push_back(threadPool->submit([&q, block]() { return evaluateBlock(q, block); }));
+        }
+
+        writeRecords(out, pending.front().get());
+        pending.pop_front();
+    }
+
+    out.flush();
+    if (!out.good())
+    {
+        cerr << "Error writing output\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,309 @@
+// ephemstress.cpp
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Evaluate the positions and orientations of every solar system object
+// from several threads at once and check that the results match those
+// computed by a single thread.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// All threads evaluate the same objects at the same times, each in its
+// own random order, so that the orbit, rotation and frame caches are
+// filled and replaced concurrently. Any difference from the reference
+// values is reported and makes the program exit with status 1.
+
+#include "universeloader.h"
+#include <celengine/astro.h>
+#include <celengine/body.h>
+#include <celengine/solarsys.h>
+#include <celengine/universe.h>
+#include <fmt/printf.h>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#define chdir _chdir
+#else
+#include <unistd.h>
+#endif
+
+using namespace Eigen;
+using namespace std;
+
+
+// Position, velocity, orientation, angular velocity, body fixed orientation
+constexpr const size_t StateSize = 3 + 3 + 4 + 3 + 4;
+
+struct WorkItem
+{
+    size_t body;
+    size_t time;
+};
+
+struct ThreadResult
+{
+    size_t evaluations{ 0 };
+    size_t mismatches{ 0 };
+    double maxDifference{ 0.0 };
+    size_t firstBody{ 0 };
+    size_t firstTime{ 0 };
+};
+
+
+static string configFileName = "celestia.cfg";
+static string dataDir;
+static unsigned int nThreads = 0;
+static size_t nTimes = 64;
+static int nRounds = 4;
+static double startTime = astro::J2000 - 3652.5;
+static double endTime = astro::J2000 + 3652.5;
+
+
+static void Usage()
+{
+    cerr << "Usage: ephemstress [options]\n";
+    cerr << "  -c, --conf <file>     configuration file (default celestia.cfg)\n";
+    cerr << "  -d, --dir <dir>       data directory\n";
+    cerr << "  -j, --threads <n>     number of threads (default all cores)\n";
+    cerr << "  -n, --times <n>       number of times per object (default 64)\n";
+    cerr << "  -r, --rounds <n>      passes made by each thread (default 4)\n";
+    cerr << "  -s, --start <tdb>     first time (default J2000 - 10 years)\n";
+    cerr << "  -e, --end <tdb>       last time (default J2000 + 10 years)\n";
+}
+
+
+static bool parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if ((arg == "-c" || arg == "--conf") && hasValue)
+        {
+            configFileName = argv[++i];
+        }
+        else if ((arg == "-d" || arg == "--dir") && hasValue)
+        {
+            dataDir = argv[++i];
+        }
+        else if ((arg == "-j" || arg == "--threads") && hasValue)
+        {
+            nThreads = (unsigned int) strtoul(argv[++i], nullptr, 10);
+        }
+        else if ((arg == "-n" || arg == "--times") && hasValue)
+        {
+            nTimes = (size_t) strtoul(argv[++i], nullptr, 10);
+        }
+        else if ((arg == "-r" || arg == "--rounds") && hasValue)
+        {
+            nRounds = atoi(argv[++i]);
+        }
+        else if ((arg == "-s" || arg == "--start") && hasValue)
+        {
+            startTime = atof(argv[++i]);
+        }
+        else if ((arg == "-e" || arg == "--end") && hasValue)
+        {
+            endTime = atof(argv[++i]);
+        }
+        else
+        {
+            cerr << "Unknown command line switch: " << arg << '\n';
+            return false;
+        }
+    }
+
+    return nTimes > 0 && nRounds > 0 && endTime >= startTime;
+}
+
+
+static void addBodies(const PlanetarySystem* system, vector<const Body*>& bodies)
+{
+    for (int i = 0; i < system->getSystemSize(); i++)
+    {
+        const Body* body = system->getBody(i);
+        bodies.push_back(body);
+        if (body->getSatellites() != nullptr)
+            addBodies(body->getSatellites(), bodies);
+    }
+}
+
+
+static void evaluate(const Body* body, double tdb, double* state)
+{
+    Vector3d p = body->getAstrocentricPosition(tdb);
+    Vector3d v = body->getVelocity(tdb);
+    Quaterniond q = body->getOrientation(tdb);
+    Vector3d w = body->getAngularVelocity(tdb);
+    Quaterniond b = body->getEclipticToBodyFixed(tdb);
+
+    double* s = state;
+    for (int i = 0; i < 3; i++)
+        *s++ = p[i];
+    for (int i = 0; i < 3; i++)
+        *s++ = v[i];
+    for (int i = 0; i < 4; i++)
+        *s++ = q.coeffs()[i];
+    for (int i = 0; i < 3; i++)
+        *s++ = w[i];
+    for (int i = 0; i < 4; i++)
+        *s++ = b.coeffs()[i];
+}
+
+
+static double difference(double a, double b)
+{
+    if (a == b || (std::isnan(a) && std::isnan(b)))
+        return 0.0;
+    double d = std::abs(a - b);
+    return std::isnan(d) ? numeric_limits<double>::infinity() : d;
+}
+
+
+static void hammer(const vector<const Body*>& bodies,
+                   const vector<double>& times,
+                   const vector<double>& reference,
+                   unsigned int seed,
+                   ThreadResult& result)
+{
+    vector<WorkItem> items;
+    items.reserve(bodies.size() * times.size());
+    for (size_t i = 0; i < bodies.size(); i++)
+        for (size_t j = 0; j < times.size(); j++)
+            items.push_back({ i, j });
+
+    mt19937 rng(seed);
+    double state[StateSize];
+    for (int round = 0; round < nRounds; round++)
+    {
+        shuffle(items.begin(), items.end(), rng);
+        for (const auto& item : items)
+        {
+            evaluate(bodies[item.body], times[item.time], state);
+            result.evaluations++;
+
+            const double* expected = &reference[(item.body * times.size() + item.time) * StateSize];
+            double maxDiff = 0.0;
+            for (size_t k = 0; k < StateSize; k++)
+                maxDiff = max(maxDiff, difference(state[k], expected[k]));
+
+            if (maxDiff > 0.0)
+            {
+                if (result.mismatches == 0)
+                {
+                    result.firstBody = item.body;
+                    result.firstTime = item.time;
+                }
+                result.mismatches++;
+                result.maxDifference = max(result.maxDifference, maxDiff);
+            }
+        }
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    if (!dataDir.empty() && chdir(dataDir.c_str()) != 0)
+    {
+        fmt::fprintf(cerr, "Cannot change directory to %s\n", dataDir);
+        return 1;
+    }
+
+    // Catalogs report what they load on clog; keep it off the terminal.
+    clog.rdbuf(nullptr);
+
+    unique_ptr<Universe> universe(LoadUniverse(configFileName));
+    if (universe == nullptr)
+        return 1;
+
+    vector<const Body*> bodies;
+    for (const auto& entry : *universe->getSolarSystemCatalog())
+        addBodies(entry.second->getPlanets(), bodies);
+
+    if (bodies.empty())
+    {
+        cerr << "No solar system objects loaded\n";
+        return 1;
+    }
+
+    // Spread the times over the range with a small irregular offset so that
+    // they don't coincide with the sample times of tabulated trajectories.
+    vector<double> times(nTimes);
+    mt19937 rng(1);
+    uniform_real_distribution<double> jitter(0.0, 0.5);
+    double step = (endTime - startTime) / (double) nTimes;
+    for (size_t i = 0; i < nTimes; i++)
+        times[i] = startTime + step * ((double) i + jitter(rng));
+
+    vector<double> reference(bodies.size() * nTimes * StateSize);
+    for (size_t i = 0; i < bodies.size(); i++)
+        for (size_t j = 0; j < nTimes; j++)
+            evaluate(bodies[i], times[j], &reference[(i * nTimes + j) * StateSize]);
+
+    if (nThreads == 0)
+        nThreads = max(2u, thread::hardware_concurrency());
+
+    vector<ThreadResult> results(nThreads);
+    vector<thread> threads;
+
+    auto t0 = chrono::steady_clock::now();
+    for (unsigned int i = 0; i < nThreads; i++)
+    {
+        threads.emplace_back(hammer, cref(bodies), cref(times), cref(reference),
+                             i + 1, ref(results[i]));
+    }
+    for (auto& t : threads)
+        t.join();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - t0;
+
+    ThreadResult total;
+    for (const auto& r : results)
+    {
+        if (total.mismatches == 0 && r.mismatches != 0)
+        {
+            total.firstBody = r.firstBody;
+            total.firstTime = r.firstTime;
+        }
+        total.evaluations += r.evaluations;
+        total.mismatches += r.mismatches;
+        total.maxDifference = max(total.maxDifference, r.maxDifference);
+    }
+
+    fmt::printf("%zu objects, %zu times, %u threads, %zu evaluations in %.2f s\n",
+                bodies.size(), nTimes, nThreads, total.evaluations, elapsed.count());
+
+    if (total.mismatches != 0)
+    {
+        fmt::printf("%zu evaluations differ from the single threaded results "
+                    "(largest difference %g)\n",
+                    total.mismatches, total.maxDifference);
+        fmt::printf("First difference: %s at %.8f\n",
+                    bodies[total.firstBody]->getName(), times[total.firstTime]);
+        return 1;
+    }
+
+    fmt::printf("All results match\n");
+    return 0;
+}
@@ -0,0 +1,199 @@
+// occultfinder.cpp
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Find transits and occultations among solar system objects as seen from
+// an observer, without starting the renderer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// The observer and objects are paths such as "Sol/Earth/Moon"; a surface
+// location of a body may be used as the observer. Start and end times are
+// TDB Julian dates. Events are written as CSV in chronological order, with
+// their start and end times both as TDB Julian dates and as UTC.
+
+#include "universeloader.h"
+#include <celengine/astro.h>
+#include <celengine/selection.h>
+#include <celengine/universe.h>
+#include <celestia/occultationfinder.h>
+#include <fmt/printf.h>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#define chdir _chdir
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+static string configFileName = "celestia.cfg";
+static string dataDir;
+static int eventTypeMask = OccultationEvent::Transit | OccultationEvent::Occultation;
+static double precision = 10.0; // seconds
+static bool showProgress = false;
+static vector<string> arguments;
+
+
+static void Usage()
+{
+    cerr << "Usage: occultfinder [options] <observer> <start> <end> <object> <object>...\n";
+    cerr << "  -c, --conf <file>     configuration file (default celestia.cfg)\n";
+    cerr << "  -d, --dir <dir>       data directory\n";
+    cerr << "  -t, --types <types>   transits, occultations or all (default all)\n";
+    cerr << "  -p, --precision <s>   precision of contact times in seconds (default 10)\n";
+    cerr << "  -v, --verbose         report progress on the standard error\n";
+}
+
+
+static bool parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if ((arg == "-c" || arg == "--conf") && hasValue)
+        {
+            configFileName = argv[++i];
+        }
+        else if ((arg == "-d" || arg == "--dir") && hasValue)
+        {
+            dataDir = argv[++i];
+        }
+        else if ((arg == "-t" || arg == "--types") && hasValue)
+        {
+            string types = argv[++i];
+            if (types == "transits")
+                eventTypeMask = OccultationEvent::Transit;
+            else if (types == "occultations")
+                eventTypeMask = OccultationEvent::Occultation;
+            else if (types != "all")
+                return false;
+        }
+        else if ((arg == "-p" || arg == "--precision") && hasValue)
+        {
+            precision = atof(argv[++i]);
+        }
+        else if (arg == "-v" || arg == "--verbose")
+        {
+            showProgress = true;
+        }
+        else if (arg[0] == '-' && arg.size() > 1 && !isdigit((unsigned char) arg[1]))
+        {
+            cerr << "Unknown command line switch: " << arg << '\n';
+            return false;
+        }
+        else
+        {
+            arguments.push_back(arg);
+        }
+    }
+
+    return arguments.size() >= 5 && precision > 0.0;
+}
+
+
+static string formatUTC(double tdb)
+{
+    astro::Date date = astro::TDBtoUTC(tdb);
+    return fmt::sprintf("%04d-%02d-%02d %02d:%02d:%02d",
+                        date.year, date.month, date.day,
+                        date.hour, date.minute, (int) date.seconds);
+}
+
+
+static bool findObject(const Universe& universe, const string& path, Selection& sel)
+{
+    sel = universe.findPath(path);
+    if (sel.empty())
+    {
+        fmt::fprintf(cerr, "Object %s not found\n", path);
+        return false;
+    }
+
+    return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    char* end0 = nullptr;
+    char* end1 = nullptr;
+    double startDate = strtod(arguments[1].c_str(), &end0);
+    double endDate = strtod(arguments[2].c_str(), &end1);
+    if (*end0 != '\0' || *end1 != '\0' || !(endDate > startDate))
+    {
+        cerr << "Start and end must be TDB Julian dates, with start before end\n";
+        return 1;
+    }
+
+    if (!dataDir.empty() && chdir(dataDir.c_str()) != 0)
+    {
+        fmt::fprintf(cerr, "Cannot change directory to %s\n", dataDir);
+        return 1;
+    }
+
+    // Catalogs report what they load on clog; keep it off the terminal.
+    clog.rdbuf(nullptr);
+
+    unique_ptr<Universe> universe(LoadUniverse(configFileName));
+    if (universe == nullptr)
+        return 1;
+
+    Selection observer;
+    if (!findObject(*universe, arguments[0], observer))
+        return 1;
+
+    vector<Selection> objects;
+    for (size_t i = 3; i < arguments.size(); i++)
+    {
+        Selection sel;
+        if (!findObject(*universe, arguments[i], sel))
+            return 1;
+        objects.push_back(sel);
+    }
+
+    OccultationFinder finder(observer);
+    finder.setPrecision(precision / 86400.0);
+    if (showProgress)
+    {
+        finder.setProgressCallback([startDate, endDate](double t)
+        {
+            fmt::fprintf(cerr, "\r%3d%%", (int) (100.0 * (t - startDate) / (endDate - startDate)));
+            return true;
+        });
+    }
+
+    vector<OccultationEvent> events;
+    finder.findEvents(objects, startDate, endDate, eventTypeMask, events);
+    if (showProgress)
+        cerr << '\n';
+
+    cout << "type,foreground,background,start_tdb,end_tdb,start_utc,end_utc\n";
+    for (const auto& event : events)
+    {
+        fmt::printf("%s,%s,%s,%.8f,%.8f,%s,%s\n",
+                    event.type == OccultationEvent::Transit ? "transit" : "occultation",
+                    event.foreground.getName(), event.background.getName(),
+                    event.startTime, event.endTime,
+                    formatUTC(event.startTime), formatUTC(event.endTime));
+    }
+
+    return 0;
+}
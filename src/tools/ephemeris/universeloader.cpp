@@ -0,0 +1,176 @@
+// universeloader.cpp
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Load the star and solar system catalogs listed in a configuration file
+// without creating a renderer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include "universeloader.h"
+#include <celengine/solarsys.h>
+#include <celengine/stardb.h>
+#include <celengine/universe.h>
+#include <celestia/configfile.h>
+#include <celutil/directory.h>
+#include <celutil/filetype.h>
+#include <fmt/printf.h>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+
+namespace
+{
+class CatalogLoader : public EnumFilesHandler
+{
+ public:
+    CatalogLoader(Universe* u, ContentType t) : universe(u), contentType(t) {};
+
+    bool process(const string& filename)
+    {
+        if (DetermineFileType(filename) != contentType)
+            return true;
+
+        string fullname = getPath() + '/' + filename;
+        ifstream in(fullname, ios::in);
+        if (!in.good())
+        {
+            fmt::fprintf(cerr, "Error opening %s\n", fullname);
+            return true;
+        }
+
+        if (contentType == Content_CelestiaStarCatalog)
+            universe->getStarCatalog()->load(in, getPath());
+        else
+            LoadSolarSystemObjects(in, *universe, getPath());
+
+        return true;
+    }
+
+ private:
+    Universe* universe;
+    ContentType contentType;
+};
+}
+
+
+static void loadExtras(Universe* universe,
+                       const CelestiaConfig& config,
+                       ContentType contentType)
+{
+    for (const auto& extrasDir : config.extrasDirs)
+    {
+        if (extrasDir.empty())
+            continue;
+
+        Directory* dir = OpenDirectory(extrasDir);
+        CatalogLoader loader(universe, contentType);
+        loader.pushDir(extrasDir);
+        dir->enumFiles(loader, true);
+        delete dir;
+    }
+}
+
+
+static void loadCrossIndex(StarDatabase* starDB,
+                           StarDatabase::Catalog catalog,
+                           const string& filename)
+{
+    if (filename.empty())
+        return;
+
+    ifstream xrefFile(filename, ios::in | ios::binary);
+    if (xrefFile.good() && !starDB->loadCrossIndex(catalog, xrefFile))
+        fmt::fprintf(cerr, "Error reading cross index %s\n", filename);
+}
+
+
+static StarDatabase* loadStars(const CelestiaConfig& config)
+{
+    ifstream starNamesFile(config.starNamesFile, ios::in);
+    if (!starNamesFile.good())
+    {
+        fmt::fprintf(cerr, "Error opening %s\n", config.starNamesFile);
+        return nullptr;
+    }
+
+    StarNameDatabase* starNameDB = StarNameDatabase::readNames(starNamesFile);
+    if (starNameDB == nullptr)
+    {
+        cerr << "Error reading star names file\n";
+        return nullptr;
+    }
+
+    StarDatabase* starDB = new StarDatabase();
+    if (!config.starDatabaseFile.empty())
+    {
+        ifstream starFile(config.starDatabaseFile, ios::in | ios::binary);
+        if (!starFile.good() || !starDB->loadBinary(starFile))
+        {
+            fmt::fprintf(cerr, "Error reading %s\n", config.starDatabaseFile);
+            delete starDB;
+            delete starNameDB;
+            return nullptr;
+        }
+    }
+
+    starDB->setNameDatabase(starNameDB);
+
+    loadCrossIndex(starDB, StarDatabase::HenryDraper, config.HDCrossIndexFile);
+    loadCrossIndex(starDB, StarDatabase::SAO,         config.SAOCrossIndexFile);
+    loadCrossIndex(starDB, StarDatabase::Gliese,      config.GlieseCrossIndexFile);
+
+    for (const auto& file : config.starCatalogFiles)
+    {
+        ifstream starFile(file, ios::in);
+        if (starFile.good())
+            starDB->load(starFile, "");
+        else
+            fmt::fprintf(cerr, "Error opening star catalog %s\n", file);
+    }
+
+    return starDB;
+}
+
+
+Universe* LoadUniverse(const string& configFileName)
+{
+    CelestiaConfig* config = ReadCelestiaConfig(configFileName);
+    if (config == nullptr)
+    {
+        fmt::fprintf(cerr, "Error reading configuration file %s\n", configFileName);
+        return nullptr;
+    }
+
+    StarDatabase* starDB = loadStars(*config);
+    if (starDB == nullptr)
+    {
+        delete config;
+        return nullptr;
+    }
+
+    Universe* universe = new Universe();
+    universe->setStarCatalog(starDB);
+    loadExtras(universe, *config, Content_CelestiaStarCatalog);
+    starDB->finish();
+
+    universe->setSolarSystemCatalog(new SolarSystemCatalog());
+    for (const auto& file : config->solarSystemFiles)
+    {
+        ifstream solarSysFile(file, ios::in);
+        if (solarSysFile.good())
+            LoadSolarSystemObjects(solarSysFile, *universe, "");
+        else
+            fmt::fprintf(cerr, "Error opening solar system catalog %s\n", file);
+    }
+    loadExtras(universe, *config, Content_CelestiaCatalog);
+
+    delete config;
+
+    return universe;
+}
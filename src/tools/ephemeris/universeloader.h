@@ -0,0 +1,25 @@
+// universeloader.h
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Load the star and solar system catalogs listed in a configuration file
+// without creating a renderer.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <string>
+
+class Universe;
+
+/*! Read the configuration file and load the star and solar system catalogs
+ *  it lists, including those in the extras directories. Deep sky objects,
+ *  asterisms and other catalogs that have no ephemeris are skipped. Paths
+ *  in the configuration file are relative to the current directory, as for
+ *  the main application. Returns nullptr on error.
+ */
+Universe* LoadUniverse(const std::string& configFileName);
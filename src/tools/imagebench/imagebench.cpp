@@ -0,0 +1,382 @@
+// imagebench.cpp
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Microbenchmark for the conversion of height maps to normal maps, and for
+// image decoding.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Image::computeNormalMap() is timed on synthetic height maps of several
+// sizes, with one and three channels, in wrap and clamp modes, against a
+// plain per-texel loop that serves as the reference. Both must produce
+// identical normal maps; any difference is reported and makes the program
+// fail. Results are written as CSV, one record per case, with the best and
+// median times over several runs.
+//
+// With --decode, the images named in a list file are instead decoded on the
+// image decoder's workers once per run, and the decoder's statistics are
+// written as CSV, one record per image format.
+
+#include <celengine/image.h>
+#include <celengine/imagedecoder.h>
+#include <celutil/threadpool.h>
+#include <GL/glew.h>
+#include <fmt/printf.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+
+struct Size
+{
+    int width;
+    int height;
+};
+
+static vector<Size> sizes = { { 1024, 512 }, { 4096, 2048 }, { 8192, 4096 } };
+static int nRuns = 5;
+static string decodeListFile;
+
+
+static void Usage()
+{
+    cerr << "Usage: imagebench [options]\n";
+    cerr << "  -s, --size <w>x<h>    add an image size; may be repeated\n";
+    cerr << "                        (default 1024x512, 4096x2048 and 8192x4096)\n";
+    cerr << "  -l, --large           also time a 16384x8192 image\n";
+    cerr << "  -r, --runs <n>        number of runs of each case (default 5)\n";
+    cerr << "  -d, --decode <file>   time the decoding of the images listed in a\n";
+    cerr << "                        file, one file name per line\n";
+}
+
+
+static bool parseCommandLine(int argc, char* argv[])
+{
+    bool customSizes = false;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if ((arg == "-s" || arg == "--size") && hasValue)
+        {
+            Size size;
+            if (sscanf(argv[++i], "%dx%d", &size.width, &size.height) != 2 ||
+                size.width < 2 || size.height < 2)
+            {
+                return false;
+            }
+            if (!customSizes)
+                sizes.clear();
+            customSizes = true;
+            sizes.push_back(size);
+        }
+        else if (arg == "-l" || arg == "--large")
+        {
+            sizes.push_back({ 16384, 8192 });
+        }
+        else if ((arg == "-r" || arg == "--runs") && hasValue)
+        {
+            nRuns = atoi(argv[++i]);
+            if (nRuns < 1)
+                return false;
+        }
+        else if ((arg == "-d" || arg == "--decode") && hasValue)
+        {
+            decodeListFile = argv[++i];
+        }
+        else
+        {
+            cerr << "Unknown command line switch: " << arg << '\n';
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Terrain-like heights: a few long waves with noise on top
+static Image* makeHeightMap(const Size& size, int format)
+{
+    auto* img = new Image(format, size.width, size.height);
+    int components = img->getComponents();
+
+    mt19937 rng(1);
+    uniform_int_distribution<int> noise(-8, 8);
+    for (int i = 0; i < size.height; i++)
+    {
+        unsigned char* row = img->getPixelRow(i);
+        for (int j = 0; j < size.width; j++)
+        {
+            double x = (double) j / size.width;
+            double y = (double) i / size.height;
+            double h = 0.5 + 0.2 * sin(12.0 * x) * cos(7.0 * y) + 0.1 * sin(53.0 * x + 31.0 * y);
+            int value = max(0, min(255, (int) (h * 255.0) + noise(rng)));
+            for (int c = 0; c < components; c++)
+                row[j * components + c] = (unsigned char) value;
+        }
+    }
+
+    return img;
+}
+
+
+// The per-texel loop that Image::computeNormalMap() must match
+static Image* referenceNormalMap(Image& img, float scale, bool wrap)
+{
+    int width = img.getWidth();
+    int height = img.getHeight();
+    int pitch = img.getPitch();
+    int components = img.getComponents();
+    const unsigned char* pixels = img.getPixels();
+
+    auto* normalMap = new Image(GL_RGBA, width, height);
+    unsigned char* nmPixels = normalMap->getPixels();
+    int nmPitch = normalMap->getPitch();
+
+    for (int i = 0; i < height; i++)
+    {
+        for (int j = 0; j < width; j++)
+        {
+            int i0 = i;
+            int j0 = j;
+            int i1 = i - 1;
+            int j1 = j - 1;
+            if (i1 < 0)
+            {
+                if (wrap)
+                {
+                    i1 = height - 1;
+                }
+                else
+                {
+                    i0++;
+                    i1++;
+                }
+            }
+            if (j1 < 0)
+            {
+                if (wrap)
+                {
+                    j1 = width - 1;
+                }
+                else
+                {
+                    j0++;
+                    j1++;
+                }
+            }
+
+            auto h00 = (int) pixels[i0 * pitch + j0 * components];
+            auto h10 = (int) pixels[i0 * pitch + j1 * components];
+            auto h01 = (int) pixels[i1 * pitch + j0 * components];
+
+            float dx = (float) (h10 - h00) * (1.0f / 255.0f) * scale;
+            float dy = (float) (h01 - h00) * (1.0f / 255.0f) * scale;
+
+            auto mag = (float) sqrt(dx * dx + dy * dy + 1.0f);
+            float rmag = 1.0f / mag;
+
+            int n = i * nmPitch + j * 4;
+            nmPixels[n]     = (unsigned char) (128 + 127 * dx * rmag);
+            nmPixels[n + 1] = (unsigned char) (128 + 127 * dy * rmag);
+            nmPixels[n + 2] = (unsigned char) (128 + 127 * rmag);
+            nmPixels[n + 3] = 255;
+        }
+    }
+
+    return normalMap;
+}
+
+
+// Count the texels that differ between two normal maps
+static long countDifferences(Image& a, Image& b)
+{
+    long differences = 0;
+    for (int i = 0; i < a.getHeight(); i++)
+    {
+        const unsigned char* rowA = a.getPixelRow(i);
+        const unsigned char* rowB = b.getPixelRow(i);
+        for (int j = 0; j < a.getWidth(); j++)
+        {
+            if (memcmp(rowA + j * 4, rowB + j * 4, 4) != 0)
+                differences++;
+        }
+    }
+
+    return differences;
+}
+
+
+// Run the conversion nRuns times and return the best and median times in
+// milliseconds, keeping the normal map of the last run.
+static void measure(const function<Image*()>& f,
+                    unique_ptr<Image>& result,
+                    double& best,
+                    double& median)
+{
+    vector<double> runs;
+    for (int run = 0; run < nRuns; run++)
+    {
+        auto start = chrono::steady_clock::now();
+        result.reset(f());
+        auto end = chrono::steady_clock::now();
+        runs.push_back(chrono::duration<double, milli>(end - start).count());
+    }
+
+    sort(runs.begin(), runs.end());
+    best = runs.front();
+    median = runs[runs.size() / 2];
+}
+
+
+static const char* formatName(ContentType type)
+{
+    switch (type)
+    {
+    case Content_JPEG:
+        return "jpeg";
+    case Content_BMP:
+        return "bmp";
+    case Content_PNG:
+        return "png";
+    case Content_Targa:
+        return "targa";
+    case Content_DDS:
+        return "dds";
+    case Content_DXT5NormalMap:
+        return "dxt5nm";
+    default:
+        return "other";
+    }
+}
+
+
+// Decode every listed image nRuns times, all requests of a run queued
+// at once, and report the decoder's accounting.
+static int decodeImages()
+{
+    vector<string> filenames;
+    ifstream in(decodeListFile);
+    if (!in.good())
+    {
+        fmt::fprintf(cerr, "Error opening image list %s\n", decodeListFile);
+        return 1;
+    }
+
+    string filename;
+    while (getline(in, filename))
+    {
+        if (!filename.empty())
+            filenames.push_back(filename);
+    }
+
+    ImageDecoder* decoder = GetImageDecoder();
+    double elapsed = 0.0;
+    for (int run = 0; run < nRuns; run++)
+    {
+        vector<ImageDecoder::RequestPtr> requests;
+        auto start = chrono::steady_clock::now();
+        for (const auto& f : filenames)
+            requests.push_back(decoder->submit(f, ImageDecoder::Normal));
+        for (auto& request : requests)
+            delete request->wait();
+        auto end = chrono::steady_clock::now();
+        elapsed += chrono::duration<double>(end - start).count();
+    }
+
+    cout << "format,images,failures,mbytes,decode_s,mbytes_per_s\n";
+    for (const auto& entry : decoder->getFormatStats())
+    {
+        const ImageDecoder::FormatStats& stats = entry.second;
+        fmt::printf("%s,%llu,%llu,%.1f,%.3f,%.1f\n",
+                    formatName(entry.first),
+                    (unsigned long long) stats.images,
+                    (unsigned long long) stats.failures,
+                    stats.decodedBytes / 1.0e6, stats.decodeTime,
+                    stats.throughput() / 1.0e6);
+    }
+
+    double totalBytes = (double) decoder->getDecodedBytes();
+    fmt::fprintf(cerr, "%.1f MB decoded in %.3f s (%.1f MB/s), %llu cancelled, %u queued\n",
+                 totalBytes / 1.0e6, elapsed,
+                 elapsed > 0.0 ? totalBytes / (elapsed * 1.0e6) : 0.0,
+                 (unsigned long long) decoder->getCancelledCount(),
+                 (unsigned int) decoder->getQueuedCount());
+
+    return 0;
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    if (!decodeListFile.empty())
+        return decodeImages();
+
+    const float scale = 2.5f;
+    bool identical = true;
+
+    fmt::fprintf(cerr, "%u worker threads\n", GetThreadPool()->threadCount());
+    cout << "width,height,channels,mode,reference_best_ms,reference_median_ms,"
+            "best_ms,median_ms,mtexels_per_s,speedup,differences\n";
+
+    for (const auto& size : sizes)
+    {
+        for (int format : { GL_LUMINANCE, GL_RGB })
+        {
+            unique_ptr<Image> heightMap(makeHeightMap(size, format));
+            for (bool wrap : { true, false })
+            {
+                unique_ptr<Image> reference;
+                unique_ptr<Image> normalMap;
+                double refBest, refMedian, best, median;
+                measure([&]() { return referenceNormalMap(*heightMap, scale, wrap); },
+                        reference, refBest, refMedian);
+                measure([&]() { return heightMap->computeNormalMap(scale, wrap); },
+                        normalMap, best, median);
+
+                long differences = countDifferences(*reference, *normalMap);
+                if (differences != 0)
+                    identical = false;
+
+                double texels = (double) size.width * (double) size.height;
+                fmt::printf("%d,%d,%d,%s,%.2f,%.2f,%.2f,%.2f,%.1f,%.2f,%ld\n",
+                            size.width, size.height, heightMap->getComponents(),
+                            wrap ? "wrap" : "clamp",
+                            refBest, refMedian, best, median,
+                            texels / (best * 1000.0), refBest / best,
+                            differences);
+            }
+        }
+    }
+
+    if (!identical)
+    {
+        cerr << "Normal maps differ from the reference\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,251 @@
+// maketilepack.cpp
+//
+// Copyright (C) 2019, Celestia Development Team
+//
+// Pack the tiles of a virtual texture into a single tile pack file.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// The input is the image directory of a virtual texture, holding the
+// tiles of each level in a directory levelN with names such as
+// tx_12_5.dds. Use the tile pack by replacing ImageDirectory in the .ctx
+// file with TilePack "<output file>".
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fmt/printf.h>
+#include <celutil/bytes.h>
+#include <celutil/directory.h>
+#include <celengine/tilepack.h>
+
+using namespace std;
+
+
+// Levels of detail scanned for tiles, as by the virtual texture loader
+static const int MaxResolutionLevels = 13;
+
+static string tileDirectory;
+static string outputFilename;
+static string tilePrefix = "tx_";
+static string tileType = "dds";
+
+
+struct TileFile
+{
+    string filename;
+    TilePack::Entry entry;
+};
+
+
+static void Usage()
+{
+    cerr << "Usage: maketilepack [options] <image directory> <output file>\n";
+    cerr << "  -p, --prefix <prefix>   tile file name prefix (default tx_)\n";
+    cerr << "  -t, --type <type>       tile file type (default dds)\n";
+}
+
+
+static bool parseCommandLine(int argc, char* argv[])
+{
+    int fileCount = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if ((arg == "-p" || arg == "--prefix") && hasValue)
+        {
+            tilePrefix = argv[++i];
+        }
+        else if ((arg == "-t" || arg == "--type") && hasValue)
+        {
+            tileType = argv[++i];
+        }
+        else if (arg[0] == '-')
+        {
+            cerr << "Unknown command line switch: " << arg << '\n';
+            return false;
+        }
+        else if (fileCount == 0)
+        {
+            tileDirectory = arg;
+            fileCount++;
+        }
+        else if (fileCount == 1)
+        {
+            outputFilename = arg;
+            fileCount++;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return fileCount == 2 && !tileType.empty() && tileType.size() <= 8 &&
+           tilePrefix.find('%') == string::npos;
+}
+
+
+static void writeUint(ostream& out, uint32_t n)
+{
+    LE_TO_CPU_INT32(n, n);
+    out.write(reinterpret_cast<char*>(&n), sizeof n);
+}
+
+
+static void writeUint64(ostream& out, uint64_t n)
+{
+    LE_TO_CPU_INT64(n, n);
+    out.write(reinterpret_cast<char*>(&n), sizeof n);
+}
+
+
+// Find the tiles of every level, as the virtual texture loader does when
+// no tile pack is used.
+static bool findTiles(vector<TileFile>& tiles)
+{
+    string pattern = tilePrefix + "%u_%u." + tileType + "%n";
+
+    for (int level = 0; level < MaxResolutionLevels; level++)
+    {
+        string path = fmt::sprintf("%s/level%d", tileDirectory, level);
+        if (!IsDirectory(path))
+            continue;
+
+        unique_ptr<Directory> dir(OpenDirectory(path));
+        if (dir == nullptr)
+            continue;
+
+        string filename;
+        while (dir->nextFile(filename))
+        {
+            TileFile tile;
+            int length = 0;
+            if (sscanf(filename.c_str(), pattern.c_str(), &tile.entry.u, &tile.entry.v, &length) != 2 ||
+                (size_t) length != filename.size())
+            {
+                continue;
+            }
+
+            tile.filename = path + "/" + filename;
+            tile.entry.level = level;
+
+            ifstream in(tile.filename, ios::in | ios::binary | ios::ate);
+            if (!in.good())
+            {
+                fmt::fprintf(cerr, "Error opening tile %s\n", tile.filename);
+                return false;
+            }
+            tile.entry.size = (uint32_t) in.tellg();
+            if (tile.entry.size != 0)
+                tiles.push_back(tile);
+        }
+    }
+
+    return true;
+}
+
+
+static bool writeTilePack(vector<TileFile>& tiles, ostream& out)
+{
+    // Order the tiles by level, and by row within a level, so that tiles
+    // that are drawn together are close to each other in the file.
+    sort(tiles.begin(), tiles.end(),
+         [](const TileFile& t0, const TileFile& t1)
+         {
+             if (t0.entry.level != t1.entry.level)
+                 return t0.entry.level < t1.entry.level;
+             if (t0.entry.v != t1.entry.v)
+                 return t0.entry.v < t1.entry.v;
+             return t0.entry.u < t1.entry.u;
+         });
+
+    uint64_t offset = TilePack::HeaderSize + tiles.size() * TilePack::EntrySize;
+    for (auto& tile : tiles)
+    {
+        tile.entry.offset = offset;
+        offset += tile.entry.size;
+    }
+
+    char type[8] = { 0 };
+    memcpy(type, tileType.c_str(), tileType.size());
+
+    out.write(TilePack::Magic, sizeof TilePack::Magic);
+    writeUint(out, TilePack::Version);
+    writeUint(out, (uint32_t) tiles.size());
+    out.write(type, sizeof type);
+    writeUint(out, 0);
+    writeUint(out, 0);
+
+    for (const auto& tile : tiles)
+    {
+        writeUint(out, tile.entry.level);
+        writeUint(out, tile.entry.u);
+        writeUint(out, tile.entry.v);
+        writeUint(out, tile.entry.size);
+        writeUint64(out, tile.entry.offset);
+    }
+
+    vector<char> buffer;
+    for (const auto& tile : tiles)
+    {
+        ifstream in(tile.filename, ios::in | ios::binary);
+        buffer.resize(tile.entry.size);
+        if (!in.read(buffer.data(), buffer.size()))
+        {
+            fmt::fprintf(cerr, "Error reading tile %s\n", tile.filename);
+            return false;
+        }
+        out.write(buffer.data(), buffer.size());
+    }
+
+    return out.good();
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (!parseCommandLine(argc, argv))
+    {
+        Usage();
+        return 1;
+    }
+
+    vector<TileFile> tiles;
+    if (!findTiles(tiles))
+        return 1;
+
+    if (tiles.empty())
+    {
+        fmt::fprintf(cerr, "No tiles found in %s\n", tileDirectory);
+        return 1;
+    }
+
+    ofstream out(outputFilename, ios::out | ios::binary);
+    if (!out.good())
+    {
+        cerr << "Error opening output file " << outputFilename << '\n';
+        return 1;
+    }
+
+    if (!writeTilePack(tiles, out))
+    {
+        cerr << "Error writing tile pack " << outputFilename << '\n';
+        return 1;
+    }
+
+    fmt::printf("Packed %u tiles\n", (unsigned int) tiles.size());
+
+    return 0;
+}
@@ -1,17 +1,100 @@
 #include <celephem/xyzvbinary.h>
+#include <celephem/xyzvcompressed.h>
 #include <celutil/bytes.h> // __BYTE_ORDER__
 #include <fmt/printf.h>
 #include <fstream>
 #include <iostream>
 #include <limits> // std::numeric_limits
+#include <vector>
 
 #define _(s) (s)
 
 using namespace std;
 
+static bool compressedToText(const string& infilename, ifstream& in, ofstream& out)
+{
+    XYZVCompressedHeader header;
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    {
+        fmt::fprintf(cerr, _("Error reading header of %s.\n"), infilename);
+        return false;
+    }
+
+    if (header.byteOrder != __BYTE_ORDER__)
+    {
+        fmt::fprintf(cerr, _("Unsupported byte order %i, expected %i.\n"),
+                     header.byteOrder, __BYTE_ORDER__);
+        return false;
+    }
+
+    if (header.digits != std::numeric_limits<double>::digits)
+    {
+        fmt::fprintf(cerr, _("Unsupported digits number %i, expected %i.\n"),
+                     header.digits, std::numeric_limits<double>::digits);
+        return false;
+    }
+
+    if (header.count == 0 || header.samplesPerSegment == 0)
+        return false;
+
+    // Sizes read from the file are checked against its size before
+    // anything is allocated.
+    in.seekg(0, ios::end);
+    auto fileSize = (uint64_t) in.tellg();
+    in.seekg(sizeof(header));
+    if (header.segmentCount > xyzvc::MaxSegmentCount(fileSize))
+    {
+        fmt::fprintf(cerr, _("Bad compressed xyzv file %s.\n"), infilename);
+        return false;
+    }
+
+    vector<XYZVCompressedSegment> segments(header.segmentCount);
+    if (!in.read(reinterpret_cast<char*>(segments.data()), segments.size() * sizeof(XYZVCompressedSegment)))
+    {
+        fmt::fprintf(cerr, _("Error reading segment table of %s.\n"), infilename);
+        return false;
+    }
+
+    uint64_t payloadSize = 0;
+    uint64_t tableSize = sizeof(header) + segments.size() * sizeof(XYZVCompressedSegment);
+    if (!xyzvc::CheckSegmentTable(header, segments, fileSize - tableSize, payloadSize))
+    {
+        fmt::fprintf(cerr, _("Bad compressed xyzv file %s.\n"), infilename);
+        return false;
+    }
+
+    vector<uint8_t> payload(payloadSize);
+    if (!in.read(reinterpret_cast<char*>(payload.data()), payload.size()))
+    {
+        fmt::fprintf(cerr, _("Error reading %s.\n"), infilename);
+        return false;
+    }
+
+    vector<XYZVBinaryData> samples(header.samplesPerSegment);
+    for (const auto& segment : segments)
+    {
+        if (!xyzvc::DecodeSegment(header, segment, payload.data(), payload.size(), samples.data()))
+        {
+            fmt::fprintf(cerr, _("Bad compressed xyzv file %s.\n"), infilename);
+            return false;
+        }
+
+        for (uint32_t i = 0; i < segment.count; i++)
+        {
+            const XYZVBinaryData& data = samples[i];
+            fmt::fprintf(out, "%.7lf %.7lf %.7lf %.7lf %.7lf %.7lf %.7lf\n", data.tdb,
+                         data.position[0], data.position[1], data.position[2],
+                         data.velocity[0], data.velocity[1], data.velocity[2]);
+        }
+    }
+
+    return true;
+}
+
 static bool binaryToText(const string& infilename, const string& outfilename)
 {
-    ifstream in(infilename);
+    ifstream in(infilename, ios::in | ios::binary);
     ofstream out(outfilename);
     if (!in.good() || !out.good())
     {
@@ -26,6 +109,9 @@ static bool binaryToText(const string& infilename, const string& outfilename)
         return false;
     }
 
+    if (string(header.magic) == xyzvc::Magic)
+        return compressedToText(infilename, in, out);
+
     if (string(header.magic) != "CELXYZV")
     {
         fmt::fprintf(cerr, _("Bad binary xyzv file %s.\n"), infilename);
@@ -1,10 +1,14 @@
 #include <celephem/xyzvbinary.h>
+#include <celephem/xyzvcompressed.h>
 #include <celutil/bytes.h> // __BYTE_ORDER__
 #include <fmt/printf.h>
+#include <cmath>
+#include <cstdlib> // strtod, strtoul
 #include <cstring> // memcpy
 #include <fstream>
 #include <iostream>
 #include <limits> // std::numeric_limits
+#include <vector>
 
 using namespace std;
 
@@ -104,17 +108,162 @@ static bool xyzvToBinary(const string& inFilename, const string& outFilename)
     return !!out.write(reinterpret_cast<char*>(&header), sizeof(header));
 }
 
+// Convert text xyzv file to compressed binary file with positions accurate
+// to maxError kilometers.
+static bool xyzvToCompressed(const string& inFilename, const string& outFilename,
+                             double maxError, uint32_t samplesPerSegment)
+{
+    ifstream in(inFilename);
+    if (!in.good())
+        return false;
+
+    if (!SkipComments(in))
+        return false;
+
+    vector<XYZVBinaryData> samples;
+    double maxSpeed = 0.0;
+    double boundingRadius = 0.0;
+    double lastSampleTime = -numeric_limits<double>::infinity();
+    XYZVBinaryData data;
+    while (in.good())
+    {
+        in >> data.tdb;
+        in >> data.position[0];
+        in >> data.position[1];
+        in >> data.position[2];
+        in >> data.velocity[0];
+        in >> data.velocity[1];
+        in >> data.velocity[2];
+
+        if (!in.good())
+            continue;
+
+        // Skip samples with duplicate times like the trajectory loader does
+        if (data.tdb == lastSampleTime)
+            continue;
+        if (data.tdb < lastSampleTime)
+        {
+            fmt::fprintf(cerr, "Samples are not sorted by time at %f.\n", data.tdb);
+            return false;
+        }
+        lastSampleTime = data.tdb;
+
+        double r = sqrt(data.position[0] * data.position[0] +
+                        data.position[1] * data.position[1] +
+                        data.position[2] * data.position[2]);
+        double v = sqrt(data.velocity[0] * data.velocity[0] +
+                        data.velocity[1] * data.velocity[1] +
+                        data.velocity[2] * data.velocity[2]);
+        boundingRadius = max(boundingRadius, r);
+        maxSpeed = max(maxSpeed, v);
+        samples.push_back(data);
+    }
+
+    if (samples.empty())
+        return false;
+
+    XYZVCompressedHeader header;
+    memcpy(header.magic, xyzvc::Magic, 8);
+    header.byteOrder = __BYTE_ORDER__;
+    header.digits = std::numeric_limits<double>::digits;
+    header.samplesPerSegment = samplesPerSegment;
+    header.count = samples.size();
+    header.maxError = maxError;
+    header.boundingRadius = boundingRadius;
+    // Time rounding must not move a sample by more than maxError / 8.
+    header.timeQuantum = 1.0e-6;
+    if (maxSpeed > 0.0)
+        header.timeQuantum = min(header.timeQuantum, maxError / (4.0 * maxSpeed * xyzvc::SecondsPerDay));
+
+    // Closer samples could be rounded to the same time
+    for (size_t i = 1; i < samples.size(); i++)
+    {
+        if (samples[i].tdb - samples[i - 1].tdb < header.timeQuantum)
+        {
+            fmt::fprintf(cerr, "Samples at %.9f and %.9f are closer than the time resolution of %g days.\n",
+                         samples[i - 1].tdb, samples[i].tdb, header.timeQuantum);
+            return false;
+        }
+    }
+
+    vector<XYZVCompressedSegment> segments;
+    vector<uint8_t> payload;
+    for (size_t i = 0; i < samples.size(); i += samplesPerSegment)
+    {
+        uint32_t count = (uint32_t) min((size_t) samplesPerSegment, samples.size() - i);
+        XYZVCompressedSegment segment;
+        if (!xyzvc::EncodeSegment(header, &samples[i], count, segment, payload))
+        {
+            fmt::fprintf(cerr, "Maximum error %g km is too small for %s.\n", maxError, inFilename);
+            return false;
+        }
+        segments.push_back(segment);
+    }
+    header.segmentCount = segments.size();
+
+    ofstream out(outFilename, ios::out | ios::binary);
+    if (!out.good())
+        return false;
+
+    out.write(reinterpret_cast<char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<char*>(segments.data()), segments.size() * sizeof(XYZVCompressedSegment));
+    out.write(reinterpret_cast<char*>(payload.data()), payload.size());
+    if (!out.good())
+        return false;
+
+    size_t rawSize = sizeof(XYZVBinaryHeader) + samples.size() * sizeof(XYZVBinaryData);
+    size_t size = sizeof(header) + segments.size() * sizeof(XYZVCompressedSegment) + payload.size();
+    fmt::fprintf(cout, "%u samples, %u bytes (%.1fx smaller than uncompressed)\n",
+                 samples.size(), size, (double) rawSize / (double) size);
+
+    return true;
+}
+
+static void usage(const char* name)
+{
+    fmt::fprintf(cerr, "Usage: %s [-e maxerror [-n samples]] infile.xyzv outfile.bin\n", name);
+    fmt::fprintf(cerr, "  -e maxerror  write a compressed file with the given maximum position error (km)\n");
+    fmt::fprintf(cerr, "  -n samples   number of samples per compressed segment (default 64)\n");
+}
+
 int main(int argc, char* argv[])
 {
-    if (argc < 3)
+    double maxError = 0.0;
+    unsigned long samplesPerSegment = 64;
+
+    int i = 1;
+    for (; i < argc - 2; i += 2)
+    {
+        if (strcmp(argv[i], "-e") == 0)
+        {
+            maxError = strtod(argv[i + 1], nullptr);
+        }
+        else if (strcmp(argv[i], "-n") == 0)
+        {
+            samplesPerSegment = strtoul(argv[i + 1], nullptr, 10);
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc - i != 2 || maxError < 0.0 || samplesPerSegment == 0 || samplesPerSegment > 65536)
     {
-        fmt::fprintf(cerr, "Usage: %s infile.xyzv outfile.bin\n", argv[0]);
+        usage(argv[0]);
         return 1;
     }
 
-    if (!xyzvToBinary(argv[1], argv[2]))
+    bool ok;
+    if (maxError > 0.0)
+        ok = xyzvToCompressed(argv[i], argv[i + 1], maxError, (uint32_t) samplesPerSegment);
+    else
+        ok = xyzvToBinary(argv[i], argv[i + 1]);
+
+    if (!ok)
     {
-        fmt::fprintf(cerr, "Error converting %s to %s.\n", argv[1], argv[2]);
+        fmt::fprintf(cerr, "Error converting %s to %s.\n", argv[i], argv[i + 1]);
         return 1;
     }
 